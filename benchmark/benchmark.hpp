@@ -0,0 +1,112 @@
+// benchmark.hpp
+// License: BSD-2-Clause
+/// \brief Minimal benchmark harness for convenience.
+
+#ifndef CALLGRAPH_BENCHMARK_HPP
+#define CALLGRAPH_BENCHMARK_HPP
+
+#include <callgraph/latency_histogram.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace callgraph_benchmark {
+    using clock_type = std::chrono::steady_clock;
+
+    /// Busy-wait for `d`, simulating a node that does `d` worth of work.
+    inline void spin_for(std::chrono::nanoseconds d) {
+        if (d.count() <= 0) {
+            return;
+        }
+        auto end(clock_type::now() + d);
+        while (clock_type::now() < end) {
+        }
+    }
+
+    struct result {
+        std::string shape;
+        std::string runner;
+        size_t nodes = 0;
+        std::chrono::nanoseconds work = std::chrono::nanoseconds(0);
+        size_t workers_requested = 0;
+        size_t workers = 0;
+        size_t runs = 0;
+        std::chrono::nanoseconds total = std::chrono::nanoseconds(0);
+        std::chrono::nanoseconds baseline = std::chrono::nanoseconds(0);
+        callgraph::latency_snapshot latency;
+    };
+
+    /// Invoke `f` `runs` times, recording the latency of each call.
+    template <typename F>
+    result measure(size_t runs, F&& f) {
+        callgraph::latency_histogram h;
+        auto start(clock_type::now());
+        for (size_t i = 0; i < runs; i++) {
+            auto t0(clock_type::now());
+            f();
+            h.record(clock_type::now() - t0);
+        }
+        result r;
+        r.runs = runs;
+        r.total = clock_type::now() - start;
+        r.latency = h.snapshot();
+        return r;
+    }
+
+    class report {
+    public:
+        void add(const result& r) {
+            results_.push_back(r);
+        }
+
+        void write(std::ostream& os) const {
+            os << "{\n  \"benchmarks\": [";
+            for (size_t i = 0; i < results_.size(); i++) {
+                os << (i > 0 ? ",\n" : "\n");
+                write(os, results_[i]);
+            }
+            os << "\n  ]\n}\n";
+        }
+
+    private:
+        static double per_second(size_t n, std::chrono::nanoseconds d) {
+            return d.count() > 0 ?
+                static_cast<double>(n) * 1e9 / static_cast<double>(d.count()) :
+                0.0;
+        }
+
+        static void write(std::ostream& os, const result& r) {
+            double overhead(0.0);
+            if (r.baseline.count() > 0 && r.nodes > 0) {
+                overhead = static_cast<double>(
+                    (r.latency.mean() - r.baseline).count()) /
+                    static_cast<double>(r.nodes);
+            }
+            os << "    {"
+               << "\"shape\": \"" << r.shape << "\", "
+               << "\"runner\": \"" << r.runner << "\", "
+               << "\"nodes\": " << r.nodes << ", "
+               << "\"work_ns\": " << r.work.count() << ", "
+               << "\"workers_requested\": " << r.workers_requested << ", "
+               << "\"workers\": " << r.workers << ", "
+               << "\"runs\": " << r.runs << ", "
+               << "\"runs_per_s\": " << per_second(r.runs, r.total) << ", "
+               << "\"nodes_per_s\": "
+               << per_second(r.runs * r.nodes, r.total) << ", "
+               << "\"per_node_overhead_ns\": " << overhead << ", "
+               << "\"latency_ns\": {"
+               << "\"mean\": " << r.latency.mean().count() << ", "
+               << "\"p50\": " << r.latency.p50().count() << ", "
+               << "\"p99\": " << r.latency.p99().count() << ", "
+               << "\"p999\": " << r.latency.p999().count() << ", "
+               << "\"max\": " << r.latency.max().count() << "}}";
+        }
+
+        std::vector<result> results_;
+    };
+}
+
+#endif // CALLGRAPH_BENCHMARK_HPP
@@ -0,0 +1,264 @@
+// callgraph/callgraph_benchmarks.cpp
+// License: BSD-2-Clause
+/// \brief Scheduling overhead, throughput and latency benchmarks over
+/// common graph shapes and worker counts.
+///
+/// Results are written to stdout as a single JSON document. Each graph
+/// shape is also run through a sequential baseline which invokes the
+/// same callables in a valid execution order on the calling thread.
+///
+/// Usage: callgraph_benchmarks [--runs N] [--work-ns N]
+///                             [--workers 1,2,4,8] [--shape NAME]
+
+#include "benchmark.hpp"
+
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+    using callgraph_benchmark::clock_type;
+    using callgraph_benchmark::spin_for;
+    using std::chrono::nanoseconds;
+
+    volatile int sink_value;
+
+    struct work_node {
+        nanoseconds work;
+        void operator()() const {
+            spin_for(work);
+        }
+    };
+
+    struct chain_source {
+        int operator()() const {
+            return 0;
+        }
+    };
+
+    struct chain_node {
+        nanoseconds work;
+        int operator()(int x) const {
+            spin_for(work);
+            return x + 1;
+        }
+    };
+
+    /// A benchmark graph and a sequential schedule of the same work.
+    struct bench_graph {
+        std::string shape;
+        size_t nodes;
+        callgraph::graph graph;
+        std::function<void()> sequential;
+    };
+
+    using edge_list = std::vector<std::pair<size_t, size_t>>;
+
+    // Build a graph of `n` void nodes from an edge list. Nodes must be
+    // numbered in a valid execution order, i.e. every edge (p, c) has p < c.
+    std::unique_ptr<bench_graph>
+    make_dag(const std::string& shape, size_t n, const edge_list& edges,
+             nanoseconds work) {
+        auto nodes = std::make_shared<std::vector<work_node>>(n, work_node{work});
+        std::unique_ptr<bench_graph> b(new bench_graph);
+        b->shape = shape;
+        b->nodes = n;
+
+        std::vector<std::vector<size_t>> parents(n);
+        for (const auto& e : edges) {
+            parents[e.second].push_back(e.first);
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (parents[i].empty()) {
+                b->graph.connect((*nodes)[i]);
+            }
+            for (size_t p : parents[i]) {
+                b->graph.connect((*nodes)[p], (*nodes)[i]);
+            }
+        }
+        b->sequential = [nodes] {
+            for (const work_node& node : *nodes) {
+                node();
+            }
+        };
+        return b;
+    }
+
+    std::unique_ptr<bench_graph> make_chain(size_t n, nanoseconds work) {
+        struct storage {
+            chain_source source;
+            std::vector<chain_node> nodes;
+        };
+        auto s = std::make_shared<storage>();
+        s->nodes.assign(n, chain_node{work});
+
+        std::unique_ptr<bench_graph> b(new bench_graph);
+        b->shape = "chain";
+        b->nodes = n + 1;
+        b->graph.connect(s->source);
+        b->graph.connect<0>(s->source, s->nodes[0]);
+        for (size_t i = 1; i < n; i++) {
+            b->graph.connect<0>(s->nodes[i - 1], s->nodes[i]);
+        }
+        b->sequential = [s] {
+            int x(s->source());
+            for (const chain_node& node : s->nodes) {
+                x = node(x);
+            }
+            sink_value = x;
+        };
+        return b;
+    }
+
+    std::unique_ptr<bench_graph> make_fan(size_t width, nanoseconds work) {
+        edge_list edges;
+        for (size_t i = 1; i <= width; i++) {
+            edges.emplace_back(0, i);
+            edges.emplace_back(i, width + 1);
+        }
+        return make_dag("fan_out_in", width + 2, edges, work);
+    }
+
+    std::unique_ptr<bench_graph> make_diamonds(size_t count, nanoseconds work) {
+        edge_list edges;
+        for (size_t i = 0; i < count; i++) {
+            size_t top(3 * i);
+            edges.emplace_back(top, top + 1);
+            edges.emplace_back(top, top + 2);
+            edges.emplace_back(top + 1, top + 3);
+            edges.emplace_back(top + 2, top + 3);
+        }
+        return make_dag("diamonds", 3 * count + 1, edges, work);
+    }
+
+    std::unique_ptr<bench_graph> make_layered(size_t layers, size_t width,
+                                              nanoseconds work) {
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<size_t> pick(0, width - 1);
+        edge_list edges;
+        for (size_t l = 1; l < layers; l++) {
+            for (size_t i = 0; i < width; i++) {
+                size_t child(l * width + i);
+                size_t a(pick(rng)), b(pick(rng));
+                edges.emplace_back((l - 1) * width + a, child);
+                if (b != a) {
+                    edges.emplace_back((l - 1) * width + b, child);
+                }
+            }
+        }
+        return make_dag("layered_random", layers * width, edges, work);
+    }
+
+    std::unique_ptr<bench_graph> make_tree(size_t levels, nanoseconds work) {
+        size_t n((size_t(1) << levels) - 1);
+        edge_list edges;
+        for (size_t i = 1; i < n; i++) {
+            edges.emplace_back((i - 1) / 2, i);
+        }
+        return make_dag("binary_tree", n, edges, work);
+    }
+
+    struct options {
+        size_t runs = 200;
+        nanoseconds work = nanoseconds(10000);
+        std::vector<size_t> workers = {1, 2, 4, 8};
+        std::string shape;
+    };
+
+    options parse_options(int argc, char** argv) {
+        options opts;
+        for (int i = 1; i + 1 < argc; i += 2) {
+            std::string key(argv[i]), value(argv[i + 1]);
+            if (key == "--runs") {
+                opts.runs = std::stoul(value);
+            }
+            else if (key == "--work-ns") {
+                opts.work = nanoseconds(std::stoll(value));
+            }
+            else if (key == "--shape") {
+                opts.shape = value;
+            }
+            else if (key == "--workers") {
+                opts.workers.clear();
+                size_t pos(0);
+                while (pos < value.size()) {
+                    size_t comma(value.find(',', pos));
+                    if (comma == std::string::npos) {
+                        comma = value.size();
+                    }
+                    opts.workers.push_back(
+                        std::stoul(value.substr(pos, comma - pos)));
+                    pos = comma + 1;
+                }
+            }
+        }
+        return opts;
+    }
+
+    void run_shape(callgraph_benchmark::report& out,
+                   const options& opts,
+                   std::unique_ptr<bench_graph> b,
+                   nanoseconds work) {
+        using callgraph_benchmark::result;
+
+        result seq(callgraph_benchmark::measure(opts.runs, b->sequential));
+        seq.shape = b->shape;
+        seq.runner = "sequential";
+        seq.nodes = b->nodes;
+        seq.work = work;
+        seq.workers = 1;
+        out.add(seq);
+
+        for (size_t w : opts.workers) {
+            callgraph::graph_runner runner(b->graph, w);
+            runner.execute().get();
+
+            result r(callgraph_benchmark::measure(opts.runs, [&runner] {
+                        runner.execute().get();
+                    }));
+            r.shape = b->shape;
+            r.runner = "graph_runner";
+            r.nodes = b->nodes;
+            r.work = work;
+            r.workers_requested = w;
+            r.workers = runner.metrics().workers;
+            r.baseline = seq.latency.mean();
+            out.add(r);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    options opts(parse_options(argc, argv));
+    callgraph_benchmark::report out;
+
+    using builder = std::function<std::unique_ptr<bench_graph>(nanoseconds)>;
+    std::vector<std::pair<std::string, builder>> shapes = {
+        {"chain", [](nanoseconds w) { return make_chain(64, w); }},
+        {"fan_out_in", [](nanoseconds w) { return make_fan(32, w); }},
+        {"diamonds", [](nanoseconds w) { return make_diamonds(5, w); }},
+        {"layered_random", [](nanoseconds w) { return make_layered(4, 8, w); }},
+        {"binary_tree", [](nanoseconds w) { return make_tree(5, w); }},
+    };
+
+    // Empty nodes measure pure scheduling overhead.
+    for (nanoseconds work : {nanoseconds(0), opts.work}) {
+        for (auto& shape : shapes) {
+            if (opts.shape.empty() || opts.shape == shape.first) {
+                run_shape(out, opts, shape.second(work), work);
+            }
+        }
+    }
+
+    out.write(std::cout);
+    return EXIT_SUCCESS;
+}
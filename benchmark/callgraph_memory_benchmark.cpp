@@ -0,0 +1,231 @@
+// callgraph/callgraph_memory_benchmark.cpp
+// License: BSD-2-Clause
+/// \brief Peak memory held by intermediate results.
+///
+/// Runs pipelines whose nodes each produce a large buffer, once with
+/// every result marked as a graph output, so that all results are kept
+/// until the next execution, and once with only the final result kept,
+/// so that intermediates are destroyed as soon as they have been read.
+/// The peak number of bytes allocated during an execution is written
+/// to stdout as a single JSON document.
+///
+/// Usage: callgraph_memory_benchmark [--stages N] [--bytes N] [--workers N]
+
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+    std::atomic<size_t> current_bytes(0);
+    std::atomic<size_t> peak_bytes(0);
+
+    // Each allocation is prefixed with its size, so that it can be
+    // subtracted again on deallocation.
+    struct alignas(alignof(std::max_align_t)) header {
+        size_t size;
+    };
+
+    void* counted_allocate(size_t n) {
+        void* p(std::malloc(sizeof(header) + n));
+        if (!p) {
+            throw std::bad_alloc();
+        }
+        static_cast<header*>(p)->size = n;
+        size_t now(current_bytes.fetch_add(n) + n);
+        size_t peak(peak_bytes.load());
+        while (now > peak && !peak_bytes.compare_exchange_weak(peak, now)) {
+        }
+        return static_cast<header*>(p) + 1;
+    }
+
+    void counted_deallocate(void* p) {
+        if (p) {
+            header* h(static_cast<header*>(p) - 1);
+            current_bytes.fetch_sub(h->size);
+            std::free(h);
+        }
+    }
+}
+
+void* operator new(size_t n) {
+    return counted_allocate(n);
+}
+
+void* operator new[](size_t n) {
+    return counted_allocate(n);
+}
+
+void operator delete(void* p) noexcept {
+    counted_deallocate(p);
+}
+
+void operator delete[](void* p) noexcept {
+    counted_deallocate(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    counted_deallocate(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    counted_deallocate(p);
+}
+
+namespace {
+    using buffer = std::vector<char>;
+
+    struct source_stage {
+        size_t bytes;
+        buffer operator()() const {
+            return buffer(bytes, 1);
+        }
+    };
+
+    struct filter_stage {
+        size_t bytes;
+        buffer operator()(const buffer& in) const {
+            buffer out(bytes);
+            for (size_t i = 0; i < out.size(); i += 4096) {
+                out[i] = static_cast<char>(in[i % in.size()] + 1);
+            }
+            return out;
+        }
+    };
+
+    struct options {
+        size_t stages = 16;
+        size_t bytes = 16 << 20;
+        size_t workers = 2;
+    };
+
+    options parse_options(int argc, char** argv) {
+        options opts;
+        for (int i = 1; i + 1 < argc; i += 2) {
+            std::string key(argv[i]), value(argv[i + 1]);
+            if (key == "--stages") {
+                opts.stages = std::stoul(value);
+            }
+            else if (key == "--bytes") {
+                opts.bytes = std::stoul(value);
+            }
+            else if (key == "--workers") {
+                opts.workers = std::stoul(value);
+            }
+        }
+        return opts;
+    }
+
+    // Peak bytes allocated during a single execution of a chain of
+    // `stages` filters, beyond what was allocated before it started.
+    size_t measure_chain(const options& opts, bool retain) {
+        source_stage source{opts.bytes};
+        std::vector<filter_stage> filters(opts.stages, filter_stage{opts.bytes});
+
+        callgraph::graph g;
+        g.connect(source);
+        g.connect<0>(source, filters[0]);
+        for (size_t i = 1; i < filters.size(); i++) {
+            g.connect<0>(filters[i - 1], filters[i]);
+        }
+        g.set_output(filters.back());
+        if (retain) {
+            g.set_output(source);
+            for (filter_stage& f : filters) {
+                g.set_output(f);
+            }
+        }
+
+        callgraph::graph_runner runner(g, opts.workers, callgraph::preallocate);
+        size_t base(current_bytes.load());
+        peak_bytes.store(base);
+        runner.execute().get();
+        return peak_bytes.load() - base;
+    }
+
+    struct join_stage {
+        size_t bytes;
+        buffer operator()(const buffer& a, const buffer& b) const {
+            buffer out(bytes);
+            for (size_t i = 0; i < out.size(); i += 4096) {
+                out[i] = static_cast<char>(a[i % a.size()] + b[i % b.size()]);
+            }
+            return out;
+        }
+    };
+
+    // As above, for `stages` stacked diamonds, each splitting the
+    // previous result into two filters and joining them again.
+    size_t measure_diamonds(const options& opts, bool retain) {
+        source_stage source{opts.bytes};
+        std::vector<filter_stage> left(opts.stages, filter_stage{opts.bytes});
+        std::vector<filter_stage> right(opts.stages, filter_stage{opts.bytes});
+        std::vector<join_stage> joins(opts.stages, join_stage{opts.bytes});
+
+        callgraph::graph g;
+        g.connect(source);
+        for (size_t i = 0; i < opts.stages; i++) {
+            if (i == 0) {
+                g.connect<0>(source, left[i]);
+                g.connect<0>(source, right[i]);
+            }
+            else {
+                g.connect<0>(joins[i - 1], left[i]);
+                g.connect<0>(joins[i - 1], right[i]);
+            }
+            g.connect<0>(left[i], joins[i]);
+            g.connect<1>(right[i], joins[i]);
+            if (retain) {
+                g.set_output(left[i]);
+                g.set_output(right[i]);
+                g.set_output(joins[i]);
+            }
+        }
+        g.set_output(joins.back());
+        if (retain) {
+            g.set_output(source);
+        }
+
+        callgraph::graph_runner runner(g, opts.workers, callgraph::preallocate);
+        size_t base(current_bytes.load());
+        peak_bytes.store(base);
+        runner.execute().get();
+        return peak_bytes.load() - base;
+    }
+
+    void write(std::ostream& os, const char* shape, const options& opts,
+               size_t retained, size_t released, bool last) {
+        os << "    {"
+           << "\"shape\": \"" << shape << "\", "
+           << "\"stages\": " << opts.stages << ", "
+           << "\"bytes_per_result\": " << opts.bytes << ", "
+           << "\"workers\": " << opts.workers << ", "
+           << "\"peak_bytes_retained\": " << retained << ", "
+           << "\"peak_bytes_released\": " << released << ", "
+           << "\"reduction\": "
+           << (retained > 0 ?
+               1.0 - static_cast<double>(released) / static_cast<double>(retained) :
+               0.0)
+           << "}" << (last ? "\n" : ",\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    options opts(parse_options(argc, argv));
+
+    size_t chain_retained(measure_chain(opts, true));
+    size_t chain_released(measure_chain(opts, false));
+    size_t diamonds_retained(measure_diamonds(opts, true));
+    size_t diamonds_released(measure_diamonds(opts, false));
+
+    std::cout << "{\n  \"benchmarks\": [\n";
+    write(std::cout, "chain", opts, chain_retained, chain_released, false);
+    write(std::cout, "diamonds", opts, diamonds_retained, diamonds_released, true);
+    std::cout << "  ]\n}\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+// callgraph/cancellation_token.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_CANCELLATION_TOKEN_HPP
+#define CALLGRAPH_CANCELLATION_TOKEN_HPP
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+
+namespace callgraph {
+    class graph_runner;
+
+/// \brief The error delivered through the future of an execution which
+/// was cancelled.
+    class cancelled_error : public std::runtime_error {
+    public:
+        cancelled_error()
+            : runtime_error("Execution cancelled.")
+            {
+            }
+
+    protected:
+        explicit cancelled_error(const char* what)
+            : runtime_error(what)
+            {
+            }
+    };
+
+/// \brief The error delivered through the future of an execution which
+/// did not finish before its deadline.
+    class deadline_exceeded : public cancelled_error {
+    public:
+        deadline_exceeded()
+            : cancelled_error("Execution deadline exceeded.")
+            {
+            }
+    };
+
+/// \brief A token used to cancel an execution of a graph.
+///
+/// Copies of a token share their state, so a token may be captured by
+/// the nodes of a graph, which can poll it to stop early, and cancelled
+/// from any thread.
+    class cancellation_token {
+    public:
+        /// \brief Construct a token which has not been cancelled.
+        cancellation_token()
+            : cancelled_(std::make_shared<std::atomic<bool>>(false))
+            {
+            }
+
+        /// \brief Request cancellation of every execution using this token.
+        void cancel() const {
+            cancelled_->store(true, std::memory_order_release);
+        }
+
+        /// \brief Check whether cancellation has been requested.
+        bool cancelled() const {
+            return cancelled_->load(std::memory_order_acquire) ||
+                (parent_ && parent_->load(std::memory_order_acquire)) ||
+                (deadline_ != std::chrono::steady_clock::time_point::max() &&
+                 std::chrono::steady_clock::now() >= deadline_);
+        }
+
+    private:
+        friend class graph_runner;
+
+        void reset() const {
+            cancelled_->store(false, std::memory_order_relaxed);
+        }
+
+        // Make this token read as cancelled whenever `parent` does,
+        // without cancelling `parent` when this token is cancelled.
+        void link(const cancellation_token& parent) {
+            parent_ = parent.cancelled_;
+        }
+
+        // Make this token read as cancelled once `deadline` has passed.
+        void expire_at(std::chrono::steady_clock::time_point deadline) {
+            deadline_ = deadline;
+        }
+
+        std::shared_ptr<std::atomic<bool>> cancelled_;
+        std::shared_ptr<std::atomic<bool>> parent_;
+        std::chrono::steady_clock::time_point deadline_ =
+            std::chrono::steady_clock::time_point::max();
+    };
+}
+
+#endif // CALLGRAPH_CANCELLATION_TOKEN_HPP
@@ -0,0 +1,30 @@
+// callgraph/detail/async_target.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_DETAIL_ASYNC_TARGET_HPP
+#define CALLGRAPH_DETAIL_ASYNC_TARGET_HPP
+
+#ifndef NO_DOC
+namespace callgraph {
+    namespace detail {
+        class io_reactor;
+        class event_reactor;
+
+        // Where an asynchronous node reports while it runs: `resume`
+        // queues the node to continue on a worker, and `finish` is called
+        // exactly once, when the node has finished. `io` and `events` get
+        // the runner's I/O and event reactors. Without a runner, the
+        // functions are null and the node continues on whichever thread
+        // wakes it.
+        struct async_target {
+            void (*resume)(void* runner, const void* node);
+            void (*finish)(void* runner, const void* node);
+            io_reactor* (*io)(void* runner);
+            event_reactor* (*events)(void* runner);
+            void* runner;
+            const void* node;
+        };
+    }
+}
+#endif // NO_DOC
+#endif // CALLGRAPH_DETAIL_ASYNC_TARGET_HPP
@@ -0,0 +1,205 @@
+// callgraph/detail/event_reactor.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_DETAIL_EVENT_REACTOR_HPP
+#define CALLGRAPH_DETAIL_EVENT_REACTOR_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#ifndef NO_DOC
+namespace callgraph {
+    namespace detail {
+        // A wait for a file descriptor to become ready, registered with an
+        // event_reactor. The request must stay put until it completes.
+        struct event_request {
+            int fd;
+            std::uint32_t events;
+            // Called once, on the reactor's thread, with the events which
+            // fired, or with zero and `error` set if the wait failed or
+            // was cancelled.
+            void (*complete)(event_request*, std::uint32_t events);
+            void* context;
+            int error;
+            // Owned by the reactor while the wait is pending.
+            std::uint64_t id;
+            event_request* next;
+        };
+
+#ifdef __linux__
+        // Waits for file descriptors to become ready with epoll, on a
+        // thread of its own, woken through an eventfd to stop.
+        class event_reactor {
+        public:
+            event_reactor()
+                : epoll_fd_(::epoll_create1(EPOLL_CLOEXEC)),
+                  wake_fd_(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+                  next_id_(1),
+                  pending_(nullptr)
+                {
+                    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+                        int error(errno);
+                        close_fds();
+                        throw std::system_error(error, std::generic_category(),
+                                                "Cannot start the event reactor");
+                    }
+                    epoll_event ev;
+                    ev.events = EPOLLIN;
+                    ev.data.u64 = 0;
+                    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+                    thread_ = std::thread(&event_reactor::wait, this);
+                }
+
+            ~event_reactor() {
+                std::uint64_t one(1);
+                ssize_t n(::write(wake_fd_, &one, sizeof(one)));
+                (void)n;
+                thread_.join();
+                close_fds();
+            }
+
+            event_reactor(const event_reactor&) = delete;
+            event_reactor& operator=(const event_reactor&) = delete;
+
+            // Complete `request` once its descriptor is ready. Each
+            // descriptor may have one wait at a time.
+            void watch(event_request* request) {
+                int result;
+                {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    request->id = next_id_++;
+                    epoll_event ev;
+                    ev.events = request->events | EPOLLONESHOT;
+                    ev.data.u64 = request->id;
+                    result = ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, request->fd, &ev);
+                    if (result == 0) {
+                        request->next = pending_;
+                        pending_ = request;
+                    }
+                }
+                if (result < 0) {
+                    request->error = errno;
+                    request->complete(request, 0);
+                }
+            }
+
+            // Stop watching every pending request, and return them, linked
+            // through `next`, to be completed with cancel.
+            event_request* detach() {
+                std::unique_lock<std::mutex> lk(mutex_);
+                for (event_request* r = pending_; r; r = r->next) {
+                    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, r->fd, nullptr);
+                }
+                event_request* detached(pending_);
+                pending_ = nullptr;
+                return detached;
+            }
+
+            // Complete requests returned by detach, as cancelled.
+            static void cancel(event_request* requests) {
+                while (requests) {
+                    // The request may be destroyed once it completes.
+                    event_request* next(requests->next);
+                    requests->error = ECANCELED;
+                    requests->complete(requests, 0);
+                    requests = next;
+                }
+            }
+
+        private:
+            void wait() {
+                epoll_event events[64];
+                for (;;) {
+                    int n(::epoll_wait(epoll_fd_, events, 64, -1));
+                    if (n < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        return;
+                    }
+                    // Pairs with the lock under which the requests were
+                    // registered.
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    for (int i = 0; i < n; i++) {
+                        if (events[i].data.u64 == 0) {
+                            return;
+                        }
+                        // Requests detached since epoll_wait returned are
+                        // no longer pending, and may be gone.
+                        event_request* request(take(events[i].data.u64));
+                        if (!request) {
+                            continue;
+                        }
+                        // The descriptor may be watched again once the
+                        // request has completed.
+                        ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, request->fd, nullptr);
+                        lk.unlock();
+                        request->error = 0;
+                        request->complete(request, events[i].events);
+                        lk.lock();
+                    }
+                }
+            }
+
+            // Remove the pending request `id` from the list, if it is
+            // there. The caller must hold the lock.
+            event_request* take(std::uint64_t id) {
+                for (event_request** r = &pending_; *r; r = &(*r)->next) {
+                    if ((*r)->id == id) {
+                        event_request* request(*r);
+                        *r = request->next;
+                        return request;
+                    }
+                }
+                return nullptr;
+            }
+
+            void close_fds() {
+                if (epoll_fd_ >= 0) {
+                    ::close(epoll_fd_);
+                }
+                if (wake_fd_ >= 0) {
+                    ::close(wake_fd_);
+                }
+            }
+
+            int epoll_fd_;
+            int wake_fd_;
+            // Guarded by the lock: the next request id, and the pending
+            // requests.
+            std::uint64_t next_id_;
+            event_request* pending_;
+            std::mutex mutex_;
+            std::thread thread_;
+        };
+#else
+        // Event sources need epoll, so every wait fails.
+        class event_reactor {
+        public:
+            void watch(event_request* request) {
+                request->error = static_cast<int>(std::errc::function_not_supported);
+                request->complete(request, 0);
+            }
+
+            event_request* detach() {
+                return nullptr;
+            }
+
+            static void cancel(event_request*) {
+            }
+        };
+#endif
+    }
+}
+#endif // NO_DOC
+#endif // CALLGRAPH_DETAIL_EVENT_REACTOR_HPP
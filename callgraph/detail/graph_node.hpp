@@ -4,22 +4,50 @@
 #ifndef CALLGRAPH_DETAIL_GRAPH_NODE_HPP
 #define CALLGRAPH_DETAIL_GRAPH_NODE_HPP
 
-#include <callgraph/detail/invoke_once.hpp>
 #include <callgraph/detail/node.hpp>
 #include <callgraph/vertex.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <exception>
 #include <functional>
 #include <stack>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
 #include <unordered_set>
+#include <vector>
 
 #ifndef NO_DOC
 namespace callgraph {
     class graph;
+    class graph_runner;
+    class graph_exporter;
+    class stream_runner;
 
     namespace detail {
         struct graph_node {
+            // A parameter binding from another node's result. Indices
+            // are -1 where the whole result, or no parameter, is bound.
+            struct binding {
+                const graph_node* source;
+                int from;
+                int to;
+            };
+
+            // An edge of a branch node, active when the branch selects
+            // `value`.
+            struct branch_case {
+                const graph_node* target;
+                size_t value;
+            };
+
             friend struct graph_worker;
             friend class callgraph::graph;
+            friend class callgraph::graph_runner;
+            friend class callgraph::graph_exporter;
+            friend class callgraph::stream_runner;
 
             template <typename T>
             struct node_deleter {
@@ -28,72 +56,446 @@ namespace callgraph {
                 }
             };
 
+            // The operations of a node, type erased. Every node of a type
+            // shares one table; the operations which the type does not
+            // support are null.
+            struct node_ops {
+                void (*execute)(void*);
+                bool (*update)(void*);
+                void (*fail)(void*, std::exception_ptr);
+                bool (*valid)(void*);
+                void (*reset)(void*);
+                node_stream_port* (*port)(void*, size_t);
+                bool (*same)(const void*, const void*);
+                void (*rebind)(void*, const node_value_base&, node_value_base&);
+                void (*arrive)(void*, size_t);
+                callgraph::spawn_context* (*spawn_context)(void*);
+                size_t (*select)(void*);
+            };
+
             template <typename T>
-            struct node_resetter {
-                void operator()(void* ptr) {
+            struct node_operations {
+                using type = typename node<T>::type;
+
+                static void execute(void* ptr) {
+                    (*static_cast<node<T>*>(ptr))();
+                }
+
+                static bool update(void* ptr) {
+                    return static_cast<node<T>*>(ptr)->update();
+                }
+
+                static void fail(void* ptr, std::exception_ptr error) {
+                    static_cast<node<T>*>(ptr)->fail(std::move(error));
+                }
+
+                static bool valid(void* ptr) {
+                    return static_cast<node<T>*>(ptr)->valid();
+                }
+
+                static void reset(void* ptr) {
                     static_cast<node<T>*>(ptr)->reset();
                 }
+
+                static node_stream_port* port(void* ptr, size_t to) {
+                    return static_cast<node<T>*>(ptr)->port(to);
+                }
+
+                static bool same(const void* a, const void* b) {
+                    return static_cast<const node<T>*>(a)->same(
+                        *static_cast<const node<T>*>(b));
+                }
+
+                static void rebind(void* ptr, const node_value_base& from,
+                                   node_value_base& to) {
+                    static_cast<node<T>*>(ptr)->rebind(from, to);
+                }
+
+                static void arrive(void* ptr, size_t leaf) {
+                    static_cast<node<T>*>(ptr)->arrive(leaf);
+                }
+
+                static callgraph::spawn_context* spawn_context(void* ptr) {
+                    return static_cast<node<T>*>(ptr)->spawn_context();
+                }
+
+                static size_t select(void* ptr) {
+                    return static_cast<node<T>*>(ptr)->selected();
+                }
+
+                using arrive_type = void (*)(void*, size_t);
+                using spawn_context_type = callgraph::spawn_context* (*)(void*);
+                using select_type = size_t (*)(void*);
+
+                static arrive_type arrive_of(std::true_type) {
+                    return &arrive;
+                }
+
+                static arrive_type arrive_of(std::false_type) {
+                    return nullptr;
+                }
+
+                static spawn_context_type spawn_context_of(std::true_type) {
+                    return &spawn_context;
+                }
+
+                static spawn_context_type spawn_context_of(std::false_type) {
+                    return nullptr;
+                }
+
+                static select_type select_of(std::true_type) {
+                    return &select;
+                }
+
+                static select_type select_of(std::false_type) {
+                    return nullptr;
+                }
+
+                // The table of a node of type T, and of a branch node of
+                // type T, which also selects its active edges.
+                template <bool Branch>
+                static const node_ops* get() {
+                    static const node_ops ops{
+                        &execute, &update, &fail, &valid, &reset, &port,
+                        &same, &rebind,
+                        arrive_of(is_reduce_node<type>()),
+                        spawn_context_of(is_spawn_node<type>()),
+                        select_of(std::integral_constant<bool, Branch>())
+                    };
+                    return &ops;
+                }
+            };
+
+            // Delivers the fallback result of an optional node.
+            template <typename T, typename V>
+            struct node_fallback {
+                V value;
+                void operator()(void* ptr) {
+                    static_cast<node<T>*>(ptr)->skip(value);
+                }
             };
 
             template <typename T>
-            struct node_validator {
-                bool operator()(void* ptr) {
-                    return static_cast<node<T>*>(ptr)->valid();
+            struct node_fallback<T, void> {
+                void operator()(void* ptr) {
+                    static_cast<node<T>*>(ptr)->skip();
                 }
             };
 
+            // The parallel protocol of a parallel node, type erased.
+            struct parallel_ops {
+                size_t (*begin)(void*);
+                void (*run)(void*, size_t, size_t);
+                void (*end)(void*);
+                size_t (*grain)(void*);
+            };
+
             template <typename T>
-            struct node_executor {
-                node_executor(void* ptr)
-                    : ptr_(ptr)
-                    {
-                    }
+            struct node_parallel {
+                static size_t begin(void* ptr) {
+                    return static_cast<node<T>*>(ptr)->parallel_begin();
+                }
+
+                static void run(void* ptr, size_t first, size_t last) {
+                    static_cast<node<T>*>(ptr)->parallel_run(first, last);
+                }
+
+                static void end(void* ptr) {
+                    static_cast<node<T>*>(ptr)->parallel_end();
+                }
+
+                static size_t grain(void* ptr) {
+                    return static_cast<node<T>*>(ptr)->parallel_grain();
+                }
+
+                static const parallel_ops* get() {
+                    static const parallel_ops ops{&begin, &run, &end, &grain};
+                    return &ops;
+                }
+            };
+
+            template <typename T>
+            static const parallel_ops* parallel_ops_of(std::true_type) {
+                return node_parallel<T>::get();
+            }
+
+            template <typename T>
+            static const parallel_ops* parallel_ops_of(std::false_type) {
+                return nullptr;
+            }
+
+            // The asynchronous protocol of a coroutine node, type erased.
+            struct async_ops {
+                void (*start)(void*, const async_target&);
+                void (*resume)(void*);
+                std::exception_ptr (*error)(void*);
+            };
 
-                void operator()() {
-                    (*static_cast<node<T>*>(ptr_))();
+            template <typename T>
+            struct node_async {
+                static void start(void* ptr, const async_target& target) {
+                    static_cast<node<T>*>(ptr)->async_start(target);
+                }
+
+                static void resume(void* ptr) {
+                    static_cast<node<T>*>(ptr)->async_resume();
+                }
+
+                static std::exception_ptr error(void* ptr) {
+                    return static_cast<node<T>*>(ptr)->async_error();
                 }
 
-                void* ptr_;
+                static const async_ops* get() {
+                    static const async_ops ops{&start, &resume, &error};
+                    return &ops;
+                }
             };
 
+            template <typename T>
+            static const async_ops* async_ops_of(std::true_type) {
+                return node_async<T>::get();
+            }
+
+            template <typename T>
+            static const async_ops* async_ops_of(std::false_type) {
+                return nullptr;
+            }
+
             template <typename T>
             graph_node(T&& t)
                 : node_(new node<T>(std::forward<T>(t)), node_deleter<T>()),
-                  exec_fn_(node_executor<T>(node_.get())),
-                  validator_fn_(node_validator<T>()),
-                  resetter_fn_(node_resetter<T>())
+                  ops_(node_operations<T>::template get<false>()),
+                  result_(&to_node<T>()->result_),
+                  parallel_(parallel_ops_of<T>(
+                                is_parallel_node<typename node<T>::type>())),
+                  async_(async_ops_of<T>(
+                             is_async_node<typename node<T>::type>())),
+                  fused_(nullptr),
+                  budget_(0),
+                  output_(false),
+                  pure_(false),
+                  type_(&typeid(typename node<T>::type)),
+                  id_(0)
                 {
                 }
 
+            // Make this node, which wraps a T, a branch node.
+            template <typename T>
+            void make_branch() {
+                ops_ = node_operations<T>::template get<true>();
+            }
+
             template <typename T>
             node<T>* to_node() const {
                 return static_cast<node<T>*>(node_.get());
             }
 
             bool valid() const {
-                return validator_fn_(node_.get());
+                return ops_->valid(node_.get());
+            }
+
+            void execute() const {
+                ops_->execute(node_.get());
+            }
+
+            bool update() const {
+                return ops_->update(node_.get());
+            }
+
+            void fail(std::exception_ptr error) const {
+                ops_->fail(node_.get(), std::move(error));
+            }
+
+            bool optional() const {
+                return static_cast<bool>(fallback_fn_);
+            }
+
+            // Deliver the fallback result instead of executing.
+            void skip() const {
+                fallback_fn_(node_.get());
             }
 
             template <typename R>
-            bool run(R& runner) const{
-                bool executed(exec_fn_());
-                if (executed) {
+            void release(R& runner) const {
+                if (!branch()) {
                     for (const graph_node* child : children_) {
-                        runner.enqueue_node(child);
+                        if (child->reduces()) {
+                            runner.arrive(this, child);
+                        }
+                        runner.release_node(child);
+                    }
+                    return;
+                }
+                size_t selected(ops_->select(node_.get()));
+                for (const graph_node* child : children_) {
+                    bool is_active(active(child, selected));
+                    if (is_active && child->reduces()) {
+                        runner.arrive(this, child);
+                    }
+                    runner.release_node(child, is_active);
+                }
+            }
+
+            bool reduces() const {
+                return ops_->arrive != nullptr;
+            }
+
+            // Pass each input of this reduce node bound to `source`,
+            // which has just finished, to the reduction.
+            void arrive(const graph_node* source) const {
+                for (const binding& input : inputs_) {
+                    if (input.source == source && input.to >= 0) {
+                        ops_->arrive(node_.get(), static_cast<size_t>(input.to));
+                    }
+                }
+            }
+
+            bool branch() const {
+                return ops_->select != nullptr;
+            }
+
+            // Whether the edge to `child` is active when this branch
+            // selects `selected`. Edges without a case are always active.
+            bool active(const graph_node* child, size_t selected) const {
+                bool labelled(false);
+                for (const branch_case& c : cases_) {
+                    if (c.target == child) {
+                        if (c.value == selected) {
+                            return true;
+                        }
+                        labelled = true;
                     }
                 }
-                return executed;
+                return !labelled;
+            }
+
+            bool has_case(const graph_node* child) const {
+                return std::any_of(cases_.begin(), cases_.end(),
+                                   [child](const branch_case& c) {
+                                       return c.target == child;
+                                   });
             }
 
             void reset(){
-                exec_fn_.reset();
-                resetter_fn_(node_.get());
+                ops_->reset(node_.get());
+            }
+
+            // Destroy the result once every consumer has read it.
+            void release_result() const {
+                ops_->reset(node_.get());
+            }
+
+            bool parallel() const {
+                return parallel_ != nullptr;
+            }
+
+            // Prepare a parallel node, and return the size of its range.
+            size_t parallel_begin() const {
+                return parallel_->begin(node_.get());
+            }
+
+            void parallel_run(size_t first, size_t last) const {
+                parallel_->run(node_.get(), first, last);
+            }
+
+            // Publish a parallel node's result, once its whole range has run.
+            void parallel_end() const {
+                parallel_->end(node_.get());
+            }
+
+            size_t parallel_grain() const {
+                return parallel_->grain(node_.get());
+            }
+
+            // Whether this node may run `child`, its only child, which
+            // has no other parent, directly after itself.
+            bool fusible(const graph_node* child) const {
+                return simple() && !branch() && child->simple();
+            }
+
+            // Whether the node runs by a plain call, and releases its
+            // children as soon as it returns.
+            bool simple() const {
+                return !parallel() && !suspends() && !spawns() && !optional() &&
+                    !reduces();
+            }
+
+            bool spawns() const {
+                return ops_->spawn_context != nullptr;
+            }
+
+            // The context through which a spawning node spawns tasks.
+            callgraph::spawn_context* spawn_context() const {
+                return ops_->spawn_context(node_.get());
+            }
+
+            bool suspends() const {
+                return async_ != nullptr;
+            }
+
+            // Start a coroutine node, which reports to `target` as it
+            // suspends and finishes.
+            void async_start(const async_target& target) const {
+                async_->start(node_.get(), target);
+            }
+
+            // Continue a suspended coroutine node on this thread.
+            void async_resume() const {
+                async_->resume(node_.get());
+            }
+
+            // The exception which ended a finished coroutine node, if any.
+            std::exception_ptr async_error() const {
+                return async_->error(node_.get());
+            }
+
+            // The streaming end of parameter `to`.
+            node_stream_port* port(size_t to) const {
+                return ops_->port(node_.get(), to);
+            }
+
+            bool output() const {
+                return output_;
+            }
+
+            bool pure() const {
+                return pure_;
+            }
+
+            // Whether this node always computes the same result as
+            // `other`: the same function, bound to the same inputs.
+            bool same(const graph_node& other) const {
+                if (*type_ != *other.type_ ||
+                    inputs_.size() != other.inputs_.size() ||
+                    !ops_->same(node_.get(), other.node_.get())) {
+                    return false;
+                }
+                return sorted_inputs() == other.sorted_inputs();
+            }
+
+            // Read the result of `to`, which has the same type as `from`,
+            // wherever this node reads the result of `from`.
+            void rebind(const graph_node* from, const graph_node* to) {
+                for (binding& input : inputs_) {
+                    if (input.source == from) {
+                        input.source = to;
+                    }
+                }
+                ops_->rebind(node_.get(), *from->result_, *to->result_);
+            }
+
+            size_t id() const {
+                return id_;
             }
 
             void add_child(const graph_node* child)  {
                 children_.insert(child);
             }
 
+            void add_input(const graph_node* source, int from, int to) {
+                inputs_.push_back(binding{source, from, to});
+            }
+
             size_t depth() const {
                 size_t d(0);
                 for (const graph_node* child : children_) {
@@ -138,11 +540,34 @@ namespace callgraph {
                 return distance;
             }
         private:
+            std::vector<std::tuple<const graph_node*, int, int>> sorted_inputs() const {
+                std::vector<std::tuple<const graph_node*, int, int>> sorted;
+                sorted.reserve(inputs_.size());
+                for (const binding& input : inputs_) {
+                    sorted.emplace_back(input.source, input.from, input.to);
+                }
+                std::sort(sorted.begin(), sorted.end());
+                return sorted;
+            }
+
             std::unordered_set<const graph_node*> children_;
             std::shared_ptr<void> node_;
-            invoke_once exec_fn_;
-            std::function<bool(void*)> validator_fn_;
-            std::function<void(void*)> resetter_fn_;
+            const node_ops* ops_;
+            node_value_base* result_;
+            const parallel_ops* parallel_;
+            const async_ops* async_;
+            // Holds the fallback value of an optional node.
+            std::function<void(void*)> fallback_fn_;
+            // The next link of a fused chain, run directly after this node.
+            const graph_node* fused_;
+            std::chrono::nanoseconds budget_;
+            std::vector<branch_case> cases_;
+            bool output_;
+            bool pure_;
+            std::vector<binding> inputs_;
+            std::string name_;
+            const std::type_info* type_;
+            size_t id_;
         };
 
         template <typename T, typename>
@@ -7,7 +7,9 @@
 #include <callgraph/graph_runner.hpp>
 #include <callgraph/detail/graph_node.hpp>
 
+#include <exception>
 #include <thread>
+#include <vector>
 
 #ifndef NO_DOC
 namespace callgraph {
@@ -17,6 +19,7 @@ namespace callgraph {
         struct graph_worker {
             graph_worker(graph_runner& runner)
                 : runner_(&runner),
+                  ready_(reserved(runner.node_count())),
                   thread_(std::bind(&graph_worker::work, this))
                 {
                 }
@@ -32,48 +35,384 @@ namespace callgraph {
             graph_worker& operator=(graph_worker&&) = default;
 
         private:
-            const graph_node* get_task() {
-                const graph_node* task(nullptr);
+            friend struct graph_node;
+            using queue_entry = graph_runner::queue_entry;
+            using clock_type = graph_runner::clock_type;
+            using counters_type = graph_runner::runner_counters;
+
+            bool get_task(queue_entry& task) {
+                bool found(false);
+                auto start(clock_type::now());
                 {
                     std::unique_lock<std::mutex> lk(runner_->queue_mutex_);
 
-                    runner_->queue_avail_.wait(lk, [this] {
-                            return !runner_->on_ || !runner_->queue_.empty();
-                        });
+                    auto ready = [this] {
+                        return !runner_->on_ || !runner_->queue_.empty();
+                    };
+                    if (!ready()) {
+                        auto blocked(clock_type::now());
+                        while (!ready()) {
+                            if (!runner_->awaiting_stop()) {
+                                runner_->queue_avail_.wait(lk);
+                            }
+                            else {
+                                auto run(runner_->counters_.runs_started.load(
+                                             std::memory_order_relaxed));
+                                if (runner_->queue_avail_.wait_until(
+                                        lk, runner_->check_time()) ==
+                                    std::cv_status::timeout) {
+                                    // Expire the run, so that the nodes still
+                                    // executing can see it through the token.
+                                    lk.unlock();
+                                    runner_->expire(run);
+                                    lk.lock();
+                                }
+                            }
+                        }
+                        counters_type::add(runner_->counters_.queue_blocked_time,
+                                           clock_type::now() - blocked);
+                    }
 
                     if (runner_->on_ && !runner_->queue_.empty()) {
                         task = runner_->queue_.front();
                         runner_->queue_.pop();
+                        found = true;
                     }
                 }
-                return task;
+                counters_type::add(runner_->counters_.idle_time,
+                                   clock_type::now() - start);
+                return found;
             }
-            void run_task(const graph_node* task)  {
-                if (task->run(*runner_) && task->children_.size() == 0) {
-                    // Mark a leaf as done.
-                    std::unique_lock<std::mutex> lk(runner_->done_mutex_);
-                    runner_->leaves_--;
-                    if (runner_->leaves_ == 0) {
-                        // Finished.
-                        runner_->done_.set_value();
+            void run_task(const queue_entry& task)  {
+                const graph_node* node(task.node);
+                auto& counters(runner_->counters_);
+                auto start(clock_type::now());
+                if (task.kind == graph_runner::entry_kind::resumed) {
+                    // Suspended coroutines continue even once the run has
+                    // stopped, so that they can finish.
+                    node->async_resume();
+                    counters_type::add(counters.busy_time, clock_type::now() - start);
+                    finish_task();
+                    return;
+                }
+                if (runner_->stopped(start)) {
+                    // The run has failed or been cancelled, so short-circuit.
+                    counters.tasks_skipped.fetch_add(1, std::memory_order_relaxed);
+                    finish_task();
+                    return;
+                }
+                if (task.kind == graph_runner::entry_kind::helper) {
+                    run_chunks(node);
+                    finish_task();
+                    return;
+                }
+                if (task.kind == graph_runner::entry_kind::spawned) {
+                    run_spawned(node, task.task, start);
+                    finish_task();
+                    return;
+                }
+                auto& stats(runner_->states_[node->id()]);
+                stats.queue_wait.record(start - task.enqueued);
+                bool incremental(runner_->incremental_);
+                if (node->optional() &&
+                    start - runner_->started_ >= node->budget_) {
+                    // Out of time, so deliver the fallback instead.
+                    node->skip();
+                    counters.tasks_bypassed.fetch_add(1, std::memory_order_relaxed);
+                    if (incremental) {
+                        runner_->bypassed(node);
+                    }
+                    else {
+                        runner_->release_inputs(node);
+                    }
+                    node->release(*runner_);
+                    finish_task();
+                    return;
+                }
+                if (incremental && !runner_->must_update(node)) {
+                    // Nothing this node depends on has changed.
+                    counters.tasks_reused.fetch_add(1, std::memory_order_relaxed);
+                    node->release(*runner_);
+                    finish_task();
+                    return;
+                }
+
+                if (!incremental && node->parallel()) {
+                    run_parallel(node, start);
+                    finish_task();
+                    return;
+                }
+
+                if (!incremental && node->suspends()) {
+                    run_async(node, start);
+                    finish_task();
+                    return;
+                }
+
+                if (!incremental && stats.fused) {
+                    run_chain(node, start);
+                    finish_task();
+                    return;
+                }
+
+                if (node->spawns()) {
+                    // Incremental executions run spawned tasks inline.
+                    node->spawn_context()->begin(
+                        incremental ? nullptr : &graph_runner::schedule_spawned,
+                        runner_, node);
+                }
+
+                bool changed(true);
+                try {
+                    if (incremental) {
+                        changed = node->update();
+                    }
+                    else {
+                        node->execute();
+                    }
+                }
+                catch(...) {
+                    fail(node);
+                }
+                auto finish(clock_type::now());
+                runner_->executed(node, finish - start);
+                counters_type::add(counters.busy_time, finish - start);
+                counters.tasks_executed.fetch_add(1, std::memory_order_relaxed);
+
+                if (incremental) {
+                    if (!runner_->stopped(finish)) {
+                        runner_->updated(node, changed);
+                        node->release(*runner_);
                     }
                 }
+                else {
+                    join(node, finish);
+                }
+                finish_task();
             }
-            void handle_exception() {
-                runner_->clear_queue();
-                {
-                    std::unique_lock<std::mutex> lk(runner_->done_mutex_);
+
+            // Run the fused chain which starts at `node`, running each link
+            // as soon as the one before it returns, on this worker.
+            void run_chain(const graph_node* node, clock_type::time_point start) {
+                auto& counters(runner_->counters_);
+                for (;;) {
                     try {
-                        runner_->done_.set_exception(std::current_exception());
+                        node->execute();
                     }
-                    catch(...) {}
+                    catch(...) {
+                        fail(node);
+                    }
+                    auto& stats(runner_->states_[node->id()]);
+                    auto finish(clock_type::now());
+                    runner_->executed(node, finish - start);
+                    counters_type::add(counters.busy_time, finish - start);
+                    counters.tasks_executed.fetch_add(1, std::memory_order_relaxed);
+                    if (runner_->stopped(finish)) {
+                        return;
+                    }
+                    runner_->release_inputs(node);
+                    if (!stats.fused) {
+                        node->release(*this);
+                        return;
+                    }
+                    if (!runner_->claim_fused(stats.fused)) {
+                        return;
+                    }
+                    node = stats.fused;
+                    start = finish;
                 }
             }
+
+            // Run a task spawned by `node`.
+            void run_spawned(const graph_node* node, spawn_task* task,
+                             clock_type::time_point start) {
+                try {
+                    node->spawn_context()->run(task);
+                }
+                catch(...) {
+                    fail(node);
+                }
+                auto finish(clock_type::now());
+                counters_type::add(runner_->counters_.busy_time, finish - start);
+                join(node, finish);
+            }
+
+            // Start an asynchronous node, which finishes through the
+            // runner, freeing this worker whenever it waits.
+            void run_async(const graph_node* node, clock_type::time_point start) {
+                try {
+                    runner_->start_async(node, start);
+                }
+                catch(...) {
+                    // The node never started, so release its hold.
+                    fail(node);
+                    runner_->finish_node();
+                }
+                counters_type::add(runner_->counters_.busy_time,
+                                   clock_type::now() - start);
+            }
+
+            // Release the children of a node once it, and every task it
+            // spawned, has finished.
+            void join(const graph_node* node, clock_type::time_point now) {
+                if (node->spawns()) {
+                    callgraph::spawn_context* context(node->spawn_context());
+                    if (!context->join()) {
+                        return;
+                    }
+                    if (context->error()) {
+                        node->fail(context->error());
+                    }
+                }
+                if (!runner_->stopped(now)) {
+                    runner_->release_inputs(node);
+                    node->release(*this);
+                }
+            }
+            // Run a parallel node, claiming chunks of its range alongside
+            // any helpers until none are left.
+            void run_parallel(const graph_node* node, clock_type::time_point start) {
+                size_t range(0);
+                try {
+                    range = node->parallel_begin();
+                }
+                catch(...) {
+                    fail(node);
+                    return;
+                }
+                runner_->start_range(node, range, start);
+                if (range == 0) {
+                    finish_parallel(node);
+                    return;
+                }
+                run_chunks(node);
+            }
+
+            void run_chunks(const graph_node* node) {
+                auto& counters(runner_->counters_);
+                size_t first(0), last(0);
+                for (;;) {
+                    auto start(clock_type::now());
+                    if (runner_->stopped(start) ||
+                        !runner_->claim_chunk(node, first, last)) {
+                        return;
+                    }
+                    try {
+                        node->parallel_run(first, last);
+                    }
+                    catch(...) {
+                        fail(node);
+                        return;
+                    }
+                    counters_type::add(counters.busy_time, clock_type::now() - start);
+                    if (runner_->complete_chunk(node, last - first)) {
+                        finish_parallel(node);
+                        return;
+                    }
+                }
+            }
+
+            // Called by whichever worker completes the last chunk.
+            void finish_parallel(const graph_node* node) {
+                auto& stats(runner_->states_[node->id()]);
+                try {
+                    node->parallel_end();
+                }
+                catch(...) {
+                    fail(node);
+                }
+                auto finish(clock_type::now());
+                runner_->executed(node, finish - stats.started);
+                runner_->counters_.tasks_executed.fetch_add(
+                    1, std::memory_order_relaxed);
+                if (!runner_->stopped(finish)) {
+                    runner_->release_inputs(node);
+                    node->release(*this);
+                }
+            }
+
+            // Forward the arrival of `parent` at the reduce node `node`.
+            void arrive(const graph_node* parent, const graph_node* node) {
+                runner_->arrive(parent, node);
+            }
+
+            // Called by graph_node::release for each child of a node this
+            // worker finished. Children cheap enough to inline are kept, to
+            // run before the task which released them is accounted for.
+            void release_node(const graph_node* node, bool active = true) {
+                if (!runner_->ready_node(node, active)) {
+                    return;
+                }
+                if (!runner_->states_[node->id()].inlined || runner_->incremental_) {
+                    runner_->schedule_node(node);
+                    return;
+                }
+                ready_.push_back(node);
+            }
+
+            // Run the nodes released inline, and the nodes they release in
+            // turn, then account for the task which released them.
+            void finish_task() {
+                auto& counters(runner_->counters_);
+                while (!ready_.empty()) {
+                    const graph_node* node(ready_.back());
+                    ready_.pop_back();
+                    auto start(clock_type::now());
+                    if (runner_->stopped(start)) {
+                        counters.tasks_skipped.fetch_add(ready_.size() + 1,
+                                                         std::memory_order_relaxed);
+                        ready_.clear();
+                        break;
+                    }
+                    counters.tasks_inlined.fetch_add(1, std::memory_order_relaxed);
+                    if (runner_->states_[node->id()].fused) {
+                        run_chain(node, start);
+                        continue;
+                    }
+                    try {
+                        node->execute();
+                    }
+                    catch(...) {
+                        fail(node);
+                    }
+                    auto finish(clock_type::now());
+                    runner_->executed(node, finish - start);
+                    counters_type::add(counters.busy_time, finish - start);
+                    counters.tasks_executed.fetch_add(1, std::memory_order_relaxed);
+                    join(node, finish);
+                }
+                runner_->finish_node();
+            }
+
+            void fail(const graph_node* node) {
+                std::exception_ptr error(std::current_exception());
+                if (node->spawns() && !runner_->incremental_) {
+                    // The node and its tasks may fail on several workers
+                    // at once, so the last to join stores the error.
+                    node->spawn_context()->fail(error);
+                }
+                else {
+                    node->fail(error);
+                }
+                runner_->fail(std::move(error));
+            }
+
+            void handle_exception() {
+                std::exception_ptr error(std::current_exception());
+                runner_->fail(error);
+                std::unique_lock<std::mutex> lk(runner_->done_mutex_);
+                try {
+                    runner_->done_.set_exception(std::move(error));
+                }
+                catch(...) {}
+            }
             void work() {
-                while (runner_->on_) {
+                // get_task reads the on flag under the queue lock, and
+                // fails once the runner is shutting down.
+                for (;;) {
                     try {
-                        const graph_node* task(get_task());
-                        if (!task) {
+                        queue_entry task;
+                        if (!get_task(task)) {
                             break;
                         }
                         run_task(task);
@@ -84,7 +423,17 @@ namespace callgraph {
                 }
             }
 
+            // Room for every node, so that inlining never allocates, even
+            // in the first execution of a preallocated runner.
+            static std::vector<const graph_node*> reserved(size_t n) {
+                std::vector<const graph_node*> v;
+                v.reserve(n);
+                return v;
+            }
+
             graph_runner* runner_;
+            // Nodes released inline by the current task, not yet run.
+            std::vector<const graph_node*> ready_;
             std::thread thread_;
         };
 
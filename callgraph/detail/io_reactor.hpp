@@ -0,0 +1,339 @@
+// callgraph/detail/io_reactor.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_DETAIL_IO_REACTOR_HPP
+#define CALLGRAPH_DETAIL_IO_REACTOR_HPP
+
+#if defined(__linux__) && !defined(CALLGRAPH_NO_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define CALLGRAPH_HAS_IO_URING 1
+#endif
+#endif
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef CALLGRAPH_HAS_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+#ifndef NO_DOC
+namespace callgraph {
+    namespace detail {
+        // A read or write of part of a file, submitted to an io_reactor.
+        // The request must stay put until it completes.
+        struct io_request {
+            enum kind_type {
+                read,
+                write
+            };
+
+            kind_type kind;
+            int fd;
+            void* buffer;
+            size_t length;
+            std::uint64_t offset;
+            // Performs the request by blocking, for the thread pool.
+            long (*perform)(io_request*);
+            // Called once, on the reactor's thread, with the number of
+            // bytes transferred or a negated errno.
+            void (*complete)(io_request*, long result);
+            void* context;
+#ifdef CALLGRAPH_HAS_IO_URING
+            struct iovec iov;
+#endif
+        };
+
+        // Completes file I/O off the runner's workers. Requests go to
+        // io_uring where the kernel supports it, and otherwise to a small
+        // pool of threads which block on them.
+        class io_reactor {
+        public:
+            explicit io_reactor(bool uring = true, size_t threads = 2)
+                : stopping_(false),
+                  ring_fd_(-1)
+                {
+#ifdef CALLGRAPH_HAS_IO_URING
+                    if (uring && setup_ring()) {
+                        threads_.emplace_back(&io_reactor::reap, this);
+                        return;
+                    }
+#else
+                    (void)uring;
+#endif
+                    for (size_t i = 0; i < threads; i++) {
+                        threads_.emplace_back(&io_reactor::serve, this);
+                    }
+                }
+
+            ~io_reactor() {
+                {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    stopping_ = true;
+                }
+#ifdef CALLGRAPH_HAS_IO_URING
+                if (ring_fd_ >= 0) {
+                    wake();
+                }
+#endif
+                available_.notify_all();
+                for (std::thread& t : threads_) {
+                    t.join();
+                }
+#ifdef CALLGRAPH_HAS_IO_URING
+                if (ring_fd_ >= 0) {
+                    unmap_ring();
+                    ::close(ring_fd_);
+                }
+#endif
+            }
+
+            io_reactor(const io_reactor&) = delete;
+            io_reactor& operator=(const io_reactor&) = delete;
+
+            // Whether requests are submitted through io_uring.
+            bool uring() const {
+                return ring_fd_ >= 0;
+            }
+
+            void submit(io_request* request) {
+#ifdef CALLGRAPH_HAS_IO_URING
+                if (ring_fd_ >= 0) {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    if (in_flight_ == sq_entries_) {
+                        // The ring is full; the reaper submits this later.
+                        backlog_.push_back(request);
+                        return;
+                    }
+                    push(request);
+                    enter(1, 0, 0);
+                    return;
+                }
+#endif
+                {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    backlog_.push_back(request);
+                }
+                available_.notify_one();
+            }
+
+        private:
+            // Thread pool fallback.
+            void serve() {
+                for (;;) {
+                    io_request* request(nullptr);
+                    {
+                        std::unique_lock<std::mutex> lk(mutex_);
+                        available_.wait(lk, [this] {
+                                return stopping_ || !backlog_.empty();
+                            });
+                        if (backlog_.empty()) {
+                            return;
+                        }
+                        request = backlog_.front();
+                        backlog_.pop_front();
+                    }
+                    request->complete(request, request->perform(request));
+                }
+            }
+
+#ifdef CALLGRAPH_HAS_IO_URING
+            bool setup_ring() {
+                io_uring_params params;
+                std::memset(&params, 0, sizeof(params));
+                int fd(static_cast<int>(::syscall(__NR_io_uring_setup, 256, &params)));
+                if (fd < 0) {
+                    return false;
+                }
+                ring_fd_ = fd;
+                sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+                cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+                single_mmap_ = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+                if (single_mmap_) {
+                    sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+                }
+                sq_ring_ = ::mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+                cq_ring_ = single_mmap_ ? sq_ring_ :
+                    ::mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+                sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+                void* sqes(::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+                if (sq_ring_ == MAP_FAILED || cq_ring_ == MAP_FAILED ||
+                    sqes == MAP_FAILED) {
+                    sqes_ = sqes == MAP_FAILED ? nullptr :
+                        static_cast<io_uring_sqe*>(sqes);
+                    unmap_ring();
+                    ::close(fd);
+                    ring_fd_ = -1;
+                    return false;
+                }
+                sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+                char* sq(static_cast<char*>(sq_ring_));
+                sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+                sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+                sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+                char* cq(static_cast<char*>(cq_ring_));
+                cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+                cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+                cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+                cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+                sq_entries_ = params.sq_entries;
+                in_flight_ = 0;
+                return true;
+            }
+
+            void unmap_ring() {
+                if (sqes_) {
+                    ::munmap(sqes_, sqes_size_);
+                }
+                if (cq_ring_ && cq_ring_ != MAP_FAILED && !single_mmap_) {
+                    ::munmap(cq_ring_, cq_size_);
+                }
+                if (sq_ring_ && sq_ring_ != MAP_FAILED) {
+                    ::munmap(sq_ring_, sq_size_);
+                }
+            }
+
+            int enter(unsigned submit, unsigned wait, unsigned flags) {
+                int n;
+                do {
+                    n = static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd_,
+                                                   submit, wait, flags, nullptr, 0));
+                } while (n < 0 && errno == EINTR);
+                return n;
+            }
+
+            // Queue an entry for `request`, or a no-op to wake the reaper
+            // if it is null. The caller must hold the lock.
+            void push(io_request* request) {
+                unsigned tail(*sq_tail_);
+                unsigned index(tail & sq_mask_);
+                io_uring_sqe& sqe(sqes_[index]);
+                std::memset(&sqe, 0, sizeof(sqe));
+                if (request) {
+                    request->iov.iov_base = request->buffer;
+                    request->iov.iov_len = request->length;
+                    sqe.opcode = request->kind == io_request::read ?
+                        IORING_OP_READV : IORING_OP_WRITEV;
+                    sqe.fd = request->fd;
+                    sqe.addr = reinterpret_cast<std::uint64_t>(&request->iov);
+                    sqe.len = 1;
+                    sqe.off = request->offset;
+                }
+                else {
+                    sqe.opcode = IORING_OP_NOP;
+                }
+                sqe.user_data = reinterpret_cast<std::uint64_t>(request);
+                sq_array_[index] = index;
+                in_flight_++;
+                __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+            }
+
+            void wake() {
+                std::unique_lock<std::mutex> lk(mutex_);
+                // The no-op may have to wait for a free entry.
+                while (in_flight_ == sq_entries_) {
+                    lk.unlock();
+                    std::this_thread::yield();
+                    lk.lock();
+                }
+                push(nullptr);
+                enter(1, 0, 0);
+            }
+
+            // Reap completions, and pass them back to their requests.
+            // Completions are collected under the lock which submitted
+            // them, so that the requests are seen as they were submitted.
+            void reap() {
+                bool stopping(false);
+                std::vector<std::pair<io_request*, long>> completed;
+                for (;;) {
+                    enter(0, 1, IORING_ENTER_GETEVENTS);
+                    completed.clear();
+                    {
+                        std::unique_lock<std::mutex> lk(mutex_);
+                        unsigned head(*cq_head_);
+                        unsigned tail(__atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE));
+                        for (; head != tail; head++) {
+                            const io_uring_cqe& cqe(cqes_[head & cq_mask_]);
+                            io_request* request(
+                                reinterpret_cast<io_request*>(cqe.user_data));
+                            if (request) {
+                                completed.emplace_back(request, cqe.res);
+                            }
+                            else {
+                                stopping = true;
+                            }
+                            in_flight_--;
+                        }
+                        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+                        unsigned queued(0);
+                        while (!backlog_.empty() && in_flight_ < sq_entries_) {
+                            push(backlog_.front());
+                            backlog_.pop_front();
+                            queued++;
+                        }
+                        if (queued > 0) {
+                            enter(queued, 0, 0);
+                        }
+                    }
+                    for (const auto& c : completed) {
+                        c.first->complete(c.first, c.second);
+                    }
+                    if (stopping) {
+                        // Completions may have submitted more requests.
+                        std::unique_lock<std::mutex> lk(mutex_);
+                        if (in_flight_ == 0 && backlog_.empty()) {
+                            return;
+                        }
+                    }
+                }
+            }
+
+            void* sq_ring_ = nullptr;
+            void* cq_ring_ = nullptr;
+            size_t sq_size_ = 0;
+            size_t cq_size_ = 0;
+            size_t sqes_size_ = 0;
+            bool single_mmap_ = false;
+            io_uring_sqe* sqes_ = nullptr;
+            unsigned* sq_tail_ = nullptr;
+            unsigned* sq_array_ = nullptr;
+            unsigned sq_mask_ = 0;
+            unsigned sq_entries_ = 0;
+            unsigned* cq_head_ = nullptr;
+            unsigned* cq_tail_ = nullptr;
+            unsigned cq_mask_ = 0;
+            io_uring_cqe* cqes_ = nullptr;
+            // Entries submitted and not yet reaped, under the lock.
+            unsigned in_flight_ = 0;
+#endif // CALLGRAPH_HAS_IO_URING
+
+            std::mutex mutex_;
+            std::condition_variable available_;
+            bool stopping_;
+            // Requests waiting for the thread pool, or for room in the ring.
+            std::deque<io_request*> backlog_;
+            int ring_fd_;
+            std::vector<std::thread> threads_;
+        };
+    }
+}
+#endif // NO_DOC
+#endif // CALLGRAPH_DETAIL_IO_REACTOR_HPP
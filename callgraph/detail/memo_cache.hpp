@@ -0,0 +1,169 @@
+// callgraph/detail/memo_cache.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_DETAIL_MEMO_CACHE_HPP
+#define CALLGRAPH_DETAIL_MEMO_CACHE_HPP
+
+#include <callgraph/memo_statistics.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifndef NO_DOC
+namespace callgraph {
+    namespace detail {
+
+        inline void memo_hash_combine(size_t& seed, size_t h) {
+            seed ^= h + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        }
+
+        // Hashes a tuple of values by combining std::hash of each.
+        template <typename T>
+        struct memo_key_hash;
+
+        template <typename... Ts>
+        struct memo_key_hash<std::tuple<Ts...>> {
+            size_t operator()(const std::tuple<Ts...>& key) const {
+                return apply(key, std::integral_constant<size_t, 0>());
+            }
+
+        private:
+            template <size_t N>
+            static size_t apply(const std::tuple<Ts...>& key,
+                                std::integral_constant<size_t, N>) {
+                size_t seed(apply(key, std::integral_constant<size_t, N + 1>()));
+                memo_hash_combine(seed, std::hash<
+                                  typename std::tuple_element<N, std::tuple<Ts...>>::type>()(
+                                      std::get<N>(key)));
+                return seed;
+            }
+
+            static size_t apply(const std::tuple<Ts...>&,
+                                std::integral_constant<size_t, sizeof...(Ts)>) {
+                return 0;
+            }
+        };
+
+        // A bounded cache split into independently locked shards, each
+        // evicting with the CLOCK algorithm: entries are marked when
+        // read, and the clock hand evicts the first unmarked entry it
+        // finds, clearing marks as it passes.
+        template <typename Key, typename Value, typename Hash = memo_key_hash<Key>>
+        class memo_cache {
+        public:
+            explicit memo_cache(size_t capacity)
+                : capacity_(std::max<size_t>(capacity, 1)),
+                  shard_count_(std::min<size_t>(max_shards, capacity_)),
+                  shards_(new shard[shard_count_])
+                {
+                    size_t per_shard((capacity_ + shard_count_ - 1) / shard_count_);
+                    for (size_t i = 0; i < shard_count_; i++) {
+                        shards_[i].capacity = per_shard;
+                        shards_[i].entries.reserve(per_shard);
+                        shards_[i].index.reserve(per_shard);
+                    }
+                }
+
+            memo_cache(const memo_cache&) = delete;
+            memo_cache& operator=(const memo_cache&) = delete;
+
+            // Pass the value cached for `key`, if any, to `on_hit`.
+            template <typename F>
+            bool find(const Key& key, F&& on_hit) {
+                size_t h(hash_(key));
+                shard& s(shards_[h % shard_count_]);
+                {
+                    std::unique_lock<std::mutex> lk(s.mutex);
+                    auto found(s.index.find(key));
+                    if (found != s.index.end()) {
+                        entry& e(s.entries[found->second]);
+                        e.referenced = true;
+                        on_hit(static_cast<const Value&>(e.value));
+                        hits_.fetch_add(1, std::memory_order_relaxed);
+                        return true;
+                    }
+                }
+                misses_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+
+            void insert(Key key, Value value) {
+                size_t h(hash_(key));
+                shard& s(shards_[h % shard_count_]);
+                std::unique_lock<std::mutex> lk(s.mutex);
+                auto found(s.index.find(key));
+                if (found != s.index.end()) {
+                    s.entries[found->second].value = std::move(value);
+                    return;
+                }
+                if (s.entries.size() < s.capacity) {
+                    s.index.emplace(key, s.entries.size());
+                    s.entries.push_back(entry{std::move(key), std::move(value), false});
+                    return;
+                }
+                while (s.entries[s.hand].referenced) {
+                    s.entries[s.hand].referenced = false;
+                    s.hand = (s.hand + 1) % s.entries.size();
+                }
+                entry& victim(s.entries[s.hand]);
+                s.index.erase(victim.key);
+                s.index.emplace(key, s.hand);
+                victim.key = std::move(key);
+                victim.value = std::move(value);
+                s.hand = (s.hand + 1) % s.entries.size();
+                evictions_.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            memo_statistics statistics() const {
+                memo_statistics m;
+                m.hits = hits_.load(std::memory_order_relaxed);
+                m.misses = misses_.load(std::memory_order_relaxed);
+                m.evictions = evictions_.load(std::memory_order_relaxed);
+                m.capacity = capacity_;
+                for (size_t i = 0; i < shard_count_; i++) {
+                    std::unique_lock<std::mutex> lk(shards_[i].mutex);
+                    m.size += shards_[i].entries.size();
+                }
+                return m;
+            }
+
+        private:
+            enum : size_t {
+                max_shards = 16
+            };
+
+            struct entry {
+                Key key;
+                Value value;
+                bool referenced;
+            };
+
+            struct shard {
+                std::mutex mutex;
+                std::vector<entry> entries;
+                std::unordered_map<Key, size_t, Hash> index;
+                size_t capacity = 0;
+                size_t hand = 0;
+            };
+
+            size_t capacity_;
+            size_t shard_count_;
+            std::unique_ptr<shard[]> shards_;
+            Hash hash_;
+            std::atomic<std::uint64_t> hits_{0};
+            std::atomic<std::uint64_t> misses_{0};
+            std::atomic<std::uint64_t> evictions_{0};
+        };
+
+    }
+}
+#endif // NO_DOC
+#endif // CALLGRAPH_DETAIL_MEMO_CACHE_HPP
@@ -4,13 +4,25 @@
 #ifndef CALLGRAPH_DETAIL_NODE_HPP
 #define CALLGRAPH_DETAIL_NODE_HPP
 
+#include <callgraph/detail/async_target.hpp>
 #include <callgraph/detail/node_call.hpp>
+#include <callgraph/detail/node_memo.hpp>
 #include <callgraph/detail/node_param_list.hpp>
 #include <callgraph/detail/node_traits.hpp>
 #include <callgraph/detail/node_value.hpp>
 
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 #ifndef NO_DOC
-namespace callgraph { namespace detail {
+namespace callgraph {
+    class spawn_context;
+
+    namespace detail {
 
         template <typename T>
         struct node_base;
@@ -34,37 +46,59 @@ namespace callgraph { namespace detail {
             template <typename T>
             void call(T& t) {
                 using signature = typename node_traits<T>::signature;
+                if (memo_ && memo_->lookup(params_, result_)) {
+                    return;
+                }
                 node_call<signature>::apply(t, params_, result_);
+                if (memo_) {
+                    memo_->store(result_);
+                }
             }
 
             bool valid() const {
                 return params_.valid();
             }
 
+            void memoize(size_t capacity) {
+                memo_.reset(new node_memo_cache<R, Params...>(capacity));
+            }
+
+            memo_statistics memo_stats() const {
+                return memo_ ? memo_->statistics() : memo_statistics();
+            }
+
             void reset() {
                 result_.reset();
             }
 
+            node_stream_port* port(size_t n) const {
+                return params_.port(n);
+            }
+
+            void rebind(const node_value_base& from, node_value_base& to) {
+                params_.rebind(from, to);
+            }
+
             node_value<R> result_;
             node_param_list<Params...> params_;
+            std::unique_ptr<node_memo<R, Params...>> memo_;
         };
 
         template <typename R>
         struct node_base<R ()> {
             node_base()
-                : input_(nullptr)
                 {
                 }
 
             template <typename T>
             void connect(node_base<T>& source) {
-                input_ = &source.result_;
+                inputs_.push_back(&source.result_);
             }
 
             template <typename T>
             void call(T& t) {
                 using signature = typename node_traits<T>::signature;
-                node_call<signature>::apply(t, input_, result_);
+                node_call<signature>::apply(t, inputs_, result_);
             }
 
             void reset() {
@@ -72,13 +106,86 @@ namespace callgraph { namespace detail {
             }
 
             bool valid() const {
-                return input_ != nullptr;
+                return !inputs_.empty();
+            }
+
+            node_stream_port* port(size_t) const {
+                return nullptr;
+            }
+
+            void rebind(const node_value_base& from, node_value_base& to) {
+                std::replace(inputs_.begin(), inputs_.end(),
+                             &from, static_cast<const node_value_base*>(&to));
             }
 
-            node_value<void>* input_;
+            // Ordering edges only; the sources' results are not read.
+            std::vector<const node_value_base*> inputs_;
             node_value<R> result_;
         };
 
+        template <typename T, typename = void>
+        struct is_equality_comparable : std::false_type
+        {};
+
+        template <typename T>
+        struct is_equality_comparable<
+            T, decltype(void(std::declval<const T&>() == std::declval<const T&>()))>
+            : std::true_type
+        {};
+
+        // Nodes which can split their work across workers.
+        template <typename T, typename = void>
+        struct is_parallel_node : std::false_type
+        {};
+
+        template <typename T>
+        struct is_parallel_node<T, typename T::parallel_category>
+            : std::true_type
+        {};
+
+        // Nodes which take any number of inputs of one type.
+        template <typename T, typename = void>
+        struct is_gather_node : std::false_type
+        {};
+
+        template <typename T>
+        struct is_gather_node<T, typename T::gather_category>
+            : std::true_type
+        {};
+
+        // Gather nodes which combine their inputs as they arrive.
+        template <typename T, typename = void>
+        struct is_reduce_node : std::false_type
+        {};
+
+        template <typename T>
+        struct is_reduce_node<T, typename T::reduce_category>
+            : std::true_type
+        {};
+
+        // Nodes which may spawn tasks while they run.
+        template <typename T, typename = void>
+        struct is_spawn_node : std::false_type
+        {};
+
+        template <typename T>
+        struct is_spawn_node<T, typename T::spawn_category>
+            : std::true_type
+        {};
+
+        // Nodes whose results finish asynchronously, such as coroutines
+        // and file I/O, and which release their worker while they wait.
+        template <typename T, typename = void>
+        struct is_async_node : std::false_type
+        {};
+
+        template <typename T>
+        struct is_async_node<
+            T, typename std::decay<
+                   typename node_traits<T>::result_type>::type::async_category>
+            : std::true_type
+        {};
+
         template <typename T>
         struct node
             : node_base<typename node_traits<
@@ -97,17 +204,178 @@ namespace callgraph { namespace detail {
 
             void operator()() {
                 base_type::call(fn_);
+                run_inline(is_async_node<type>());
+            }
+
+            // Recompute the result, and report whether it changed. Results
+            // which cannot be compared always count as changed.
+            bool update() {
+                using result_type = typename traits_type::result_type;
+                using comparable = std::integral_constant<
+                    bool,
+                    !std::is_void<result_type>::value &&
+                    !std::is_reference<result_type>::value &&
+                    is_equality_comparable<result_type>::value>;
+                return update(comparable());
             }
 
             void reset() {
                 base_type::reset();
+                reset_tree(is_reduce_node<type>());
             }
 
             bool valid() const {
                 return base_type::valid();
             }
 
+            // Whether this node computes the same function as `other`:
+            // stateless callables always do, and others only if they
+            // compare equal.
+            bool same(const node& other) const {
+                return same(other, std::is_empty<type>());
+            }
+
+            // Read the result of `to` wherever this node reads `from`,
+            // which has the same type.
+            void rebind(const node_value_base& from, node_value_base& to) {
+                base_type::rebind(from, to);
+                rebind_gathered(from, to, is_gather_node<type>());
+            }
+
+            // Add `source` as the next input of a gather node, and return
+            // its index.
+            template <typename U>
+            size_t gather_from(node_base<U>& source) {
+                fn_.add_input(source.result_);
+                return fn_.size() - 1;
+            }
+
+            // Input `leaf` of a reduce node is ready.
+            void arrive(size_t leaf) {
+                fn_.arrive(leaf);
+            }
+
+            void fail(std::exception_ptr error) {
+                base_type::result_.fail(std::move(error));
+            }
+
+            template <typename V>
+            void skip(V& fallback) {
+                using result_type = typename traits_type::result_type;
+                base_type::reset();
+                base_type::result_.set(static_cast<result_type>(fallback));
+            }
+
+            void skip() {
+                base_type::reset();
+                base_type::result_.set();
+            }
+
+            // The parallel protocol, for parallel nodes only.
+            size_t parallel_begin() {
+                base_type::reset();
+                return fn_.begin(base_type::params_.template get<0>());
+            }
+
+            void parallel_run(size_t first, size_t last) {
+                fn_.run(first, last);
+            }
+
+            void parallel_end() {
+                base_type::result_.set(fn_.end());
+            }
+
+            size_t parallel_grain() const {
+                return fn_.grain();
+            }
+
+            // The context of a spawning node.
+            callgraph::spawn_context* spawn_context() {
+                return &fn_.context();
+            }
+
+            // The asynchronous protocol, for asynchronous nodes only. The
+            // result reports to `target` as it suspends and finishes.
+            void async_start(const async_target& target) {
+                base_type::reset();
+                base_type::call(fn_);
+                base_type::result_.get().start(target);
+            }
+
+            void async_resume() {
+                base_type::result_.get().resume();
+            }
+
+            std::exception_ptr async_error() const {
+                return base_type::result_.get().error();
+            }
+
+            // The case chosen by a branch node's result.
+            size_t selected() const {
+                return static_cast<size_t>(base_type::result_.get());
+            }
+
         private:
+            bool same(const node&, std::true_type) const {
+                return true;
+            }
+
+            bool same(const node& other, std::false_type) const {
+                return equal(other, is_equality_comparable<type>());
+            }
+
+            bool equal(const node& other, std::true_type) const {
+                return static_cast<bool>(fn_ == other.fn_);
+            }
+
+            bool equal(const node&, std::false_type) const {
+                return false;
+            }
+
+            void rebind_gathered(const node_value_base& from, node_value_base& to,
+                                 std::true_type) {
+                fn_.rebind(from, to);
+            }
+
+            void rebind_gathered(const node_value_base&, node_value_base&,
+                                 std::false_type) {
+            }
+
+            void reset_tree(std::true_type) {
+                fn_.reset_tree();
+            }
+
+            void reset_tree(std::false_type) {
+            }
+
+            // Run an asynchronous node to completion on this thread, for
+            // executions which do not suspend.
+            void run_inline(std::true_type) {
+                const auto& task(base_type::result_.get());
+                task.run_inline();
+                if (task.error()) {
+                    std::rethrow_exception(task.error());
+                }
+            }
+
+            void run_inline(std::false_type) {
+            }
+
+            bool update(std::false_type) {
+                base_type::reset();
+                (*this)();
+                return true;
+            }
+
+            bool update(std::true_type) {
+                if (!base_type::result_.ready()) {
+                    return update(std::false_type());
+                }
+                auto previous(base_type::result_.take());
+                base_type::call(fn_);
+                return !(base_type::result_.get() == previous);
+            }
+
             type fn_;
         };
 
@@ -64,10 +64,7 @@ namespace callgraph {
         template <typename R>
         struct node_call<R()> {
             template <typename T, typename U, typename V>
-            static void apply(T& t, U& future, V& result) {
-                if (future) {
-                    future->wait();
-                }
+            static void apply(T& t, U&, V& result) {
                 result.set(t());
             }
         };
@@ -75,10 +72,7 @@ namespace callgraph {
         template <>
         struct node_call<void()> {
             template <typename T, typename U, typename V>
-            static void apply(T& t, U& future, V& result) {
-                if (future) {
-                    future->wait();
-                }
+            static void apply(T& t, U&, V& result) {
                 t();
                 result.set();
             }
@@ -0,0 +1,102 @@
+// callgraph/detail/node_memo.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_DETAIL_NODE_MEMO_HPP
+#define CALLGRAPH_DETAIL_NODE_MEMO_HPP
+
+#include <callgraph/memo_statistics.hpp>
+#include <callgraph/detail/memo_cache.hpp>
+#include <callgraph/detail/node_call.hpp>
+#include <callgraph/detail/node_param_list.hpp>
+#include <callgraph/detail/node_value.hpp>
+
+#include <tuple>
+#include <type_traits>
+
+#ifndef NO_DOC
+namespace callgraph {
+    namespace detail {
+
+        // The memoization policy of a node, which is only instantiated
+        // for nodes which opt in, since it requires hashable inputs.
+        template <typename R, typename... Params>
+        struct node_memo {
+            virtual ~node_memo() = default;
+
+            // Set `result` from the cache, if the current inputs have a
+            // cached result. Otherwise remember the inputs for store.
+            virtual bool lookup(const node_param_list<Params...>& params,
+                                node_value<R>& result) = 0;
+
+            // Cache `result` against the inputs remembered by lookup.
+            virtual void store(const node_value<R>& result) = 0;
+
+            virtual memo_statistics statistics() const = 0;
+        };
+
+        template <typename R, typename... Params>
+        struct node_memo_cache : node_memo<R, Params...> {
+            using key_type = std::tuple<typename std::decay<Params>::type...>;
+            using value_type = typename std::decay<R>::type;
+
+            explicit node_memo_cache(size_t capacity)
+                : cache_(capacity),
+                  has_key_(false)
+                {
+                }
+
+            ~node_memo_cache() {
+                forget();
+            }
+
+            bool lookup(const node_param_list<Params...>& params,
+                        node_value<R>& result) override {
+                using sequence_type =
+                    typename generate_node_call_sequence<sizeof...(Params)>::type;
+                forget();
+                key_.construct(make_key(params, sequence_type()));
+                has_key_ = true;
+
+                bool hit(cache_.find(key_.get(), [&result](const value_type& value) {
+                            result.set(value_type(value));
+                        }));
+                if (hit) {
+                    forget();
+                }
+                return hit;
+            }
+
+            void store(const node_value<R>& result) override {
+                if (has_key_ && result.ready()) {
+                    cache_.insert(std::move(key_.get()), result.get());
+                }
+                forget();
+            }
+
+            memo_statistics statistics() const override {
+                return cache_.statistics();
+            }
+
+        private:
+            template <size_t... N>
+            static key_type make_key(const node_param_list<Params...>& params,
+                                     node_call_sequence<N...>) {
+                return key_type(get_node_params<N>(params)...);
+            }
+
+            void forget() {
+                if (has_key_) {
+                    key_.destroy();
+                    has_key_ = false;
+                }
+            }
+
+            memo_cache<key_type, value_type> cache_;
+            node_value_slot<key_type> key_;
+            bool has_key_;
+        };
+
+    }
+}
+#endif // NO_DOC
+#endif // CALLGRAPH_DETAIL_NODE_MEMO_HPP
@@ -6,8 +6,9 @@
 
 #include <callgraph/detail/node_value.hpp>
 
-#include <tuple>
 #include <memory>
+#include <tuple>
+#include <type_traits>
 
 #ifndef NO_DOC
 namespace callgraph {
@@ -76,7 +77,43 @@ namespace callgraph {
                 return node_param_list_valid(params_);
             }
 
+            node_stream_port* port(size_t n) const {
+                return port(n, std::integral_constant<size_t, 0>());
+            }
+
+            // Read `to` wherever a parameter reads `from`.
+            void rebind(const node_value_base& from, node_value_base& to) {
+                rebind(from, to, std::integral_constant<size_t, 0>());
+            }
+
             std::tuple<std::shared_ptr<node_value_ref_base<Params>>...> params_;
+
+        private:
+            template <size_t N>
+            node_stream_port* port(size_t n, std::integral_constant<size_t, N>) const {
+                using std::get;
+                return n == N ? get<N>(params_).get() :
+                    port(n, std::integral_constant<size_t, N + 1>());
+            }
+
+            node_stream_port* port(size_t,
+                                   std::integral_constant<size_t, sizeof...(Params)>) const {
+                return nullptr;
+            }
+
+            template <size_t N>
+            void rebind(const node_value_base& from, node_value_base& to,
+                        std::integral_constant<size_t, N>) {
+                using std::get;
+                if (get<N>(params_)) {
+                    get<N>(params_)->rebind(from, to);
+                }
+                rebind(from, to, std::integral_constant<size_t, N + 1>());
+            }
+
+            void rebind(const node_value_base&, node_value_base&,
+                        std::integral_constant<size_t, sizeof...(Params)>) {
+            }
         };
 
         template <size_t N, typename... Params>
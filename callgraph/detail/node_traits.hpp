@@ -4,6 +4,12 @@
 #ifndef CALLGRAPH_DETAIL_NODE_TRAITS_HPP
 #define CALLGRAPH_DETAIL_NODE_TRAITS_HPP
 
+#include <type_traits>
+
+#if __cplusplus >= 201703L
+#include <optional>
+#endif
+
 #ifndef NO_DOC
 
 namespace callgraph {
@@ -33,6 +39,17 @@ namespace callgraph {
         template <typename R, typename C, typename... Args>
         struct node_traits<R (C::*)(Args...) const> : node_traits_base<R, Args...>
         {};
+
+        // Results which have a natural empty value to fall back on.
+        template <typename T>
+        struct has_empty_result : std::is_void<T>
+        {};
+
+#if __cplusplus >= 201703L
+        template <typename T>
+        struct has_empty_result<std::optional<T>> : std::true_type
+        {};
+#endif
     }
 }
 #endif // NO_DOC
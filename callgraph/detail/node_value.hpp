@@ -4,55 +4,216 @@
 #ifndef CALLGRAPH_DETAIL_NODE_VALUE_HPP
 #define CALLGRAPH_DETAIL_NODE_VALUE_HPP
 
-#include <future>
+#include <callgraph/detail/stream_buffer.hpp>
+
+#include <exception>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
 #include <utility>
 
+namespace callgraph {
+
+/// \brief An error thrown when the result of a node is read before the
+/// node has produced it, or after it has been released.
+    class result_not_ready : public std::runtime_error {
+    public:
+        result_not_ready()
+            : runtime_error("The node has not produced a result.")
+            {
+            }
+    };
+}
+
 #ifndef NO_DOC
 namespace callgraph {
     namespace detail {
 
+        // Storage for a node result which is reused across executions
+        // without touching the heap.
+        template <typename T>
+        struct node_value_slot {
+            node_value_slot() = default;
+            node_value_slot(const node_value_slot&) = delete;
+            node_value_slot& operator=(const node_value_slot&) = delete;
+
+            void construct(T&& t) {
+                new (&storage_) T(std::forward<T>(t));
+            }
+
+            void destroy() {
+                get().~T();
+            }
+
+            T& get() {
+                return *reinterpret_cast<T*>(&storage_);
+            }
+
+            const T& get() const {
+                return *reinterpret_cast<const T*>(&storage_);
+            }
+
+        private:
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_;
+        };
+
         template <typename T>
+        struct node_value_slot<T&> {
+            void construct(T& t) {
+                ptr_ = &t;
+            }
+
+            void destroy() {
+            }
+
+            T& get() const {
+                return *ptr_;
+            }
+
+        private:
+            T* ptr_;
+        };
+
+        // A node result holds either nothing, a value, or the exception
+        // which prevented the value from being produced. Results are only
+        // read once the runner has seen the producing node finish, so no
+        // synchronisation is needed here.
         struct node_value_base {
             node_value_base()
-                : future_(promise_.get_future().share())
+                : ready_(false)
                 {
                 }
 
-            void wait() {
-                future_.wait();
+            bool ready() const {
+                return ready_;
             }
 
-            void reset() {
-                promise_ = std::move(std::promise<T>());
-                future_ = promise_.get_future().share();
+            const std::exception_ptr& error() const {
+                return error_;
+            }
+
+            void fail(std::exception_ptr error) {
+                error_ = std::move(error);
+            }
+
+        protected:
+            void throw_if_failed() const {
+                if (error_) {
+                    std::rethrow_exception(error_);
+                }
+            }
+
+            void publish() {
+                ready_ = true;
             }
 
-            std::promise<T> promise_;
-            std::shared_future<T> future_;
+            bool unpublish() {
+                bool ready(ready_);
+                ready_ = false;
+                error_ = nullptr;
+                return ready;
+            }
+
+        private:
+            bool ready_;
+            std::exception_ptr error_;
         };
 
         template <typename T>
-        struct node_value : node_value_base<T> {
+        struct node_value : node_value_base {
+            ~node_value() {
+                reset();
+            }
+
             const T& get() const {
-                return node_value_base<T>::future_.get();
+                throw_if_failed();
+                if (!ready()) {
+                    throw result_not_ready();
+                }
+                return slot_.get();
             }
 
             void set(T&& t) {
-                node_value_base<T>::promise_.set_value(std::forward<T>(t));
+                slot_.construct(std::forward<T>(t));
+                publish();
+            }
+
+            // Move the value out, leaving the result empty.
+            T take() {
+                T t(std::move(slot_.get()));
+                reset();
+                return t;
+            }
+
+            void reset() {
+                if (unpublish()) {
+                    slot_.destroy();
+                }
             }
+
+        private:
+            node_value_slot<T> slot_;
         };
 
         template <>
-        struct node_value<void> : node_value_base<void> {
+        struct node_value<void> : node_value_base {
             void set() {
-                node_value_base<void>::promise_.set_value();
+                publish();
+            }
+
+            void reset() {
+                unpublish();
             }
         };
 
         template <typename T>
-        struct node_value_ref_base {
+        struct node_value_ref_base : node_stream_port {
             using type = T;
-            virtual type get() const = 0;
+            using value_type = typename std::decay<T>::type;
+
+            type get() const {
+                if (stream_) {
+                    return static_cast<type>(stream_->front());
+                }
+                return read();
+            }
+
+            void open_stream(size_t capacity) override {
+                stream_.reset(capacity > 0 ?
+                              new stream_buffer<value_type>(capacity) : nullptr);
+            }
+
+            void stream_push() override {
+                push(std::is_constructible<value_type, type>());
+            }
+
+            void stream_pop() override {
+                stream_->pop();
+            }
+
+            void stream_clear() override {
+                if (stream_) {
+                    stream_->clear();
+                }
+            }
+
+            // Read `to` instead of `from`, which has the same type.
+            virtual void rebind(const node_value_base& from, node_value_base& to) = 0;
+
+        protected:
+            virtual type read() const = 0;
+
+        private:
+            void push(std::true_type) {
+                stream_->push(value_type(read()));
+            }
+
+            void push(std::false_type) {
+                throw std::runtime_error("Parameter cannot be copied into a stream.");
+            }
+
+            std::unique_ptr<stream_buffer<value_type>> stream_;
         };
 
         template <typename T, typename U, size_t N>
@@ -62,20 +223,22 @@ namespace callgraph {
             using type = T;
 
             node_value_index_ref(node_value<U>& ref)
-                : ref_(ref)
+                : ref_(&ref)
                 {
                 }
 
-            type get() const override {
+            type read() const override {
                 using std::get;
-                return static_cast<type>(get<N>(ref_.get()));
+                return static_cast<type>(get<N>(ref_->get()));
             }
 
-            void wait() {
-                ref_.wait();
+            void rebind(const node_value_base& from, node_value_base& to) override {
+                if (ref_ == &from) {
+                    ref_ = static_cast<node_value<U>*>(&to);
+                }
             }
 
-            node_value<U>& ref_;
+            node_value<U>* ref_;
         };
 
         template <typename T, typename U>
@@ -84,19 +247,21 @@ namespace callgraph {
             using type = T;
 
             node_value_ref(node_value<U>& ref)
-                : ref_(ref)
+                : ref_(&ref)
             {
             }
 
-            type get() const override {
-                return static_cast<type>(ref_.get());
+            type read() const override {
+                return static_cast<type>(ref_->get());
             }
 
-            void wait() {
-                ref_.wait();
+            void rebind(const node_value_base& from, node_value_base& to) override {
+                if (ref_ == &from) {
+                    ref_ = static_cast<node_value<U>*>(&to);
+                }
             }
 
-            node_value<U>& ref_;
+            node_value<U>* ref_;
         };
 
     }
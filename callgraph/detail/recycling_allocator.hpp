@@ -0,0 +1,120 @@
+// callgraph/detail/recycling_allocator.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_DETAIL_RECYCLING_ALLOCATOR_HPP
+#define CALLGRAPH_DETAIL_RECYCLING_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#ifndef NO_DOC
+namespace callgraph {
+    namespace detail {
+
+        // A pool of fixed-size blocks which are returned to a free
+        // list instead of the heap. Requests larger than a block, or
+        // made while the free list is empty, fall through to the heap.
+        struct recycling_pool {
+            enum : size_t {
+                block_size = 256,
+                max_blocks = 16
+            };
+
+            recycling_pool() {
+                free_.reserve(max_blocks);
+            }
+
+            ~recycling_pool() {
+                for (void* block : free_) {
+                    ::operator delete(block);
+                }
+            }
+
+            recycling_pool(const recycling_pool&) = delete;
+            recycling_pool& operator=(const recycling_pool&) = delete;
+
+            void reserve(size_t blocks) {
+                std::unique_lock<std::mutex> lk(mutex_);
+                while (free_.size() < blocks && free_.size() < max_blocks) {
+                    free_.push_back(::operator new(block_size));
+                }
+            }
+
+            void* allocate(size_t n) {
+                if (n > block_size) {
+                    return ::operator new(n);
+                }
+                {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    if (!free_.empty()) {
+                        void* block(free_.back());
+                        free_.pop_back();
+                        return block;
+                    }
+                }
+                return ::operator new(block_size);
+            }
+
+            void deallocate(void* p, size_t n) {
+                if (n <= block_size) {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    if (free_.size() < max_blocks) {
+                        free_.push_back(p);
+                        return;
+                    }
+                }
+                ::operator delete(p);
+            }
+
+        private:
+            std::mutex mutex_;
+            std::vector<void*> free_;
+        };
+
+        template <typename T>
+        struct recycling_allocator {
+            using value_type = T;
+
+            template <typename U>
+            friend struct recycling_allocator;
+
+            explicit recycling_allocator(std::shared_ptr<recycling_pool> pool)
+                : pool_(std::move(pool))
+                {
+                }
+
+            template <typename U>
+            recycling_allocator(const recycling_allocator<U>& src)
+                : pool_(src.pool_)
+                {
+                }
+
+            T* allocate(size_t n) {
+                return static_cast<T*>(pool_->allocate(n * sizeof(T)));
+            }
+
+            void deallocate(T* p, size_t n) {
+                pool_->deallocate(p, n * sizeof(T));
+            }
+
+            template <typename U>
+            bool operator==(const recycling_allocator<U>& other) const {
+                return pool_ == other.pool_;
+            }
+
+            template <typename U>
+            bool operator!=(const recycling_allocator<U>& other) const {
+                return pool_ != other.pool_;
+            }
+
+        private:
+            std::shared_ptr<recycling_pool> pool_;
+        };
+
+    }
+}
+#endif // NO_DOC
+#endif // CALLGRAPH_DETAIL_RECYCLING_ALLOCATOR_HPP
@@ -0,0 +1,94 @@
+// callgraph/detail/ring_queue.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_DETAIL_RING_QUEUE_HPP
+#define CALLGRAPH_DETAIL_RING_QUEUE_HPP
+
+#include <vector>
+
+#ifndef NO_DOC
+namespace callgraph {
+    namespace detail {
+
+        // A FIFO queue over a circular buffer. Storage only ever grows,
+        // so a queue which has reached its working size never allocates
+        // again. Not thread safe.
+        template <typename T>
+        struct ring_queue {
+            ring_queue()
+                : head_(0),
+                  size_(0)
+                {
+                }
+
+            void reserve(size_t n) {
+                if (n > buffer_.size()) {
+                    grow(n);
+                }
+            }
+
+            bool empty() const {
+                return size_ == 0;
+            }
+
+            size_t size() const {
+                return size_;
+            }
+
+            void push(const T& t) {
+                if (size_ == buffer_.size()) {
+                    grow(buffer_.empty() ? 16 : buffer_.size() * 2);
+                }
+                buffer_[(head_ + size_) % buffer_.size()] = t;
+                size_++;
+            }
+
+            const T& front() const {
+                return buffer_[head_];
+            }
+
+            void pop() {
+                head_ = (head_ + 1) % buffer_.size();
+                size_--;
+            }
+
+            // Remove the elements matching `pred`, keeping the order of
+            // the rest, and return how many were removed.
+            template <typename P>
+            size_t remove_if(P pred) {
+                size_t kept(0);
+                for (size_t i = 0; i < size_; i++) {
+                    const T& t(buffer_[(head_ + i) % buffer_.size()]);
+                    if (!pred(t)) {
+                        buffer_[(head_ + kept++) % buffer_.size()] = t;
+                    }
+                }
+                size_t removed(size_ - kept);
+                size_ = kept;
+                return removed;
+            }
+
+            void clear() {
+                head_ = 0;
+                size_ = 0;
+            }
+
+        private:
+            void grow(size_t n) {
+                std::vector<T> next(n);
+                for (size_t i = 0; i < size_; i++) {
+                    next[i] = buffer_[(head_ + i) % buffer_.size()];
+                }
+                buffer_.swap(next);
+                head_ = 0;
+            }
+
+            std::vector<T> buffer_;
+            size_t head_;
+            size_t size_;
+        };
+
+    }
+}
+#endif // NO_DOC
+#endif // CALLGRAPH_DETAIL_RING_QUEUE_HPP
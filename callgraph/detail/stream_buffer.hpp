@@ -0,0 +1,93 @@
+// callgraph/detail/stream_buffer.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_DETAIL_STREAM_BUFFER_HPP
+#define CALLGRAPH_DETAIL_STREAM_BUFFER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#ifndef NO_DOC
+namespace callgraph {
+    namespace detail {
+
+        // A bounded ring of items passed along one edge of a streaming
+        // graph. There is one producer and one consumer, and the
+        // stream_runner orders their accesses through its own counters,
+        // so the ring itself needs no synchronisation. The producer must
+        // not push into a full ring, nor the consumer pop an empty one.
+        template <typename T>
+        class stream_buffer {
+        public:
+            explicit stream_buffer(size_t capacity)
+                : slots_(new storage_type[capacity]),
+                  capacity_(capacity),
+                  head_(0),
+                  tail_(0)
+                {
+                }
+
+            ~stream_buffer() {
+                clear();
+            }
+
+            stream_buffer(const stream_buffer&) = delete;
+            stream_buffer& operator=(const stream_buffer&) = delete;
+
+            void push(T&& t) {
+                new (&slots_[tail_ % capacity_]) T(std::move(t));
+                tail_++;
+            }
+
+            T& front() const {
+                return *reinterpret_cast<T*>(&slots_[head_ % capacity_]);
+            }
+
+            void pop() {
+                front().~T();
+                head_++;
+            }
+
+            // Destroy every item, once neither end is in use.
+            void clear() {
+                while (head_ != tail_) {
+                    pop();
+                }
+            }
+
+        private:
+            using storage_type =
+                typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+            std::unique_ptr<storage_type[]> slots_;
+            size_t capacity_;
+            std::uint64_t head_;
+            std::uint64_t tail_;
+        };
+
+        // The streaming end of a node parameter. While a stream is open,
+        // the parameter reads the item at the front of its buffer rather
+        // than the result of the node it is bound to.
+        struct node_stream_port {
+            virtual ~node_stream_port() = default;
+
+            // Open a stream of `capacity` items, or close it if zero.
+            virtual void open_stream(size_t capacity) = 0;
+
+            // Copy the bound node's result into the buffer.
+            virtual void stream_push() = 0;
+
+            // Discard the item at the front of the buffer.
+            virtual void stream_pop() = 0;
+
+            virtual void stream_clear() = 0;
+        };
+
+    }
+}
+#endif // NO_DOC
+#endif // CALLGRAPH_DETAIL_STREAM_BUFFER_HPP
@@ -0,0 +1,173 @@
+// callgraph/event_source.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_EVENT_SOURCE_HPP
+#define CALLGRAPH_EVENT_SOURCE_HPP
+
+#include <callgraph/detail/async_target.hpp>
+#include <callgraph/detail/event_reactor.hpp>
+
+#include <poll.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <exception>
+#include <system_error>
+
+namespace callgraph {
+
+/// \brief A file descriptor which has become ready, delivered by an
+/// event_source node to its children.
+    struct fd_event {
+        /// \brief The descriptor which became ready.
+        int fd;
+
+        /// \brief The events which fired, as `poll` flags.
+        std::uint32_t events;
+    };
+
+/// \brief The result of an event_source node, which completes once its
+/// descriptor is ready.
+///
+/// Children take the event as a parameter of type `fd_event`.
+    class fd_ready {
+    public:
+        /// \brief Get the event, or throw the `std::system_error` which
+        /// ended the wait.
+        const fd_event& get() const {
+            if (error_) {
+                std::rethrow_exception(error_);
+            }
+            return event_;
+        }
+
+        /// \brief Get the event.
+        /// \see get
+        operator const fd_event&() const {
+            return get();
+        }
+
+#ifndef NO_DOC
+        using async_category = void;
+
+        fd_ready(int fd, std::uint32_t events)
+            : event_{fd, 0}
+            {
+                request_.fd = fd;
+                request_.events = events;
+                request_.complete = &fd_ready::complete;
+                request_.context = nullptr;
+                request_.error = 0;
+                request_.id = 0;
+                request_.next = nullptr;
+            }
+
+        fd_ready(const fd_ready& other)
+            : fd_ready(other.request_.fd, other.request_.events)
+            {
+            }
+
+        fd_ready& operator=(const fd_ready&) = delete;
+
+        void start(const detail::async_target& target) const {
+            target_ = target;
+            if (!target_.events) {
+                run_inline();
+                return;
+            }
+            request_.context = const_cast<fd_ready*>(this);
+            target_.events(target_.runner)->watch(&request_);
+        }
+
+        void resume() const {
+        }
+
+        // Block in poll until the descriptor is ready.
+        void run_inline() const {
+            pollfd p;
+            p.fd = request_.fd;
+            p.events = static_cast<short>(request_.events);
+            p.revents = 0;
+            int n;
+            do {
+                n = ::poll(&p, 1, -1);
+            } while (n < 0 && errno == EINTR);
+            if (n < 0) {
+                fail(errno);
+                return;
+            }
+            event_.events = static_cast<unsigned short>(p.revents);
+        }
+
+        const std::exception_ptr& error() const {
+            return error_;
+        }
+#endif // NO_DOC
+
+    private:
+        void fail(int error) const {
+            error_ = std::make_exception_ptr(
+                std::system_error(error, std::generic_category(),
+                                  "Cannot wait for file descriptor"));
+        }
+
+        static void complete(detail::event_request* request, std::uint32_t events) {
+            const fd_ready& self(*static_cast<const fd_ready*>(request->context));
+            if (request->error) {
+                self.fail(request->error);
+            }
+            self.event_.events = events;
+            // The node may be destroyed once the target has been told.
+            detail::async_target target(self.target_);
+            target.finish(target.runner, target.node);
+        }
+
+        // Nodes drive the wait through their published result.
+        mutable fd_event event_;
+        mutable detail::event_request request_;
+        mutable detail::async_target target_ = detail::async_target();
+        mutable std::exception_ptr error_;
+    };
+
+/// \brief A node which completes once a file descriptor is ready, such
+/// as a pipe, local socket, timerfd or eventfd.
+///
+/// Under a graph_runner, the descriptor is watched by an epoll reactor
+/// owned by the runner, and no worker waits on it; the node's children
+/// are released once it fires. Other runners wait in `poll` on the
+/// executing thread. Readiness is level-triggered, so the children
+/// should consume the event, for example by reading from the descriptor,
+/// before the next run. A descriptor may be watched by one node at a
+/// time. If the run stops, because a node failed, the run was cancelled
+/// or its deadline passed, the waits still pending end with a
+/// `std::system_error` for `ECANCELED`, and the run finishes without
+/// them.
+    class event_source {
+    public:
+        /// \brief The events a node can wait for.
+        enum : std::uint32_t {
+            /// \brief Wait for the descriptor to be readable.
+            readable = POLLIN,
+            /// \brief Wait for the descriptor to be writable.
+            writable = POLLOUT
+        };
+
+        /// \brief Construct a node which waits for `events` on `fd`.
+        explicit event_source(int fd, std::uint32_t events = readable)
+            : fd_(fd),
+              events_(events)
+            {
+            }
+
+        /// \brief Start waiting for the descriptor.
+        fd_ready operator()() const {
+            return fd_ready(fd_, events_);
+        }
+
+    private:
+        int fd_;
+        std::uint32_t events_;
+    };
+}
+
+#endif // CALLGRAPH_EVENT_SOURCE_HPP
@@ -0,0 +1,365 @@
+// callgraph/file_io.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_FILE_IO_HPP
+#define CALLGRAPH_FILE_IO_HPP
+
+#include <callgraph/detail/async_target.hpp>
+#include <callgraph/detail/io_reactor.hpp>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+namespace callgraph {
+
+/// \brief Exception type thrown when a file node cannot read or write
+/// its file.
+    class io_error : public std::runtime_error {
+    public:
+        io_error(const std::string& path, int error)
+            : runtime_error(path + ": " + std::generic_category().message(error)),
+              code_(error)
+            {
+            }
+
+        /// \brief The `errno` value describing the failure.
+        int code() const {
+            return code_;
+        }
+
+    private:
+        int code_;
+    };
+
+#ifndef NO_DOC
+    namespace detail {
+        // Reads a whole file into a string, or writes a string to a file,
+        // through the runner's I/O reactor.
+        class file_transfer {
+        public:
+            file_transfer(io_request::kind_type kind, std::string path,
+                          const std::string* source)
+                : path_(std::move(path)),
+                  source_(source),
+                  fd_(-1),
+                  expected_(0),
+                  sized_(false),
+                  io_(nullptr)
+                {
+                    request_.kind = kind;
+                    request_.offset = 0;
+                    request_.perform = &file_transfer::perform;
+                    request_.complete = &file_transfer::complete;
+                }
+
+            file_transfer(file_transfer&&) = default;
+            file_transfer& operator=(const file_transfer&) = delete;
+
+            ~file_transfer() {
+                close();
+            }
+
+            // Start the transfer, which reports to `target` when it is
+            // done. Without a reactor, transfer on this thread.
+            void start(const async_target& target) {
+                target_ = target;
+                bool more(open());
+                if (!target_.io) {
+                    while (more) {
+                        more = advance(perform(&request_));
+                    }
+                    close();
+                    return;
+                }
+                if (!more) {
+                    finish();
+                    return;
+                }
+                io_ = target_.io(target_.runner);
+                io_->submit(&request_);
+            }
+
+            void run_inline() {
+                start(async_target());
+            }
+
+            const std::exception_ptr& error() const {
+                return error_;
+            }
+
+            const std::string& data() const {
+                if (error_) {
+                    std::rethrow_exception(error_);
+                }
+                return data_;
+            }
+
+            const size_t& transferred() const {
+                if (error_) {
+                    std::rethrow_exception(error_);
+                }
+                return transferred_;
+            }
+
+        private:
+            // Open the file and prepare the first transfer, reporting
+            // whether there is anything to transfer.
+            bool open() {
+                if (request_.kind == io_request::read) {
+                    fd_ = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+                }
+                else {
+                    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                                 0666);
+                }
+                if (fd_ < 0) {
+                    error_ = std::make_exception_ptr(io_error(path_, errno));
+                    return false;
+                }
+                if (request_.kind == io_request::write) {
+                    expected_ = source_->size();
+                    sized_ = true;
+                }
+                else {
+                    // Regular files are read in one request where possible;
+                    // anything else is read in chunks until it ends.
+                    const size_t chunk(64 * 1024);
+                    struct stat st;
+                    sized_ = ::fstat(fd_, &st) == 0 && S_ISREG(st.st_mode) &&
+                        st.st_size > 0;
+                    expected_ = sized_ ? static_cast<size_t>(st.st_size) : chunk;
+                    data_.resize(expected_);
+                }
+                return prepare();
+            }
+
+            // Point the request at what is left to transfer, reporting
+            // whether there is any.
+            bool prepare() {
+                size_t done(static_cast<size_t>(request_.offset));
+                if (request_.kind == io_request::write) {
+                    request_.buffer = const_cast<char*>(source_->data()) + done;
+                }
+                else {
+                    if (!sized_ && done == data_.size()) {
+                        data_.resize(data_.size() * 2);
+                        expected_ = data_.size();
+                    }
+                    request_.buffer = &data_[0] + done;
+                }
+                request_.fd = fd_;
+                request_.length = expected_ - done;
+                request_.context = this;
+                return request_.length > 0;
+            }
+
+            // Account for a finished request, and report whether another
+            // is needed.
+            bool advance(long result) {
+                if (result == -EINTR || result == -EAGAIN) {
+                    return true;
+                }
+                if (result < 0) {
+                    error_ = std::make_exception_ptr(
+                        io_error(path_, static_cast<int>(-result)));
+                    return false;
+                }
+                if (result == 0) {
+                    if (request_.kind == io_request::write) {
+                        error_ = std::make_exception_ptr(io_error(path_, EIO));
+                        return false;
+                    }
+                    // The file ended early.
+                    data_.resize(static_cast<size_t>(request_.offset));
+                    transferred_ = data_.size();
+                    return false;
+                }
+                request_.offset += static_cast<std::uint64_t>(result);
+                transferred_ = static_cast<size_t>(request_.offset);
+                if (request_.kind == io_request::read && sized_ &&
+                    transferred_ == expected_) {
+                    return false;
+                }
+                return prepare();
+            }
+
+            // Called once the last transfer is done. The node may be
+            // destroyed once the target has been told.
+            void finish() {
+                close();
+                async_target target(target_);
+                target.finish(target.runner, target.node);
+            }
+
+            void close() {
+                if (fd_ >= 0) {
+                    ::close(fd_);
+                    fd_ = -1;
+                }
+            }
+
+            static long perform(io_request* request) {
+                ssize_t n(request->kind == io_request::read ?
+                          ::pread(request->fd, request->buffer, request->length,
+                                  static_cast<off_t>(request->offset)) :
+                          ::pwrite(request->fd, request->buffer, request->length,
+                                   static_cast<off_t>(request->offset)));
+                return n < 0 ? -static_cast<long>(errno) : static_cast<long>(n);
+            }
+
+            static void complete(io_request* request, long result) {
+                file_transfer& self(*static_cast<file_transfer*>(request->context));
+                if (self.advance(result)) {
+                    self.io_->submit(request);
+                }
+                else {
+                    self.finish();
+                }
+            }
+
+            std::string path_;
+            const std::string* source_;
+            std::string data_;
+            size_t transferred_ = 0;
+            int fd_;
+            size_t expected_;
+            bool sized_;
+            io_request request_;
+            async_target target_ = async_target();
+            io_reactor* io_;
+            std::exception_ptr error_;
+        };
+    }
+#endif // NO_DOC
+
+/// \brief The contents of a file, read by a read_file node.
+///
+/// Consumers take the contents as a parameter of type `std::string`.
+    class file_contents {
+    public:
+        /// \brief Get the contents, or throw the io_error which prevented
+        /// them from being read.
+        const std::string& get() const {
+            return transfer_.data();
+        }
+
+        /// \brief Get the contents.
+        /// \see get
+        operator const std::string&() const {
+            return get();
+        }
+
+#ifndef NO_DOC
+        using async_category = void;
+
+        explicit file_contents(std::string path)
+            : transfer_(detail::io_request::read, std::move(path), nullptr)
+            {
+            }
+
+        void start(const detail::async_target& target) const {
+            transfer_.start(target);
+        }
+
+        void resume() const {
+        }
+
+        void run_inline() const {
+            transfer_.run_inline();
+        }
+
+        const std::exception_ptr& error() const {
+            return transfer_.error();
+        }
+#endif // NO_DOC
+
+    private:
+        // Nodes drive the transfer through their published result.
+        mutable detail::file_transfer transfer_;
+    };
+
+/// \brief The number of bytes written by a write_file node.
+///
+/// Consumers take the count as a parameter of type `size_t`.
+    class file_written {
+    public:
+        /// \brief Get the number of bytes written, or throw the io_error
+        /// which prevented the file from being written.
+        const size_t& get() const {
+            return transfer_.transferred();
+        }
+
+        /// \brief Get the number of bytes written.
+        /// \see get
+        operator const size_t&() const {
+            return get();
+        }
+
+#ifndef NO_DOC
+        using async_category = void;
+
+        file_written(std::string path, const std::string& data)
+            : transfer_(detail::io_request::write, std::move(path), &data)
+            {
+            }
+
+        void start(const detail::async_target& target) const {
+            transfer_.start(target);
+        }
+
+        void resume() const {
+        }
+
+        void run_inline() const {
+            transfer_.run_inline();
+        }
+
+        const std::exception_ptr& error() const {
+            return transfer_.error();
+        }
+#endif // NO_DOC
+
+    private:
+        // Nodes drive the transfer through their published result.
+        mutable detail::file_transfer transfer_;
+    };
+
+/// \brief A node which reads the whole of the file named by its
+/// parameter.
+///
+/// Under a graph_runner, the read is submitted to the runner's I/O
+/// reactor, which uses io_uring where the kernel supports it and a small
+/// pool of threads otherwise, and the worker goes on to other nodes. The
+/// node's children are released once the read completes. Other runners
+/// read on the executing thread.
+    struct read_file {
+        /// \brief Start reading the file at `path`.
+        file_contents operator()(const std::string& path) const {
+            return file_contents(path);
+        }
+    };
+
+/// \brief A node which writes its second parameter to the file named by
+/// its first, replacing the file.
+///
+/// The data is not copied, and is read until the write completes.
+/// \see read_file
+    struct write_file {
+        /// \brief Start writing `data` to the file at `path`.
+        file_written operator()(const std::string& path,
+                                const std::string& data) const {
+            return file_written(path, data);
+        }
+    };
+}
+
+#endif // CALLGRAPH_FILE_IO_HPP
@@ -0,0 +1,63 @@
+// callgraph/gather.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_GATHER_HPP
+#define CALLGRAPH_GATHER_HPP
+
+#include <callgraph/detail/node_value.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace callgraph {
+
+/// \brief A node which collects the results of any number of nodes into
+/// a `std::vector`, in the order they were connected.
+///
+/// Connect inputs with graph::connect_gather. Every input must return
+/// exactly `T`.
+/// \tparam T The type of each input.
+    template <typename T>
+    class gather {
+    public:
+        /// \brief The type of each input.
+        using value_type = T;
+
+        /// \brief Collect a copy of every input.
+        std::vector<T> operator()() const {
+            std::vector<T> values;
+            values.reserve(inputs_.size());
+            for (const detail::node_value<T>* input : inputs_) {
+                values.push_back(input->get());
+            }
+            return values;
+        }
+
+        /// \brief The number of inputs connected.
+        size_t size() const {
+            return inputs_.size();
+        }
+
+#ifndef NO_DOC
+        using gather_category = void;
+
+        void add_input(const detail::node_value<T>& input) {
+            inputs_.push_back(&input);
+        }
+
+        void rebind(const detail::node_value_base& from,
+                    const detail::node_value_base& to) {
+            for (const detail::node_value<T>*& input : inputs_) {
+                if (input == &from) {
+                    input = static_cast<const detail::node_value<T>*>(&to);
+                }
+            }
+        }
+#endif // NO_DOC
+
+    private:
+        std::vector<const detail::node_value<T>*> inputs_;
+    };
+}
+
+#endif // CALLGRAPH_GATHER_HPP
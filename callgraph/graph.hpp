@@ -4,6 +4,7 @@
 #ifndef CALLGRAPH_GRAPH_HPP
 #define CALLGRAPH_GRAPH_HPP
 
+#include <callgraph/memo_statistics.hpp>
 #include <callgraph/detail/graph_node.hpp>
 #include <callgraph/detail/node.hpp>
 #include <callgraph/detail/node_key.hpp>
@@ -11,13 +12,22 @@
 #include <callgraph/detail/unwrap_vertex.hpp>
 
 #include <algorithm>
+#include <array>
+#include <chrono>
 #include <stdexcept>
+#include <string>
+#include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 /// \brief The main Callgraph namespace.
 namespace callgraph {
     class graph_runner;
+    class graph_exporter;
+    class stream_runner;
+    template <typename S>
+    class subgraph;
 
 /// \brief An error thrown if connecting a node would cause a cycle.
     class cycle_error : public std::runtime_error {
@@ -38,6 +48,24 @@ namespace callgraph {
             }
     };
 
+/// \brief An error thrown if a node named in a request is not found.
+    class node_not_found : public std::runtime_error {
+    public:
+        node_not_found()
+            : runtime_error("Node not found in graph.")
+            {
+            }
+    };
+
+/// \brief An error thrown if the edge named in a request is not found.
+    class edge_not_found : public std::runtime_error {
+    public:
+        edge_not_found()
+            : runtime_error("Edge not found in graph.")
+            {
+            }
+    };
+
 /// \brief A graph is a container of asynchronous executable nodes
 /// joined into a directed acyclic graph.
 ///
@@ -49,9 +77,12 @@ namespace callgraph {
 
         /// \brief Construct an empty graph, consisting only of a no-op root node.
         graph()
-            : root_(&graph::dummy),
+            : next_id_(0),
+              revision_(0),
+              root_(&graph::dummy),
               root_node_(&ensure_node(root_)->second)
             {
+                root_node_->name_ = "root";
             }
 
         graph(const graph&) = delete;
@@ -73,9 +104,10 @@ namespace callgraph {
             return connect(std::forward<void(*)()>(root_), std::forward<T>(t));
         }
 
-        /// \brief Connect functions `f` and `g`.
-        /// \tparam F A Callable type which returns void, or a
-        /// node wrapper which wraps such a type.
+        /// \brief Connect functions `f` and `g`, so that `g` is invoked
+        /// after `f` without reading its result.
+        /// \tparam F A Callable type, or a node wrapper which wraps such
+        /// a type.
         /// \tparam G A Callable type which takes no parameters, or a
         /// node wrapper which wraps such a type.
         /// \throws cycle_error if connecting `f` to `g` forms a cycle.
@@ -98,6 +130,8 @@ namespace callgraph {
             auto gnode = ensure_node(std::forward<G>(g));
             to_node<g_type>(gnode)->template connect(*to_node<f_type>(fnode));
             fnode->second.add_child(&gnode->second);
+            revision_++;
+            gnode->second.add_input(&fnode->second, -1, -1);
             return vertex<g_type>(detail::unwrap_vertex<G>::apply(g), *this);
         }
 
@@ -129,6 +163,8 @@ namespace callgraph {
             auto gnode = ensure_node(std::forward<G>(g));
             to_node<g_type>(gnode)->template connect<To>(*to_node<f_type>(fnode));
             fnode->second.add_child(&gnode->second);
+            revision_++;
+            gnode->second.add_input(&fnode->second, -1, static_cast<int>(To));
             return vertex<g_type>(detail::unwrap_vertex<G>::apply(g), *this);
         }
 
@@ -164,9 +200,296 @@ namespace callgraph {
             auto gnode = ensure_node(std::forward<G>(g));
             to_node<g_type>(gnode)->template connect<From, To>(*to_node<f_type>(fnode));
             fnode->second.add_child(&gnode->second);
+            revision_++;
+            gnode->second.add_input(&fnode->second,
+                                    static_cast<int>(From), static_cast<int>(To));
+            return vertex<g_type>(detail::unwrap_vertex<G>::apply(g), *this);
+        }
+
+        /// \brief Add the result of `f` as the next input of the gather or
+        /// reduce node `g`.
+        /// \tparam F A Callable type which returns exactly the input type
+        /// of `g`, or a node wrapper which wraps such a type.
+        /// \tparam G A gather or reduce type, or a node wrapper which
+        /// wraps such a type.
+        /// \throws cycle_error if connecting `f` to `g` forms a cycle.
+        /// \throws source_node_not_found if `f` is not already connected
+        /// to the graph.
+        /// \return A node wrapper which can be used as a handle to the
+        /// node represented by `g`.
+        /// \see gather
+        /// \see reduce
+        template <typename F, typename G>
+        auto connect_gather(F&& f, G&& g) -> decltype(auto) {
+            using f_type = typename detail::unwrap_vertex<F>::type;
+            using g_type = typename detail::unwrap_vertex<G>::type;
+            using input_type = typename std::decay<
+                typename node_type<f_type>::traits_type::result_type>::type;
+            static_assert(detail::is_gather_node<
+                          typename node_type<g_type>::type>::value,
+                          "Only gather and reduce nodes can gather inputs.");
+            static_assert(std::is_same<
+                          input_type,
+                          typename node_type<g_type>::type::value_type>::value,
+                          "Gathered inputs must have the gather node's type.");
+
+            auto fnode = get_node(std::forward<F>(f));
+            if (fnode == nodes_.end()) {
+                throw source_node_not_found();
+            }
+            throw_if_cycle(fnode->second, std::forward<G>(g));
+
+            auto gnode = ensure_node(std::forward<G>(g));
+            to_node<g_type>(gnode)->connect(*to_node<f_type>(fnode));
+            size_t index(to_node<g_type>(gnode)->gather_from(*to_node<f_type>(fnode)));
+            fnode->second.add_child(&gnode->second);
+            revision_++;
+            gnode->second.add_input(&fnode->second, -1, static_cast<int>(index));
             return vertex<g_type>(detail::unwrap_vertex<G>::apply(g), *this);
         }
 
+        /// \brief Move every node of `sub` into this graph, leaving `sub`
+        /// empty.
+        ///
+        /// The nodes keep their connections to each other, and are run
+        /// by this graph's runners exactly as if they had been connected
+        /// here; nodes which were connected to the root of `sub` start
+        /// with this graph's root. A node keeps its handle unless this
+        /// graph already has a node with the same handle, as when the
+        /// same fragment is built twice from local functions. Such nodes
+        /// can no longer be named; connect to a fragment through the
+        /// inputs and output of a subgraph instead.
+        /// \throws cycle_error if `sub` is this graph.
+        /// \see subgraph
+        void insert(graph& sub) {
+            if (&sub == this) {
+                throw cycle_error();
+            }
+            std::unordered_map<const graph_node_type*, graph_node_type*> moved;
+            moved.reserve(sub.nodes_.size());
+            for (auto& pair : sub.nodes_) {
+                fn_key key(pair.first);
+                if (&pair.second == sub.root_node_ ||
+                    nodes_.find(key) != nodes_.end()) {
+                    // Rekey by the node itself, which no callable shares.
+                    key = pair.second.node_.get();
+                }
+                auto added = nodes_.emplace(key, std::move(pair.second)).first;
+                added->second.id_ = next_id_++;
+                moved.emplace(&pair.second, &added->second);
+            }
+            for (auto& pair : moved) {
+                relink(*pair.second, moved);
+            }
+
+            // The root of `sub` becomes its entry, run first by this root.
+            graph_node_type* entry(moved[sub.root_node_]);
+            entry->name_ = "subgraph";
+            entry->to_node<void(*)()>()->connect(*root_node_->to_node<void(*)()>());
+            root_node_->add_child(entry);
+            entry->add_input(root_node_, -1, -1);
+            revision_++;
+
+            sub.nodes_.clear();
+            sub.next_id_ = 0;
+            sub.revision_++;
+            sub.root_node_ = &sub.ensure_node(sub.root_)->second;
+            sub.root_node_->name_ = "root";
+        }
+
+        /// \brief Give a node a human-readable name, used when the
+        /// graph is exported.
+        /// \tparam T A Callable type, or a node wrapper which wraps
+        /// such a type.
+        /// \throws node_not_found if `t` is not connected to the graph.
+        template <typename T>
+        void set_name(T&& t, std::string name) {
+            auto node = get_node(std::forward<T>(t));
+            if (node == nodes_.end()) {
+                throw node_not_found();
+            }
+            node->second.name_ = std::move(name);
+        }
+
+        /// \brief Mark a node's result as an output of the graph.
+        ///
+        /// Results are normally destroyed as soon as every node which
+        /// consumes them has read them. Outputs are instead kept until
+        /// the next execution.
+        /// \tparam T A Callable type, or a node wrapper which wraps
+        /// such a type.
+        /// \throws node_not_found if `t` is not connected to the graph.
+        template <typename T>
+        void set_output(T&& t) {
+            auto node = get_node(std::forward<T>(t));
+            if (node == nodes_.end()) {
+                throw node_not_found();
+            }
+            node->second.output_ = true;
+        }
+
+        /// \brief Mark a node pure: its result depends only on its inputs,
+        /// and invoking it has no other effect.
+        ///
+        /// Pure nodes may be merged or removed by eliminate_common and
+        /// eliminate_dead. Memoized nodes are pure.
+        /// \tparam T A Callable type, or a node wrapper which wraps
+        /// such a type.
+        /// \throws node_not_found if `t` is not connected to the graph.
+        template <typename T>
+        void set_pure(T&& t) {
+            auto node = get_node(std::forward<T>(t));
+            if (node == nodes_.end()) {
+                throw node_not_found();
+            }
+            node->second.pure_ = true;
+        }
+
+        /// \brief Memoize a pure node, caching up to `capacity` of its
+        /// results keyed by the values of its inputs.
+        ///
+        /// When the node's inputs match a cached entry, the cached result
+        /// is used and the callable is not invoked. The node's parameter
+        /// types must be hashable with `std::hash` and equality comparable,
+        /// and its result must be copyable. The cache is sharded, and
+        /// evicts with the CLOCK algorithm once full.
+        /// \tparam T A Callable type, or a node wrapper which wraps
+        /// such a type.
+        /// \throws node_not_found if `t` is not connected to the graph.
+        template <typename T>
+        void set_memoized(T&& t, size_t capacity) {
+            using t_type = typename detail::unwrap_vertex<T>::type;
+            using traits_type = typename node_type<t_type>::traits_type;
+            using result_type = typename traits_type::result_type;
+            static_assert(traits_type::arity > 0,
+                          "Only nodes with parameters can be memoized.");
+            static_assert(!std::is_void<result_type>::value &&
+                          !std::is_reference<result_type>::value,
+                          "Only nodes which return a value can be memoized.");
+
+            auto node = get_node(std::forward<T>(t));
+            if (node == nodes_.end()) {
+                throw node_not_found();
+            }
+            to_node<t_type>(node)->memoize(capacity);
+            node->second.pure_ = true;
+            revision_++;
+        }
+
+        /// \brief Get the counters of a memoized node's cache.
+        /// \throws node_not_found if `t` is not connected to the graph.
+        /// \see set_memoized
+        template <typename T>
+        memo_statistics memo_stats(T&& t) const {
+            using t_type = typename detail::unwrap_vertex<T>::type;
+            static_assert(node_type<t_type>::traits_type::arity > 0,
+                          "Only nodes with parameters can be memoized.");
+
+            auto node = get_node(std::forward<T>(t));
+            if (node == nodes_.end()) {
+                throw node_not_found();
+            }
+            return to_node<t_type>(node)->memo_stats();
+        }
+
+        /// \brief Mark a node optional, with a time budget measured from
+        /// the start of each execution.
+        ///
+        /// If the budget is exhausted before the node is started, it is
+        /// skipped and its consumers receive `fallback` instead of its
+        /// result.
+        /// \tparam T A Callable type, or a node wrapper which wraps
+        /// such a type.
+        /// \throws node_not_found if `t` is not connected to the graph.
+        template <typename T, typename V>
+        void set_optional(T&& t, std::chrono::nanoseconds budget, V&& fallback) {
+            using t_type = typename detail::unwrap_vertex<T>::type;
+            using result_type =
+                typename node_type<t_type>::traits_type::result_type;
+            using value_type = typename std::decay<V>::type;
+            static_assert(std::is_constructible<typename std::decay<result_type>::type,
+                                                value_type&>::value,
+                          "The fallback must be convertible to the node's result.");
+
+            auto node = get_node(std::forward<T>(t));
+            if (node == nodes_.end()) {
+                throw node_not_found();
+            }
+            node->second.fallback_fn_ =
+                graph_node_type::node_fallback<t_type, value_type>{
+                    std::forward<V>(fallback)};
+            node->second.budget_ = budget;
+            revision_++;
+        }
+
+        /// \brief Mark a node which returns `void` or a `std::optional`
+        /// optional, with a time budget measured from the start of each
+        /// execution.
+        ///
+        /// If the budget is exhausted before the node is started, it is
+        /// skipped. The consumers of a `void` node run as if it had
+        /// returned; those of a `std::optional` node receive an empty
+        /// optional.
+        /// \see set_optional(T&&, std::chrono::nanoseconds, V&&)
+        template <typename T>
+        void set_optional(T&& t, std::chrono::nanoseconds budget) {
+            using t_type = typename detail::unwrap_vertex<T>::type;
+            using result_type =
+                typename node_type<t_type>::traits_type::result_type;
+            static_assert(detail::has_empty_result<result_type>::value,
+                          "A node which does not return void or std::optional "
+                          "needs a fallback value.");
+
+            auto node = get_node(std::forward<T>(t));
+            if (node == nodes_.end()) {
+                throw node_not_found();
+            }
+            node->second.fallback_fn_ =
+                empty_fallback<t_type, result_type>(std::is_void<result_type>());
+            node->second.budget_ = budget;
+            revision_++;
+        }
+
+        /// \brief Make the edge from `branch` to `target` a case of the
+        /// branch, active only when `branch` returns `value`.
+        ///
+        /// `branch` becomes a branch node: once it returns, each of its
+        /// edges which has cases but no case matching the result is
+        /// inactive. A node with an inactive edge from a parent is not
+        /// invoked, and neither is anything which depends on it. Edges
+        /// without cases are always active. An edge may be given several
+        /// cases.
+        /// \tparam B A Callable type which returns a type convertible to
+        /// `size_t`, or a node wrapper which wraps such a type.
+        /// \tparam T A Callable type, or a node wrapper which wraps
+        /// such a type.
+        /// \throws node_not_found if `branch` or `target` is not
+        /// connected to the graph.
+        /// \throws edge_not_found if `target` is not connected to
+        /// `branch`.
+        template <typename B, typename T>
+        void set_case(B&& branch, T&& target, size_t value) {
+            using b_type = typename detail::unwrap_vertex<B>::type;
+            using result_type =
+                typename node_type<b_type>::traits_type::result_type;
+            static_assert(std::is_convertible<result_type, size_t>::value ||
+                          std::is_enum<typename std::decay<result_type>::type>::value,
+                          "A branch must return a type convertible to size_t.");
+
+            auto bnode = get_node(std::forward<B>(branch));
+            auto tnode = get_node(std::forward<T>(target));
+            if (bnode == nodes_.end() || tnode == nodes_.end()) {
+                throw node_not_found();
+            }
+            if (!has_child(&bnode->second, &tnode->second)) {
+                throw edge_not_found();
+            }
+            bnode->second.template make_branch<b_type>();
+            bnode->second.cases_.push_back(
+                graph_node_type::branch_case{&tnode->second, value});
+            revision_++;
+        }
+
         /// \brief Check that each node in the graph with a non-empty
         /// parameter list has each parameter bound.
         bool valid() const {
@@ -201,7 +524,8 @@ namespace callgraph {
         ///
         /// This operation does not affect the callgraph invokation.
         /// It does however potentially reduce the number of concurrent
-        /// threads required.
+        /// threads required. Edges which are cases of a branch, or inputs
+        /// of a reduce node, are kept.
         void reduce()  {
             // For each pair of nodes, if there is a path
             // between them with a distance > 1, remove the
@@ -212,7 +536,10 @@ namespace callgraph {
             for (auto& kpair : nodes_) {
                 graph_node_type& knode(kpair.second);
                 for (const graph_node_type* jnode : knode.children_) {
-                    if (longest_path(&knode, jnode) > 1) {
+                    // Branch cases, and the inputs of reductions, must
+                    // stay direct edges.
+                    if (longest_path(&knode, jnode) > 1 &&
+                        !knode.has_case(jnode) && !jnode->reduces()) {
                         remove.emplace_back(&knode, jnode);
                     }
                 }
@@ -220,6 +547,148 @@ namespace callgraph {
             for (auto &rpair : remove) {
                 rpair.first->children_.erase(rpair.second);
             }
+            revision_++;
+        }
+
+        /// \brief Fuse each linear chain of nodes, in which every node
+        /// but the first is the only child of the node before it and has
+        /// no other parent.
+        ///
+        /// A graph_runner executes a fused chain as one unit: each link
+        /// runs on the worker which ran the node before it, as soon as
+        /// that node returns, without passing through the work queue. The
+        /// nodes keep their identities; each is still named, exported and
+        /// timed individually, and publishes its result to its consumers.
+        /// Nodes which are parallel, asynchronous, spawn tasks, are
+        /// optional or take part in a reduction are not fused, and a
+        /// branch only ends a chain. Links which stop forming a chain as
+        /// the graph changes are not fused. Runners pick up the chains
+        /// when their next execution starts.
+        /// \return The number of links fused.
+        size_t fuse() {
+            std::unordered_map<const graph_node_type*, size_t> parents;
+            for (auto& pair : nodes_) {
+                for (const graph_node_type* child : pair.second.children_) {
+                    parents[child]++;
+                }
+            }
+            size_t fused(0);
+            for (auto& pair : nodes_) {
+                graph_node_type& node(pair.second);
+                node.fused_ = nullptr;
+                if (node.children_.size() != 1) {
+                    continue;
+                }
+                const graph_node_type* child(*node.children_.begin());
+                if (parents[child] == 1 && node.fusible(child)) {
+                    node.fused_ = child;
+                    fused++;
+                }
+            }
+            revision_++;
+            return fused;
+        }
+
+        /// \brief Merge pure nodes which compute the same result.
+        ///
+        /// Two pure nodes are equivalent when their callables have the
+        /// same type and either hold no state or compare equal, and they
+        /// are bound to the same inputs in the same way. Each group of
+        /// equivalent nodes is merged into one, which takes over the
+        /// children of the rest; merging repeats until no equivalent
+        /// nodes remain, so equivalent chains merge entirely. Outputs are
+        /// kept in preference to other nodes, and two outputs are never
+        /// merged. Branches, their cases, and nodes which are parallel,
+        /// asynchronous, spawn tasks, are optional or reduce are left
+        /// alone. Merged nodes are removed from the graph and can no
+        /// longer be named. Optimize a graph before constructing its
+        /// runners.
+        /// \return The number of nodes removed.
+        /// \see set_pure
+        size_t eliminate_common() {
+            size_t eliminated(0);
+            std::vector<const graph_node_type*> dropped;
+            do {
+                dropped.clear();
+                std::unordered_multimap<size_t, graph_node_type*> kept;
+                for (auto& pair : nodes_) {
+                    graph_node_type* node(&pair.second);
+                    if (!mergeable(*node)) {
+                        continue;
+                    }
+                    auto range(kept.equal_range(node->type_->hash_code()));
+                    auto match(std::find_if(range.first, range.second,
+                                            [node](const auto& k) {
+                                                return k.second->same(*node);
+                                            }));
+                    if (match == range.second) {
+                        kept.emplace(node->type_->hash_code(), node);
+                    }
+                    else if (!node->output_) {
+                        merge(*node, *match->second);
+                        dropped.push_back(node);
+                    }
+                    else if (!match->second->output_) {
+                        merge(*match->second, *node);
+                        dropped.push_back(match->second);
+                        match->second = node;
+                    }
+                }
+                erase(dropped);
+                eliminated += dropped.size();
+            } while (!dropped.empty());
+            return eliminated;
+        }
+
+        /// \brief Remove pure nodes whose results can never be used.
+        ///
+        /// A node is live if it is an output, is not pure, or is a parent
+        /// of a live node; every other node is removed. A graph with no
+        /// outputs and no impure nodes is left empty but for its root.
+        /// Removed nodes can no longer be named. Optimize a graph before
+        /// constructing its runners.
+        /// \return The number of nodes removed.
+        /// \see set_output
+        /// \see set_pure
+        size_t eliminate_dead() {
+            std::unordered_set<const graph_node_type*> live;
+            std::vector<const graph_node_type*> stack;
+            for (auto& pair : nodes_) {
+                const graph_node_type& node(pair.second);
+                if (!node.pure_ || node.output_ || &node == root_node_) {
+                    stack.push_back(&node);
+                }
+            }
+            while (!stack.empty()) {
+                const graph_node_type* node(stack.back());
+                stack.pop_back();
+                if (live.insert(node).second) {
+                    for (const auto& input : node->inputs_) {
+                        stack.push_back(input.source);
+                    }
+                }
+            }
+            std::vector<const graph_node_type*> dead;
+            for (auto& pair : nodes_) {
+                if (live.find(&pair.second) == live.end()) {
+                    dead.push_back(&pair.second);
+                }
+            }
+            erase(dead);
+            return dead.size();
+        }
+
+        /// \brief Run a sequence of optimization passes over the graph,
+        /// in order.
+        ///
+        /// Each pass is either a member function of graph which returns
+        /// the number of nodes it eliminated, such as eliminate_common or
+        /// eliminate_dead, or a Callable taking `graph&` and returning
+        /// such a count.
+        /// \return The count returned by each pass, in order.
+        template <typename... Passes>
+        std::array<size_t, sizeof...(Passes)> optimize(Passes&&... passes) {
+            return {{run_pass(std::forward<Passes>(passes))...}};
         }
 
     private:
@@ -228,6 +697,10 @@ namespace callgraph {
 
         using graph_node_type = callgraph::detail::graph_node;
         friend class graph_runner;
+        friend class graph_exporter;
+        friend class stream_runner;
+        template <typename S>
+        friend class subgraph;
 
         using fn_key = detail::node_key;
         using map_type = std::unordered_map<fn_key, graph_node_type>;
@@ -259,6 +732,7 @@ namespace callgraph {
             if (found == nodes_.end()) {
                 found = nodes_.emplace(
                     key, detail::make_graph_node(std::forward<T>(t))).first;
+                found->second.id_ = next_id_++;
             }
             return found;
         }
@@ -275,9 +749,119 @@ namespace callgraph {
             return nodes_.find(key);
         }
 
+        size_t run_pass(size_t (graph::*pass)()) {
+            return (this->*pass)();
+        }
+
+        template <typename P>
+        size_t run_pass(P&& pass) {
+            return std::forward<P>(pass)(*this);
+        }
+
+        // Whether eliminate_common may merge `node` with its equals.
+        bool mergeable(const graph_node_type& node) const {
+            if (!node.pure_ || !node.simple() || node.branch() ||
+                &node == root_node_) {
+                return false;
+            }
+            return std::none_of(node.inputs_.begin(), node.inputs_.end(),
+                                [&node](const auto& input) {
+                                    return input.source->has_case(&node);
+                                });
+        }
+
+        // Have every reader of `from` read `to`, its equal, instead, and
+        // give `to` the children of `from`.
+        void merge(graph_node_type& from, graph_node_type& to) {
+            for (auto& pair : nodes_) {
+                graph_node_type& node(pair.second);
+                node.children_.erase(&from);
+                if (std::any_of(node.inputs_.begin(), node.inputs_.end(),
+                                [&from](const auto& input) {
+                                    return input.source == &from;
+                                })) {
+                    node.rebind(&from, &to);
+                }
+            }
+            for (const graph_node_type* child : from.children_) {
+                to.children_.insert(child);
+            }
+            from.children_.clear();
+            revision_++;
+        }
+
+        // Remove `nodes`, which no remaining node reads, and every edge
+        // to them.
+        void erase(const std::vector<const graph_node_type*>& nodes) {
+            if (nodes.empty()) {
+                return;
+            }
+            std::unordered_set<const graph_node_type*> erased(nodes.begin(),
+                                                              nodes.end());
+            for (auto& pair : nodes_) {
+                graph_node_type& node(pair.second);
+                for (const graph_node_type* e : nodes) {
+                    node.children_.erase(e);
+                }
+                node.cases_.erase(
+                    std::remove_if(node.cases_.begin(), node.cases_.end(),
+                                   [&erased](const auto& c) {
+                                       return erased.find(c.target) != erased.end();
+                                   }),
+                    node.cases_.end());
+                if (erased.find(node.fused_) != erased.end()) {
+                    node.fused_ = nullptr;
+                }
+            }
+            for (auto it = nodes_.begin(); it != nodes_.end();) {
+                if (erased.find(&it->second) != erased.end()) {
+                    it = nodes_.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+            revision_++;
+        }
+
+        // Point the edges of a node moved from another graph at the
+        // nodes moved with it.
+        static void relink(graph_node_type& node,
+                           const std::unordered_map<const graph_node_type*,
+                                                    graph_node_type*>& moved) {
+            std::unordered_set<const graph_node_type*> children;
+            for (const graph_node_type* child : node.children_) {
+                children.insert(moved.at(child));
+            }
+            node.children_.swap(children);
+            for (auto& input : node.inputs_) {
+                input.source = moved.at(input.source);
+            }
+            for (auto& c : node.cases_) {
+                c.target = moved.at(c.target);
+            }
+            if (node.fused_) {
+                node.fused_ = moved.at(node.fused_);
+            }
+        }
+
+        template <typename T, typename R>
+        static graph_node_type::node_fallback<T, R> empty_fallback(std::false_type) {
+            return graph_node_type::node_fallback<T, R>{R()};
+        }
+
+        template <typename T, typename R>
+        static graph_node_type::node_fallback<T, void> empty_fallback(std::true_type) {
+            return graph_node_type::node_fallback<T, void>();
+        }
+
         static void dummy() {}
 
         map_type nodes_;
+        size_t next_id_;
+        // Counts changes to the nodes and edges, so that runners know
+        // when to rebuild their view of the graph.
+        size_t revision_;
         void (*root_)();
         graph_node_type* root_node_;
     };
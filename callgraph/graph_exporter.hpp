@@ -0,0 +1,381 @@
+// callgraph/graph_exporter.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_GRAPH_EXPORTER_HPP
+#define CALLGRAPH_GRAPH_EXPORTER_HPP
+
+#include <callgraph/graph.hpp>
+#include <callgraph/latency_report.hpp>
+#include <callgraph/detail/graph_node.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#endif
+
+namespace callgraph {
+
+/// \brief Writes a graph in Graphviz DOT or JSON format, optionally
+/// annotated with the runtime statistics recorded by a graph_runner.
+///
+/// Nodes are labelled with the name given by graph::set_name, or with
+/// the demangled type of their callable. Edges are labelled with the
+/// parameter bindings they carry, written `from->to`.
+///
+/// When statistics are attached, each node is annotated with its mean
+/// and 99th percentile execution time and shaded by its share of the
+/// slowest node's mean. The critical path, the chain of nodes from the
+/// root with the greatest total mean execution time, is highlighted.
+    class graph_exporter {
+    public:
+        /// \brief Construct an exporter for graph `g`.
+        explicit graph_exporter(const graph& g)
+            : graph_(&g),
+              statistics_(nullptr)
+            {
+            }
+
+        /// \brief Annotate the exported graph with the statistics in
+        /// `report`, which must outlive the exporter.
+        graph_exporter& with_statistics(const latency_report& report) {
+            statistics_ = &report;
+            return *this;
+        }
+
+        /// \brief Write the graph in Graphviz DOT format.
+        void write_dot(std::ostream& os) const {
+            annotations a(annotate());
+            os << "digraph callgraph {\n"
+               << "  node [shape=box, style=filled, fillcolor=white];\n";
+            for (const graph_node_type* n : a.order) {
+                os << "  n" << n->id() << " [label=\""
+                   << escape(label(n));
+                const node_latency* s(a.stats(n));
+                if (s) {
+                    os << "\\nmean " << format(s->execution.mean())
+                       << ", p99 " << format(s->execution.p99());
+                }
+                os << "\"";
+                if (s && a.slowest > 0) {
+                    double heat(static_cast<double>(
+                                    s->execution.mean().count()) / a.slowest);
+                    char colour[32];
+                    std::snprintf(colour, sizeof(colour),
+                                  "0.000 %.3f 1.000", heat);
+                    os << ", fillcolor=\"" << colour << "\"";
+                }
+                if (a.critical.count(n)) {
+                    os << ", color=red, penwidth=2";
+                }
+                os << "];\n";
+            }
+            for (const graph_node_type* n : a.order) {
+                for (const edge& e : edges(n, a)) {
+                    os << "  n" << n->id() << " -> n" << e.child->id();
+                    std::vector<std::string> attrs;
+                    if (!e.label.empty()) {
+                        attrs.push_back("label=\"" + escape(e.label) + "\"");
+                    }
+                    if (!e.scheduled) {
+                        attrs.push_back("style=dashed");
+                    }
+                    if (a.critical_edge(n, e.child)) {
+                        attrs.push_back("color=red");
+                        attrs.push_back("penwidth=2");
+                    }
+                    for (size_t i = 0; i < attrs.size(); i++) {
+                        os << (i == 0 ? " [" : ", ") << attrs[i];
+                    }
+                    os << (attrs.empty() ? ";\n" : "];\n");
+                }
+            }
+            os << "}\n";
+        }
+
+        /// \brief Write the graph in JSON format.
+        ///
+        /// The document has a `nodes` array and an `edges` array. Nodes
+        /// have an `id`, `name` and `type`, and when statistics are
+        /// attached, `count`, `mean_ns`, `p50_ns`, `p99_ns`, `p999_ns`
+        /// and `critical`. Edges have `source` and `target` ids, a
+        /// `scheduled` flag which is false for data-only bindings removed
+        /// by graph::reduce, a `bindings` array of `{from, to}` objects
+        /// and, with statistics, `critical`.
+        void write_json(std::ostream& os) const {
+            annotations a(annotate());
+            os << "{\n  \"nodes\": [";
+            bool first(true);
+            for (const graph_node_type* n : a.order) {
+                os << (first ? "\n" : ",\n");
+                first = false;
+                os << "    {\"id\": " << n->id()
+                   << ", \"name\": \"" << json_escape(label(n)) << "\""
+                   << ", \"type\": \"" << json_escape(type_name(n)) << "\"";
+                const node_latency* s(a.stats(n));
+                if (s) {
+                    os << ", \"count\": " << s->execution.count()
+                       << ", \"mean_ns\": " << s->execution.mean().count()
+                       << ", \"p50_ns\": " << s->execution.p50().count()
+                       << ", \"p99_ns\": " << s->execution.p99().count()
+                       << ", \"p999_ns\": " << s->execution.p999().count();
+                }
+                if (statistics_) {
+                    os << ", \"critical\": "
+                       << (a.critical.count(n) ? "true" : "false");
+                }
+                os << "}";
+            }
+            os << "\n  ],\n  \"edges\": [";
+            first = true;
+            for (const graph_node_type* n : a.order) {
+                for (const edge& e : edges(n, a)) {
+                    os << (first ? "\n" : ",\n");
+                    first = false;
+                    os << "    {\"source\": " << n->id()
+                       << ", \"target\": " << e.child->id()
+                       << ", \"scheduled\": " << (e.scheduled ? "true" : "false")
+                       << ", \"bindings\": [";
+                    for (size_t i = 0; i < e.bindings.size(); i++) {
+                        os << (i > 0 ? ", " : "")
+                           << "{\"from\": " << e.bindings[i].from
+                           << ", \"to\": " << e.bindings[i].to << "}";
+                    }
+                    os << "]";
+                    if (statistics_) {
+                        os << ", \"critical\": "
+                           << (a.critical_edge(n, e.child) ? "true" : "false");
+                    }
+                    os << "}";
+                }
+            }
+            os << "\n  ]\n}\n";
+        }
+
+    private:
+        using graph_node_type = detail::graph_node;
+        using binding = graph_node_type::binding;
+
+        struct edge {
+            const graph_node_type* child;
+            bool scheduled;
+            std::vector<binding> bindings;
+            std::string label;
+        };
+
+        struct annotations {
+            // Nodes ordered by id, i.e. by the order they were added.
+            std::vector<const graph_node_type*> order;
+            // Parameter bindings, keyed by source node.
+            std::unordered_multimap<const graph_node_type*,
+                                    std::pair<const graph_node_type*, binding>>
+            outputs;
+            std::unordered_map<const graph_node_type*,
+                               const node_latency*> statistics;
+            std::unordered_set<const graph_node_type*> critical;
+            double slowest = 0.0;
+
+            const node_latency* stats(const graph_node_type* n) const {
+                auto found(statistics.find(n));
+                return found == statistics.end() ? nullptr : found->second;
+            }
+
+            bool critical_edge(const graph_node_type* a,
+                               const graph_node_type* b) const {
+                return critical.count(a) && critical.count(b) &&
+                    a->children_.count(b);
+            }
+        };
+
+        annotations annotate() const {
+            annotations a;
+            for (auto& pair : graph_->nodes_) {
+                a.order.push_back(&pair.second);
+                for (const binding& b : pair.second.inputs_) {
+                    if (b.to >= 0) {
+                        a.outputs.emplace(b.source, std::make_pair(&pair.second, b));
+                    }
+                }
+                if (statistics_) {
+                    auto found(statistics_->nodes().find(pair.first));
+                    if (found != statistics_->nodes().end()) {
+                        a.statistics[&pair.second] = &found->second;
+                        a.slowest = std::max(
+                            a.slowest,
+                            static_cast<double>(
+                                found->second.execution.mean().count()));
+                    }
+                }
+            }
+            std::sort(a.order.begin(), a.order.end(),
+                      [](const graph_node_type* x, const graph_node_type* y) {
+                          return x->id() < y->id();
+                      });
+            if (statistics_) {
+                mark_critical_path(a);
+            }
+            return a;
+        }
+
+        // Longest path from the root, weighting each node by its mean
+        // execution time.
+        void mark_critical_path(annotations& a) const {
+            std::unordered_map<const graph_node_type*, double> cost;
+            std::unordered_map<const graph_node_type*,
+                               const graph_node_type*> next;
+            path_cost(graph_->root_node_, a, cost, next);
+
+            const graph_node_type* n(graph_->root_node_);
+            while (n) {
+                a.critical.insert(n);
+                auto found(next.find(n));
+                n = found == next.end() ? nullptr : found->second;
+            }
+        }
+
+        static double path_cost(
+            const graph_node_type* n,
+            const annotations& a,
+            std::unordered_map<const graph_node_type*, double>& cost,
+            std::unordered_map<const graph_node_type*,
+                               const graph_node_type*>& next) {
+            auto found(cost.find(n));
+            if (found != cost.end()) {
+                return found->second;
+            }
+            double best(0.0);
+            const graph_node_type* best_child(nullptr);
+            for (const graph_node_type* child : n->children_) {
+                double c(path_cost(child, a, cost, next));
+                if (!best_child || c > best) {
+                    best = c;
+                    best_child = child;
+                }
+            }
+            const node_latency* s(a.stats(n));
+            double self(s ? static_cast<double>(s->execution.mean().count()) : 0.0);
+            if (best_child) {
+                next[n] = best_child;
+            }
+            return cost[n] = self + best;
+        }
+
+        // Scheduling edges, plus data bindings whose scheduling edge
+        // was removed by a transitive reduction.
+        static std::vector<edge> edges(const graph_node_type* n,
+                                       const annotations& a) {
+            std::vector<edge> out;
+            auto find = [&out](const graph_node_type* child) -> edge& {
+                for (edge& e : out) {
+                    if (e.child == child) {
+                        return e;
+                    }
+                }
+                out.push_back(edge{child, false, {}, {}});
+                return out.back();
+            };
+            for (const graph_node_type* child : n->children_) {
+                find(child).scheduled = true;
+            }
+            auto range(a.outputs.equal_range(n));
+            for (auto it = range.first; it != range.second; ++it) {
+                find(it->second.first).bindings.push_back(it->second.second);
+            }
+            std::sort(out.begin(), out.end(), [](const edge& x, const edge& y) {
+                    return x.child->id() < y.child->id();
+                });
+            for (edge& e : out) {
+                std::sort(e.bindings.begin(), e.bindings.end(),
+                          [](const binding& x, const binding& y) {
+                              return x.to < y.to;
+                          });
+                for (const binding& b : e.bindings) {
+                    if (!e.label.empty()) {
+                        e.label += ", ";
+                    }
+                    e.label += (b.from >= 0 ? std::to_string(b.from) : "") +
+                        "->" + std::to_string(b.to);
+                }
+            }
+            return out;
+        }
+
+        static std::string type_name(const graph_node_type* n) {
+            const char* mangled(n->type_->name());
+#if defined(__GNUG__)
+            int status(0);
+            std::unique_ptr<char, void(*)(void*)> demangled(
+                abi::__cxa_demangle(mangled, nullptr, nullptr, &status),
+                std::free);
+            if (status == 0 && demangled) {
+                return demangled.get();
+            }
+#endif
+            return mangled;
+        }
+
+        static std::string label(const graph_node_type* n) {
+            return n->name_.empty() ? type_name(n) : n->name_;
+        }
+
+        static std::string format(std::chrono::nanoseconds d) {
+            char buf[32];
+            double ns(static_cast<double>(d.count()));
+            if (ns >= 1e6) {
+                std::snprintf(buf, sizeof(buf), "%.2fms", ns / 1e6);
+            }
+            else if (ns >= 1e3) {
+                std::snprintf(buf, sizeof(buf), "%.2fus", ns / 1e3);
+            }
+            else {
+                std::snprintf(buf, sizeof(buf), "%.0fns", ns);
+            }
+            return buf;
+        }
+
+        static std::string escape(const std::string& s) {
+            std::string out;
+            for (char c : s) {
+                if (c == '"' || c == '\\') {
+                    out += '\\';
+                }
+                out += c;
+            }
+            return out;
+        }
+
+        static std::string json_escape(const std::string& s) {
+            std::string out;
+            for (char c : s) {
+                if (c == '"' || c == '\\') {
+                    out += '\\';
+                    out += c;
+                }
+                else if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                }
+                else {
+                    out += c;
+                }
+            }
+            return out;
+        }
+
+        const graph* graph_;
+        const latency_report* statistics_;
+    };
+}
+
+#endif // CALLGRAPH_GRAPH_EXPORTER_HPP
@@ -4,41 +4,162 @@
 #ifndef CALLGRAPH_GRAPH_RUNNER_HPP
 #define CALLGRAPH_GRAPH_RUNNER_HPP
 
+#include <callgraph/cancellation_token.hpp>
 #include <callgraph/graph.hpp>
+#include <callgraph/latency_histogram.hpp>
+#include <callgraph/latency_report.hpp>
+#include <callgraph/runner_metrics.hpp>
+#include <callgraph/spawn_context.hpp>
+#include <callgraph/detail/async_target.hpp>
+#include <callgraph/detail/event_reactor.hpp>
 #include <callgraph/detail/graph_node.hpp>
+#include <callgraph/detail/io_reactor.hpp>
+#include <callgraph/detail/recycling_allocator.hpp>
+#include <callgraph/detail/ring_queue.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
 #include <mutex>
 #include <future>
-#include <queue>
+#include <type_traits>
 #include <vector>
 
 namespace callgraph {
     namespace detail {
         struct graph_worker;
+
+        template <typename T>
+        struct is_steady_time_point : std::false_type {
+        };
+
+        template <typename D>
+        struct is_steady_time_point<
+            std::chrono::time_point<std::chrono::steady_clock, D>> : std::true_type {
+        };
+
+        // Arguments which select an execute overload other than the
+        // targeted one.
+        template <typename T>
+        struct is_run_option : std::integral_constant<
+            bool,
+            std::is_same<typename std::decay<T>::type, cancellation_token>::value ||
+            is_steady_time_point<typename std::decay<T>::type>::value> {
+        };
+
+        // Convert a deadline of any precision to the clock's own, where a
+        // deadline beyond the clock's range never passes.
+        template <typename D>
+        std::chrono::steady_clock::time_point steady_deadline(
+            std::chrono::time_point<std::chrono::steady_clock, D> deadline) {
+            using time_point = std::chrono::steady_clock::time_point;
+            using seconds = std::chrono::duration<double>;
+            if (std::chrono::duration_cast<seconds>(deadline.time_since_epoch()) >=
+                std::chrono::duration_cast<seconds>(time_point::max().time_since_epoch())) {
+                return time_point::max();
+            }
+            return std::chrono::time_point_cast<time_point::duration>(deadline);
+        }
     }
 
+    /// \brief A tag type used to select the preallocating graph_runner
+    /// constructors.
+    struct preallocate_t {
+        explicit preallocate_t() = default;
+    };
+
+    /// \brief Tag requesting that a graph_runner allocate everything it
+    /// needs at construction.
+    constexpr preallocate_t preallocate{};
+
 /// \brief A graph runner is a non-copyable type
 /// which launches worker threads to run a callgraph.
 ///
-/// A graph runner may be invoked many times in succession.
+/// A graph runner may be invoked many times in succession. Once a runner
+/// has completed its first execution, subsequent executions do not
+/// allocate memory, unless the nodes themselves do.
+///
+/// The graph may be changed between executions, by connecting, inserting
+/// or optimizing nodes; the runner picks up the changes when its next
+/// execution starts, which may then allocate.
     class graph_runner {
     public:
         /// \brief Construct a callgraph runner which wraps a graph.
         graph_runner(graph& g)
+            : graph_runner(g, 0)
+            {
+            }
+
+        /// \brief Construct a callgraph runner which wraps a graph and
+        /// runs `workers` worker threads.
+        ///
+        /// Nodes never block waiting for their inputs, so any number of
+        /// workers can execute any graph. If `workers` is zero, the runner
+        /// uses as many worker threads as the depth of the graph.
+        graph_runner(graph& g, size_t workers)
             : graph_(&g),
               on_(true),
-              max_leaves_(graph_->leaves())
+              max_workers_(workers > 0 ? workers : std::max<size_t>(graph_->depth(), 1)),
+              outstanding_(0),
+              failed_(false),
+              deadline_(clock_type::time_point::max()),
+              incremental_(false),
+              targeted_(false),
+              all_dirty_(true),
+              run_(0),
+              revision_(0),
+              pool_(std::make_shared<detail::recycling_pool>()),
+              done_(std::allocator_arg, done_allocator())
+            {
+                build();
+            }
+
+        /// \brief Construct a callgraph runner which wraps a graph, and
+        /// allocate everything it needs up front.
+        ///
+        /// The worker threads, work queue and completion state are all
+        /// created here, so that no execution of the graph allocates
+        /// memory, unless the nodes themselves do.
+        graph_runner(graph& g, preallocate_t)
+            : graph_runner(g, 0, preallocate)
             {
             }
 
+        /// \brief Construct a callgraph runner which wraps a graph and
+        /// runs `workers` worker threads, and allocate everything it
+        /// needs up front.
+        /// \see graph_runner(graph&, preallocate_t)
+        graph_runner(graph& g, size_t workers, preallocate_t)
+            : graph_runner(g, workers)
+            {
+                {
+                    // Every node is queued at most once per run, along
+                    // with helpers for each parallel node.
+                    size_t parallel(0);
+                    for (auto& pair : graph_->nodes_) {
+                        if (pair.second.parallel()) {
+                            parallel++;
+                        }
+                    }
+                    std::unique_lock<std::mutex> lk(queue_mutex_);
+                    queue_.reserve(graph_->next_id_ + parallel * max_workers_);
+                }
+                pool_->reserve(4);
+                start_workers();
+            }
+
         /// \brief Callgraph runner destructor. Wait for all
         /// worker threads to finish.
         ~graph_runner() {
             {
                 std::unique_lock<std::mutex> lk(queue_mutex_);
                 on_ = false;
-                queue_ = std::queue<const graph_node_type*>();
+                queue_.clear();
             }
             // Wake up workers
             queue_avail_.notify_all();
@@ -59,49 +180,1093 @@ namespace callgraph {
         }
 
         /// \brief Execute the call graph asynchronously.
+        ///
+        /// If a node throws, the exception is stored in its result and the
+        /// run stops: nodes waiting in the queue are discarded, no further
+        /// nodes are invoked, and the first exception thrown is rethrown
+        /// from the returned future once the nodes already executing have
+        /// returned.
         /// \return A future which can be used to wait for the call to finish or
         /// to catch any exception thrown.
         /// \warning Subsequent executions must not be invoked until previous calls
         /// have finished.
         std::future<void> execute() {
+            return execute(clock_type::time_point::max());
+        }
+
+        /// \brief Execute the call graph asynchronously, stopping if
+        /// `token` is cancelled.
+        ///
+        /// Once the token is cancelled, no further nodes are started and
+        /// queued nodes are discarded. Nodes which are already executing
+        /// may poll the token to return early. The returned future throws
+        /// cancelled_error once they have returned. Idle workers check the
+        /// token every 10 milliseconds, so a run waiting only on event
+        /// sources stops too.
+        /// \see execute()
+        std::future<void> execute(cancellation_token token) {
+            return execute(std::move(token), clock_type::time_point::max());
+        }
+
+        /// \brief Execute the call graph asynchronously, stopping if it has
+        /// not finished by `deadline`.
+        ///
+        /// The returned future throws deadline_exceeded if the deadline
+        /// passes before the graph finishes.
+        /// The deadline may have any precision.
+        /// \see execute(cancellation_token)
+        template <typename D>
+        std::future<void> execute(std::chrono::time_point<std::chrono::steady_clock, D> deadline) {
+            own_token_.reset();
+            return execute(own_token_, deadline);
+        }
+
+        /// \brief Execute the call graph asynchronously, stopping if
+        /// `token` is cancelled or if it has not finished by `deadline`.
+        ///
+        /// When the deadline passes, the runner cancels the token of the
+        /// run, not `token`, which may be used for later executions.
+        /// \see execute(cancellation_token)
+        /// \see execute(std::chrono::time_point<std::chrono::steady_clock, D>)
+        /// \see token
+        template <typename D>
+        std::future<void> execute(cancellation_token token,
+                                  std::chrono::time_point<std::chrono::steady_clock, D> deadline) {
+            return start(std::move(token), detail::steady_deadline(deadline), false);
+        }
+
+        /// \brief Get the token of the current run.
+        ///
+        /// The token is cancelled once the token passed to the execution
+        /// is cancelled, or once the run's deadline passes; it checks the
+        /// clock itself, so polling nodes see the deadline even while no
+        /// worker is free to notice it. Nodes which run for a long time can
+        /// poll it to return early either way. It is reset when the next
+        /// execution starts.
+        const cancellation_token& token() const {
+            return run_token_;
+        }
+
+        /// \brief Execute only the given nodes and the nodes they depend
+        /// on, asynchronously.
+        ///
+        /// The run is complete once every target has finished; nodes
+        /// which no target depends on are not invoked, and keep whatever
+        /// result they had.
+        /// \tparam T Callable types, or node wrappers which wrap such
+        /// types.
+        /// \throws node_not_found if a target is not connected to the
+        /// graph.
+        /// \see execute()
+        template <typename T, typename... Ts>
+        typename std::enable_if<!detail::is_run_option<T>::value, std::future<void>>::type
+        execute(T&& target, Ts&&... targets) {
+            const graph_node_type* nodes[] = {
+                find_target(std::forward<T>(target)),
+                find_target(std::forward<Ts>(targets))...
+            };
+            own_token_.reset();
+            return start(own_token_, clock_type::time_point::max(), false,
+                         nodes, sizeof...(Ts) + 1);
+        }
+
+        /// \brief Mark a node dirty, so that the next incremental execution
+        /// recomputes it and the nodes downstream of it.
+        ///
+        /// Use this when something a node reads from outside the graph,
+        /// such as the input to a source, has changed.
+        /// \tparam T A Callable type, or a node wrapper which wraps
+        /// such a type.
+        /// \throws node_not_found if `t` is not connected to the graph.
+        /// \warning This must not be called while the graph is executing.
+        template <typename T>
+        void mark_dirty(T&& t) {
+            auto node = graph_->get_node(std::forward<T>(t));
+            if (node == graph_->nodes_.end()) {
+                throw node_not_found();
+            }
+            refresh();
+            mark_node_dirty(&node->second);
+        }
+
+        /// \brief Run cheap nodes inline, once their cost has been measured.
+        ///
+        /// The runner times every node over its next `runs` executions.
+        /// From then on, each node whose mean execution time was below
+        /// `threshold` is not queued: it runs on the worker which
+        /// finished the last of its parents, straight after that parent.
+        /// Nodes which are parallel, asynchronous, spawn tasks, are
+        /// optional or reduce are always queued, as are all nodes in
+        /// incremental executions. Calling this again measures afresh;
+        /// zero `runs` or a zero threshold turns inlining off.
+        /// \see inlined
+        /// \see runner_metrics::nodes_inlined
+        /// \warning This must not be called while the graph is executing.
+        void set_inlining(size_t runs, std::chrono::nanoseconds threshold) {
             std::unique_lock<std::mutex> lk(done_mutex_);
+            refresh();
+            inline_runs_ = threshold.count() > 0 ? runs : 0;
+            inline_threshold_ = threshold;
+            runs_measured_ = 0;
+            for (node_state& state : states_) {
+                state.inlined = false;
+                state.measured.store(0, std::memory_order_relaxed);
+                state.samples.store(0, std::memory_order_relaxed);
+            }
+            counters_.nodes_inlined.store(0, std::memory_order_relaxed);
+        }
+
+        /// \brief Report whether a node has been classified as cheap
+        /// enough to run inline.
+        /// \tparam T A Callable type, or a node wrapper which wraps
+        /// such a type.
+        /// \throws node_not_found if `t` is not connected to the graph.
+        /// \see set_inlining
+        /// \warning This must not be called while an execution is starting.
+        template <typename T>
+        bool inlined(T&& t) const {
+            auto node = graph_->get_node(std::forward<T>(t));
+            if (node == graph_->nodes_.end()) {
+                throw node_not_found();
+            }
+            size_t id(node->second.id());
+            return id < states_.size() && states_[id].inlined;
+        }
+
+        /// \brief Execute only the nodes downstream of dirty nodes.
+        ///
+        /// Every other node keeps its result from the previous execution.
+        /// A recomputed node whose result compares equal to its previous
+        /// result does not make its dependents stale, so propagation stops
+        /// there. Results which cannot be compared always count as changed.
+        ///
+        /// Incremental executions keep every result until it is
+        /// recomputed. The first incremental execution, and any following
+        /// a plain or failed execution, runs the whole graph.
+        /// \see execute(cancellation_token, std::chrono::time_point<std::chrono::steady_clock, D>)
+        std::future<void> execute_incremental() {
+            own_token_.reset();
+            return start(own_token_, clock_type::time_point::max(), true);
+        }
+
+        /// \brief Execute only the nodes downstream of dirty nodes,
+        /// stopping if `token` is cancelled or if the execution has not
+        /// finished by `deadline`.
+        /// \see execute_incremental()
+        template <typename D = std::chrono::steady_clock::duration>
+        std::future<void> execute_incremental(
+            cancellation_token token,
+            std::chrono::time_point<std::chrono::steady_clock, D> deadline =
+                std::chrono::time_point<std::chrono::steady_clock, D>::max()) {
+            return start(std::move(token), detail::steady_deadline(deadline), true);
+        }
+
+        /// \brief Take a snapshot of the latency distributions recorded
+        /// across every execution since construction or the last call
+        /// to reset_latencies.
+        ///
+        /// This may be called at any time, including while the graph is
+        /// executing; samples recorded concurrently may or may not be
+        /// included.
+        latency_report latencies() const {
+            latency_report report;
+            report.run_ = run_latency_.snapshot();
             for (auto& pair : graph_->nodes_) {
-                pair.second.reset();
+                if (&pair.second == graph_->root_node_) {
+                    continue;
+                }
+                node_latency& n(report.nodes_[pair.first]);
+                if (pair.second.id() >= states_.size()) {
+                    // Added since the last execution.
+                    continue;
+                }
+                const node_state& stats(states_[pair.second.id()]);
+                n.execution = stats.execution.snapshot();
+                n.queue_wait = stats.queue_wait.snapshot();
+                report.execution_ += n.execution;
+                report.queue_wait_ += n.queue_wait;
             }
-            leaves_ = max_leaves_;
+            return report;
+        }
 
-            size_t min_workers(graph_->depth());
-            workers_.reserve(min_workers);
-            while (workers_.size() < min_workers) {
-                workers_.emplace_back(std::make_shared<graph_worker_type>(*this));
+        /// \brief Discard all recorded latency samples.
+        void reset_latencies() {
+            run_latency_.reset();
+            for (node_state& state : states_) {
+                state.execution.reset();
+                state.queue_wait.reset();
             }
+        }
 
-            done_ = std::promise<void>();
-            enqueue_node(graph_->root_node_);
-            return done_.get_future();
+        /// \brief Take a snapshot of the runner's cumulative counters.
+        ///
+        /// This is cheap and may be called at any time, including while
+        /// the graph is executing.
+        runner_metrics metrics() const {
+            using duration = runner_metrics::duration;
+            auto load = [](const std::atomic<std::uint64_t>& a) {
+                return a.load(std::memory_order_relaxed);
+            };
+            runner_metrics m;
+            m.workers = load(counters_.workers);
+            m.runs_started = load(counters_.runs_started);
+            m.runs_completed = load(counters_.runs_completed);
+            m.tasks_enqueued = load(counters_.tasks_enqueued);
+            m.tasks_executed = load(counters_.tasks_executed);
+            m.tasks_skipped = load(counters_.tasks_skipped);
+            m.tasks_bypassed = load(counters_.tasks_bypassed);
+            m.tasks_reused = load(counters_.tasks_reused);
+            m.tasks_pruned = load(counters_.tasks_pruned);
+            m.tasks_spawned = load(counters_.tasks_spawned);
+            m.tasks_fused = load(counters_.tasks_fused);
+            m.tasks_inlined = load(counters_.tasks_inlined);
+            m.nodes_inlined = load(counters_.nodes_inlined);
+            m.queue_high_water = load(counters_.queue_high_water);
+            m.busy_time = duration(load(counters_.busy_time));
+            m.idle_time = duration(load(counters_.idle_time));
+            m.queue_blocked_time = duration(load(counters_.queue_blocked_time));
+            return m;
         }
 
     private:
         using graph_node_type = callgraph::detail::graph_node;
         using graph_worker_type = callgraph::detail::graph_worker;
+        using clock_type = std::chrono::steady_clock;
         friend graph_node_type;
         friend graph_worker_type;
 
-        void enqueue_node(const graph_node_type* node) {
+        enum class entry_kind {
+            node,
+            // Helpers claim chunks of a parallel node already running.
+            helper,
+            // A task spawned by the node, run in its place.
+            spawned,
+            // A suspended coroutine node, ready to continue.
+            resumed
+        };
+
+        struct queue_entry {
+            const graph_node_type* node;
+            clock_type::time_point enqueued;
+            entry_kind kind;
+            detail::spawn_task* task;
+        };
+
+        struct node_state {
+            latency_histogram execution;
+            latency_histogram queue_wait;
+            // Parents which have not yet finished in the current run.
+            std::atomic<size_t> pending{0};
+            std::vector<const graph_node_type*> parents;
+            // Consumers which have not yet read the result in the current run.
+            std::atomic<size_t> readers{0};
+            // The nodes whose results this node reads, and which read
+            // this node's result.
+            std::vector<const graph_node_type*> sources;
+            std::vector<const graph_node_type*> consumers;
+            // Incremental execution state. A node is recomputed if it is
+            // dirty, or stale because something it depends on changed in
+            // the current run.
+            bool dirty = false;
+            std::atomic<std::uint64_t> stale_run{0};
+            // The last run whose walk of the graph reached this node.
+            std::uint64_t visited_run = 0;
+            // The last run in which a branch pruned this node, and the
+            // next node to prune after it, owned by the pruning thread.
+            std::atomic<std::uint64_t> pruned_run{0};
+            const graph_node_type* next_pruned = nullptr;
+            // Progress through the range of a parallel node.
+            size_t range = 0;
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> completed{0};
+            // The next link of a fused chain, if the link still holds.
+            const graph_node_type* fused = nullptr;
+            // Execution time measured while classifying nodes, and
+            // whether the node proved cheap enough to run inline.
+            std::atomic<std::uint64_t> measured{0};
+            std::atomic<std::uint64_t> samples{0};
+            bool inlined = false;
+            // When a parallel or coroutine node started, as it may
+            // finish on another worker.
+            clock_type::time_point started;
+        };
+
+        struct runner_counters {
+            std::atomic<std::uint64_t> workers{0};
+            std::atomic<std::uint64_t> runs_started{0};
+            std::atomic<std::uint64_t> runs_completed{0};
+            std::atomic<std::uint64_t> tasks_enqueued{0};
+            std::atomic<std::uint64_t> tasks_executed{0};
+            std::atomic<std::uint64_t> tasks_skipped{0};
+            std::atomic<std::uint64_t> tasks_bypassed{0};
+            std::atomic<std::uint64_t> tasks_reused{0};
+            std::atomic<std::uint64_t> tasks_pruned{0};
+            std::atomic<std::uint64_t> tasks_spawned{0};
+            std::atomic<std::uint64_t> tasks_fused{0};
+            std::atomic<std::uint64_t> tasks_inlined{0};
+            std::atomic<std::uint64_t> nodes_inlined{0};
+            std::atomic<std::uint64_t> queue_high_water{0};
+            // Timers, in nanoseconds.
+            std::atomic<std::uint64_t> busy_time{0};
+            std::atomic<std::uint64_t> idle_time{0};
+            std::atomic<std::uint64_t> queue_blocked_time{0};
+
+            static void add(std::atomic<std::uint64_t>& counter,
+                            clock_type::duration d) {
+                counter.fetch_add(static_cast<std::uint64_t>(
+                                      std::chrono::duration_cast<
+                                      std::chrono::nanoseconds>(d).count()),
+                                  std::memory_order_relaxed);
+            }
+        };
+
+        template <typename T>
+        const graph_node_type* find_target(T&& t) {
+            auto node = graph_->get_node(std::forward<T>(t));
+            if (node == graph_->nodes_.end()) {
+                throw node_not_found();
+            }
+            return &node->second;
+        }
+
+        // Build each node's view of its neighbours from the graph, and
+        // add states for nodes added since the last build. Node ids are
+        // never reused, so existing states keep their statistics. The
+        // caller must ensure no run is in progress.
+        void build() {
+            while (states_.size() < graph_->next_id_) {
+                states_.emplace_back();
+            }
+            dirty_.reserve(graph_->next_id_);
+            stack_.reserve(graph_->next_id_);
+            selected_.reserve(graph_->next_id_);
+            for (node_state& state : states_) {
+                state.parents.clear();
+                state.sources.clear();
+                state.consumers.clear();
+                state.fused = nullptr;
+            }
+            for (auto& pair : graph_->nodes_) {
+                const graph_node_type& node(pair.second);
+                for (const graph_node_type* child : node.children_) {
+                    states_[child->id()].parents.push_back(&node);
+                }
+                std::vector<const graph_node_type*>& sources(
+                    states_[node.id()].sources);
+                for (const auto& input : node.inputs_) {
+                    if (input.to >= 0 &&
+                        std::find(sources.begin(), sources.end(),
+                                  input.source) == sources.end()) {
+                        sources.push_back(input.source);
+                        states_[input.source->id()].consumers.push_back(&node);
+                    }
+                }
+            }
+            for (auto& pair : graph_->nodes_) {
+                const graph_node_type& node(pair.second);
+                const graph_node_type* next(node.fused_);
+                if (next && node.children_.size() == 1 &&
+                    *node.children_.begin() == next &&
+                    states_[next->id()].parents.size() == 1 &&
+                    node.fusible(next)) {
+                    states_[node.id()].fused = next;
+                }
+            }
+            // Results kept for incremental execution may no longer match
+            // the graph.
+            all_dirty_ = true;
+            revision_ = graph_->revision_;
+        }
+
+        // Rebuild if the graph has changed since the last build.
+        void refresh() {
+            if (revision_ != graph_->revision_) {
+                build();
+            }
+        }
+
+        std::future<void> start(cancellation_token token,
+                                clock_type::time_point deadline,
+                                bool incremental,
+                                const graph_node_type* const* targets = nullptr,
+                                size_t target_count = 0) {
+            std::unique_lock<std::mutex> lk(done_mutex_);
+            refresh();
+            error_ = nullptr;
+            failed_.store(false, std::memory_order_relaxed);
+            token_ = std::move(token);
+            run_token_.reset();
+            run_token_.link(token_);
+            run_token_.expire_at(deadline);
+            start_workers();
+
+            done_ = std::promise<void>(std::allocator_arg, done_allocator());
+            counters_.runs_started.fetch_add(1, std::memory_order_relaxed);
+            run_++;
+            started_ = clock_type::now();
+            if (inline_runs_ > 0 && runs_measured_++ == inline_runs_) {
+                classify();
+            }
+            {
+                std::unique_lock<std::mutex> qlk(queue_mutex_);
+                deadline_ = deadline;
+                // Plain executions use the runner's own token, which
+                // nothing else can cancel.
+                polling_ = token_.cancelled_ != own_token_.cancelled_;
+                incremental_ = incremental;
+                targeted_ = targets != nullptr;
+                measuring_ = inline_runs_ > 0;
+            }
+
+            if (targets) {
+                select_ancestors(targets, target_count);
+                // Nodes outside the selection keep stale results.
+                all_dirty_ = true;
+                outstanding_.store(1, std::memory_order_relaxed);
+                enqueue_node(graph_->root_node_);
+                return done_.get_future();
+            }
+
+            if (incremental && !all_dirty_) {
+                size_t roots(schedule_dirty());
+                outstanding_.store(roots, std::memory_order_relaxed);
+                if (roots == 0) {
+                    finish_run_locked();
+                }
+                for (const graph_node_type* node : dirty_) {
+                    if (states_[node->id()].pending.load(
+                            std::memory_order_relaxed) == 0) {
+                        enqueue_node(node);
+                    }
+                }
+                dirty_.clear();
+                return done_.get_future();
+            }
+
+            for (auto& pair : graph_->nodes_) {
+                pair.second.reset();
+                node_state& state(states_[pair.second.id()]);
+                state.pending.store(state.parents.size(), std::memory_order_relaxed);
+                state.readers.store(state.consumers.size(), std::memory_order_relaxed);
+                state.dirty = incremental;
+            }
+            dirty_.clear();
+            // Plain executions release results as they go.
+            all_dirty_ = !incremental;
+            outstanding_.store(1, std::memory_order_relaxed);
+            enqueue_node(graph_->root_node_);
+            return done_.get_future();
+        }
+
+        void mark_node_dirty(const graph_node_type* node) {
+            node_state& state(states_[node->id()]);
+            if (!state.dirty) {
+                state.dirty = true;
+                dirty_.push_back(node);
+            }
+        }
+
+        // Select the targets and everything they depend on, and prepare
+        // only those nodes to run. A selected node's parents are all
+        // selected, so each waits for all of its parents as usual.
+        void select_ancestors(const graph_node_type* const* targets, size_t count) {
+            stack_.clear();
+            selected_.clear();
+            for (size_t i = 0; i < count; i++) {
+                node_state& state(states_[targets[i]->id()]);
+                if (state.visited_run != run_) {
+                    state.visited_run = run_;
+                    stack_.push_back(targets[i]);
+                }
+            }
+            while (!stack_.empty()) {
+                const graph_node_type* node(stack_.back());
+                stack_.pop_back();
+                selected_.push_back(node);
+                for (const graph_node_type* parent : states_[node->id()].parents) {
+                    node_state& state(states_[parent->id()]);
+                    if (state.visited_run != run_) {
+                        state.visited_run = run_;
+                        stack_.push_back(parent);
+                    }
+                }
+            }
+            for (const graph_node_type* node : selected_) {
+                node->release_result();
+                node_state& state(states_[node->id()]);
+                state.pending.store(state.parents.size(), std::memory_order_relaxed);
+                state.readers.store(0, std::memory_order_relaxed);
+                state.dirty = false;
+            }
+            // Only selected consumers read a result in this run.
+            for (const graph_node_type* node : selected_) {
+                for (const graph_node_type* source : states_[node->id()].sources) {
+                    states_[source->id()].readers.fetch_add(
+                        1, std::memory_order_relaxed);
+                }
+            }
+            dirty_.clear();
+        }
+
+        // Find the nodes downstream of the dirty nodes, and count the
+        // parents each must wait for. Returns the number of dirty nodes
+        // with nothing to wait for.
+        size_t schedule_dirty() {
+            stack_.clear();
+            for (const graph_node_type* node : dirty_) {
+                node_state& state(states_[node->id()]);
+                if (state.visited_run != run_) {
+                    state.visited_run = run_;
+                    state.pending.store(0, std::memory_order_relaxed);
+                    stack_.push_back(node);
+                }
+            }
+            while (!stack_.empty()) {
+                const graph_node_type* node(stack_.back());
+                stack_.pop_back();
+                for (const graph_node_type* child : node->children_) {
+                    node_state& state(states_[child->id()]);
+                    if (state.visited_run != run_) {
+                        state.visited_run = run_;
+                        state.pending.store(0, std::memory_order_relaxed);
+                        stack_.push_back(child);
+                    }
+                    state.pending.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            size_t roots(0);
+            for (const graph_node_type* node : dirty_) {
+                if (states_[node->id()].pending.load(std::memory_order_relaxed) == 0) {
+                    roots++;
+                }
+            }
+            return roots;
+        }
+
+        // Whether an incremental execution must recompute `node`.
+        bool must_update(const graph_node_type* node) const {
+            const node_state& state(states_[node->id()]);
+            return state.dirty ||
+                state.stale_run.load(std::memory_order_relaxed) == run_;
+        }
+
+        // Called once an incremental execution has recomputed `node`.
+        void updated(const graph_node_type* node, bool changed) {
+            node_state& state(states_[node->id()]);
+            state.dirty = false;
+            if (changed) {
+                for (const graph_node_type* child : node->children_) {
+                    states_[child->id()].stale_run.store(
+                        run_, std::memory_order_relaxed);
+                }
+                for (const graph_node_type* consumer : state.consumers) {
+                    states_[consumer->id()].stale_run.store(
+                        run_, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Called once an incremental execution has bypassed the optional
+        // `node`, so that it is retried by the next.
+        void bypassed(const graph_node_type* node) {
+            updated(node, true);
+            std::unique_lock<std::mutex> lk(done_mutex_);
+            mark_node_dirty(node);
+        }
+
+        // Called by `parent` as it finishes, before releasing the reduce
+        // node `node`, so that the reduction can combine its result.
+        // Incremental and unselected reductions combine when they run.
+        void arrive(const graph_node_type* parent, const graph_node_type* node) {
+            if (incremental_ ||
+                (targeted_ && states_[node->id()].visited_run != run_)) {
+                return;
+            }
+            node->arrive(parent);
+        }
+
+        // Called once by each parent of `node` as it finishes; the last
+        // parent to finish queues the node. A parent whose edge to `node`
+        // is inactive prunes it instead.
+        void release_node(const graph_node_type* node, bool active = true) {
+            if (ready_node(node, active)) {
+                schedule_node(node);
+            }
+        }
+
+        // Release `node` as for release_node, and report whether it is
+        // now ready to run, leaving it to the caller to run or queue.
+        bool ready_node(const graph_node_type* node, bool active) {
+            node_state& state(states_[node->id()]);
+            if (targeted_ && state.visited_run != run_) {
+                return false;
+            }
+            if (!active) {
+                state.pruned_run.store(run_, std::memory_order_relaxed);
+            }
+            if (state.pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                return false;
+            }
+            if (state.pruned_run.load(std::memory_order_relaxed) == run_) {
+                prune(node);
+                return false;
+            }
+            return true;
+        }
+
+        // The number of node states, indexed by node id.
+        size_t node_count() const {
+            return states_.size();
+        }
+
+        void schedule_node(const graph_node_type* node) {
+            outstanding_.fetch_add(1, std::memory_order_relaxed);
+            enqueue_node(node);
+        }
+
+        // Record how long `node` took to execute.
+        void executed(const graph_node_type* node, clock_type::duration d) {
+            node_state& state(states_[node->id()]);
+            state.execution.record(d);
+            if (measuring_) {
+                state.measured.fetch_add(
+                    static_cast<std::uint64_t>(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()),
+                    std::memory_order_relaxed);
+                state.samples.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        // Decide which nodes run inline, from the times measured. The
+        // caller must hold the done lock, with no run in progress.
+        void classify() {
+            inline_runs_ = 0;
+            std::uint64_t inlined(0);
+            for (auto& pair : graph_->nodes_) {
+                const graph_node_type& node(pair.second);
+                node_state& state(states_[node.id()]);
+                std::uint64_t samples(state.samples.load(std::memory_order_relaxed));
+                state.inlined = samples > 0 && node.simple() &&
+                    &node != graph_->root_node_ &&
+                    state.measured.load(std::memory_order_relaxed) / samples <
+                    static_cast<std::uint64_t>(inline_threshold_.count());
+                if (state.inlined) {
+                    inlined++;
+                }
+            }
+            counters_.nodes_inlined.store(inlined, std::memory_order_relaxed);
+        }
+
+        // Pass over `node` and everything downstream of it which is
+        // released by pruned nodes, without queueing or invoking them.
+        // Each is visited once, by whichever thread released it last.
+        void prune(const graph_node_type* node) {
+            states_[node->id()].next_pruned = nullptr;
+            const graph_node_type* head(node);
+            while (head) {
+                const graph_node_type* pruned(head);
+                head = states_[pruned->id()].next_pruned;
+                counters_.tasks_pruned.fetch_add(1, std::memory_order_relaxed);
+                if (!incremental_) {
+                    release_inputs(pruned);
+                }
+                for (const graph_node_type* child : pruned->children_) {
+                    node_state& state(states_[child->id()]);
+                    if (targeted_ && state.visited_run != run_) {
+                        continue;
+                    }
+                    state.pruned_run.store(run_, std::memory_order_relaxed);
+                    if (state.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        state.next_pruned = head;
+                        head = child;
+                    }
+                }
+            }
+            if (incremental_) {
+                // Pruned nodes keep results which may now be stale.
+                std::unique_lock<std::mutex> lk(done_mutex_);
+                all_dirty_ = true;
+            }
+        }
+
+        // Called once a node has finished with its inputs. Results are
+        // destroyed when their last consumer is done, unless they are
+        // outputs of the graph.
+        void release_inputs(const graph_node_type* node) {
+            const node_state& state(states_[node->id()]);
+            for (const graph_node_type* source : state.sources) {
+                if (states_[source->id()].readers.fetch_sub(
+                        1, std::memory_order_acq_rel) == 1 &&
+                    !source->output()) {
+                    source->release_result();
+                }
+            }
+            // No consumer has run yet, so this counts the consumers
+            // taking part in the run.
+            // Branches keep their result so that it selects their cases.
+            if (state.readers.load(std::memory_order_relaxed) == 0 &&
+                !node->output() && !node->branch()) {
+                node->release_result();
+            }
+        }
+
+        // Start the range of a parallel node, and queue helpers so that
+        // idle workers can claim chunks of it.
+        void start_range(const graph_node_type* node, size_t range,
+                         clock_type::time_point start) {
+            node_state& state(states_[node->id()]);
+            state.range = range;
+            state.next.store(0, std::memory_order_relaxed);
+            state.completed.store(0, std::memory_order_relaxed);
+            state.started = start;
+            size_t grain(node->parallel_grain());
+            size_t chunks((range + grain - 1) / grain);
+            size_t helpers(std::min(max_workers_, chunks));
+            helpers = helpers > 0 ? helpers - 1 : 0;
+            outstanding_.fetch_add(helpers, std::memory_order_relaxed);
+            for (size_t i = 0; i < helpers; i++) {
+                enqueue_node(node, entry_kind::helper);
+            }
+        }
+
+        // Claim the next chunk of a parallel node's range. Chunks shrink
+        // as the range runs out, so that workers finish together.
+        bool claim_chunk(const graph_node_type* node, size_t& first, size_t& last) {
+            node_state& state(states_[node->id()]);
+            size_t claimed(state.next.load(std::memory_order_relaxed));
+            size_t remaining(claimed < state.range ? state.range - claimed : 0);
+            size_t chunk(std::max(node->parallel_grain(),
+                                  remaining / (2 * max_workers_)));
+            first = state.next.fetch_add(chunk, std::memory_order_relaxed);
+            if (first >= state.range) {
+                return false;
+            }
+            last = std::min(state.range, first + chunk);
+            return true;
+        }
+
+        // Record a finished chunk, and report whether it was the last.
+        bool complete_chunk(const graph_node_type* node, size_t count) {
+            node_state& state(states_[node->id()]);
+            return state.completed.fetch_add(count, std::memory_order_acq_rel) +
+                count == state.range;
+        }
+
+        // Queue a task spawned by `node`, as part of the current run.
+        static void schedule_spawned(void* runner, const void* node,
+                                     detail::spawn_task* task) {
+            graph_runner& r(*static_cast<graph_runner*>(runner));
+            r.counters_.tasks_spawned.fetch_add(1, std::memory_order_relaxed);
+            r.outstanding_.fetch_add(1, std::memory_order_relaxed);
+            r.enqueue_node(static_cast<const graph_node_type*>(node),
+                           entry_kind::spawned, task);
+        }
+
+        // Start an asynchronous node, which holds the run open until it
+        // finishes.
+        void start_async(const graph_node_type* node,
+                             clock_type::time_point start) {
+            states_[node->id()].started = start;
+            outstanding_.fetch_add(1, std::memory_order_relaxed);
+            node->async_start(detail::async_target{
+                    &graph_runner::schedule_resume,
+                    &graph_runner::async_finished,
+                    &graph_runner::io_reactor_of,
+                    &graph_runner::event_reactor_of,
+                    this, node});
+            if (failed()) {
+                // The run stopped while the node was starting, perhaps
+                // after the waits were detached.
+                detail::event_request* waits(nullptr);
+                {
+                    std::unique_lock<std::mutex> lk(done_mutex_);
+                    waits = detach_waits();
+                }
+                detail::event_reactor::cancel(waits);
+            }
+        }
+
+        // The runner's I/O reactor, started by the first node to use it.
+        static detail::io_reactor* io_reactor_of(void* runner) {
+            graph_runner& r(*static_cast<graph_runner*>(runner));
+            std::call_once(r.io_started_, [&r] {
+                    r.io_.reset(new detail::io_reactor());
+                });
+            return r.io_.get();
+        }
+
+        // The runner's event reactor, started by the first event source.
+        // Created under the done lock, so that a failing run can reach it.
+        static detail::event_reactor* event_reactor_of(void* runner) {
+            graph_runner& r(*static_cast<graph_runner*>(runner));
+            std::unique_lock<std::mutex> lk(r.done_mutex_);
+            if (!r.events_) {
+                r.events_.reset(new detail::event_reactor());
+            }
+            return r.events_.get();
+        }
+
+        // Stop the event waits of the current run, which has stopped, so
+        // that the run can finish. The caller must hold the done lock, and
+        // pass the result to detail::event_reactor::cancel once it has
+        // released it.
+        detail::event_request* detach_waits() {
+            return events_ ? events_->detach() : nullptr;
+        }
+
+        // Queue a suspended coroutine node to continue on a worker.
+        static void schedule_resume(void* runner, const void* node) {
+            graph_runner& r(*static_cast<graph_runner*>(runner));
+            r.outstanding_.fetch_add(1, std::memory_order_relaxed);
+            r.enqueue_node(static_cast<const graph_node_type*>(node),
+                           entry_kind::resumed);
+        }
+
+        // Called as an asynchronous node finishes, on whichever thread
+        // completed it. A coroutine may be destroyed before this returns.
+        static void async_finished(void* runner, const void* node) {
+            static_cast<graph_runner*>(runner)->finish_async(
+                static_cast<const graph_node_type*>(node));
+        }
+
+        void finish_async(const graph_node_type* node) {
+            try {
+                std::exception_ptr error(node->async_error());
+                if (error) {
+                    node->fail(error);
+                    fail(std::move(error));
+                }
+                auto finish(clock_type::now());
+                executed(node, finish - states_[node->id()].started);
+                counters_.tasks_executed.fetch_add(1, std::memory_order_relaxed);
+                if (!stopped(finish)) {
+                    release_inputs(node);
+                    node->release(*this);
+                }
+            }
+            catch(...) {
+                fail(std::current_exception());
+            }
+            finish_node();
+        }
+
+        // Claim `node`, the next link of a fused chain, for the worker
+        // which ran its only parent, and report whether it should run.
+        bool claim_fused(const graph_node_type* node) {
+            node_state& state(states_[node->id()]);
+            if (targeted_ && state.visited_run != run_) {
+                return false;
+            }
+            if (state.pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                return false;
+            }
+            counters_.tasks_fused.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // Called once for every node taken from the queue, whether or
+        // not it was invoked.
+        void finish_node() {
+            if (outstanding_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                finish_run();
+            }
+        }
+
+        // Stop the current run with `error`. The first error wins.
+        void fail(std::exception_ptr error) {
+            detail::event_request* waits(nullptr);
+            {
+                std::unique_lock<std::mutex> lk(done_mutex_);
+                fail_locked(std::move(error));
+                waits = detach_waits();
+            }
+            detail::event_reactor::cancel(waits);
+        }
+
+        bool failed() const {
+            return failed_.load(std::memory_order_acquire);
+        }
+
+        // Stop the current run if its token has been cancelled or its
+        // deadline has passed, and report whether the run has stopped.
+        // The caller must hold a node of the run.
+        bool stopped(clock_type::time_point now) {
+            if (failed()) {
+                return true;
+            }
+            if (now >= deadline_) {
+                run_token_.cancel();
+                fail(std::make_exception_ptr(deadline_exceeded()));
+            }
+            else if (token_.cancelled()) {
+                fail(std::make_exception_ptr(cancelled_error()));
+            }
+            return failed();
+        }
+
+        // Whether a worker with nothing to do should wake to check for
+        // the deadline, or for the caller's token being cancelled. The
+        // caller must hold the queue lock.
+        bool awaiting_stop() const {
+            return (deadline_ != clock_type::time_point::max() || polling_) &&
+                !failed() &&
+                outstanding_.load(std::memory_order_acquire) > 0;
+        }
+
+        // When an idle worker should next check the run. The caller must
+        // hold the queue lock.
+        clock_type::time_point check_time() const {
+            return polling_ ?
+                std::min(deadline_, clock_type::now() + std::chrono::milliseconds(10)) :
+                deadline_;
+        }
+
+        // Stop run number `run` if it is still going past its deadline, or
+        // its token has been cancelled. Called by idle workers, which hold
+        // no node of the run, so that runs waiting only on asynchronous
+        // nodes stop too.
+        void expire(std::uint64_t run) {
+            detail::event_request* waits(nullptr);
+            {
+                std::unique_lock<std::mutex> lk(done_mutex_);
+                if (counters_.runs_started.load(std::memory_order_relaxed) != run ||
+                    failed() ||
+                    outstanding_.load(std::memory_order_acquire) == 0) {
+                    return;
+                }
+                if (clock_type::now() >= deadline_) {
+                    fail_locked(std::make_exception_ptr(deadline_exceeded()));
+                }
+                else if (token_.cancelled()) {
+                    fail_locked(std::make_exception_ptr(cancelled_error()));
+                }
+                else {
+                    return;
+                }
+                run_token_.cancel();
+                waits = detach_waits();
+            }
+            detail::event_reactor::cancel(waits);
+        }
+
+        void finish_run() {
+            std::unique_lock<std::mutex> lk(done_mutex_);
+            finish_run_locked();
+        }
+
+        // The caller must hold the done lock.
+        void fail_locked(std::exception_ptr error) {
+            if (!error_) {
+                error_ = std::move(error);
+            }
+            failed_.store(true, std::memory_order_release);
+
+            // Discard every queued node. Suspended coroutines still
+            // continue, so that they can finish.
+            size_t dropped(0);
             {
                 std::unique_lock<std::mutex> lk(queue_mutex_);
-                queue_.push(node);
+                dropped = queue_.remove_if([](const queue_entry& entry) {
+                        return entry.kind != entry_kind::resumed;
+                    });
+            }
+            counters_.tasks_skipped.fetch_add(dropped, std::memory_order_relaxed);
+            if (dropped > 0 &&
+                outstanding_.fetch_sub(dropped, std::memory_order_acq_rel) == dropped) {
+                finish_run_locked();
+            }
+        }
+
+        // The caller must hold the done lock.
+        void finish_run_locked() {
+            run_latency_.record(clock_type::now() - started_);
+            try {
+                if (error_) {
+                    // Results may be half updated.
+                    all_dirty_ = true;
+                    done_.set_exception(error_);
+                }
+                else {
+                    counters_.runs_completed.fetch_add(
+                        1, std::memory_order_relaxed);
+                    done_.set_value();
+                }
+            }
+            catch(...) {}
+        }
+
+        void enqueue_node(const graph_node_type* node,
+                          entry_kind kind = entry_kind::node,
+                          detail::spawn_task* task = nullptr) {
+            counters_.tasks_enqueued.fetch_add(1, std::memory_order_relaxed);
+            {
+                std::unique_lock<std::mutex> lk(queue_mutex_);
+                queue_.push(queue_entry{node, clock_type::now(), kind, task});
+                if (queue_.size() > counters_.queue_high_water.load(
+                        std::memory_order_relaxed)) {
+                    counters_.queue_high_water.store(
+                        queue_.size(), std::memory_order_relaxed);
+                }
             }
             queue_avail_.notify_one();
         }
 
-        void clear_queue() {
-            std::unique_lock<std::mutex> lk(queue_mutex_);
-            queue_ = std::queue<const graph_node_type*>();
+        void start_workers() {
+            workers_.reserve(max_workers_);
+            while (workers_.size() < max_workers_) {
+                workers_.emplace_back(std::make_shared<graph_worker_type>(*this));
+            }
+            counters_.workers.store(workers_.size(), std::memory_order_relaxed);
+        }
+
+        detail::recycling_allocator<char> done_allocator() const {
+            return detail::recycling_allocator<char>(pool_);
         }
 
         graph* graph_;
         bool on_;
+        size_t max_workers_;
+
+        // Nodes queued or executing in the current run.
+        std::atomic<size_t> outstanding_;
+        std::atomic<bool> failed_;
+        std::exception_ptr error_;
+        cancellation_token token_;
+        cancellation_token own_token_;
+        // The token of the current run, linked to token_, which expires
+        // at the deadline.
+        cancellation_token run_token_;
+        // Written under both the done and queue locks before a run's
+        // first node is queued.
+        clock_type::time_point deadline_;
+        bool incremental_;
+        bool targeted_;
+        bool measuring_ = false;
+        bool polling_ = false;
+
+        // Inlining state, guarded by the done lock: the runs left to
+        // measure before classifying nodes, and the runs measured so far.
+        size_t inline_runs_ = 0;
+        size_t runs_measured_ = 0;
+        std::chrono::nanoseconds inline_threshold_ = std::chrono::nanoseconds(0);
+
+        // Incremental execution state, guarded by the done lock.
+        bool all_dirty_;
+        std::uint64_t run_;
+        std::vector<const graph_node_type*> dirty_;
+        std::vector<const graph_node_type*> stack_;
+        std::vector<const graph_node_type*> selected_;
+
+        // State and counters must outlive the workers that record them.
+        clock_type::time_point started_;
+        latency_histogram run_latency_;
+        // Indexed by node id. A deque, so that states do not move as
+        // nodes are added to the graph.
+        std::deque<node_state> states_;
+        // The graph revision the states were built from.
+        size_t revision_;
+        runner_counters counters_;
+        std::shared_ptr<detail::recycling_pool> pool_;
 
         // Order is important here! Anything that might lock these
         // needs to be destructed (i.e. unlock mutex) before the
@@ -110,11 +1275,15 @@ namespace callgraph {
         std::mutex queue_mutex_;
 
         std::vector<std::shared_ptr<graph_worker_type>> workers_;
-        std::queue<const graph_node_type*> queue_;
+        detail::ring_queue<queue_entry> queue_;
         std::condition_variable queue_avail_;
         std::promise<void> done_;
-        size_t max_leaves_;
-        size_t leaves_;
+
+        // Complete file I/O and readiness waits for asynchronous nodes.
+        std::once_flag io_started_;
+        std::unique_ptr<detail::io_reactor> io_;
+        // Guarded by the done lock.
+        std::unique_ptr<detail::event_reactor> events_;
     };
 }
 #include <callgraph/detail/graph_worker.hpp>
@@ -0,0 +1,274 @@
+// callgraph/latency_histogram.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_LATENCY_HISTOGRAM_HPP
+#define CALLGRAPH_LATENCY_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace callgraph {
+
+    /// \brief An immutable copy of the contents of a latency_histogram.
+    ///
+    /// Snapshots are cheap to query and are unaffected by recording
+    /// that happens after they are taken.
+    class latency_snapshot {
+    public:
+        /// \brief The duration type used for all reported values.
+        using duration = std::chrono::nanoseconds;
+
+        /// \brief Construct an empty snapshot.
+        latency_snapshot()
+            : count_(0),
+              sum_(0),
+              min_(0),
+              max_(0)
+            {
+            }
+
+        /// \brief The number of recorded samples.
+        std::uint64_t count() const {
+            return count_;
+        }
+
+        /// \brief The smallest recorded sample, or zero if empty.
+        duration min() const {
+            return duration(min_);
+        }
+
+        /// \brief The largest recorded sample, or zero if empty.
+        duration max() const {
+            return duration(max_);
+        }
+
+        /// \brief The arithmetic mean of the recorded samples, or zero
+        /// if empty.
+        duration mean() const {
+            return duration(count_ > 0 ? sum_ / count_ : 0);
+        }
+
+        /// \brief The sum of all recorded samples.
+        duration total() const {
+            return duration(sum_);
+        }
+
+        /// \brief Get the value at or below which the fraction `q` of the
+        /// recorded samples fall.
+        ///
+        /// The result is accurate to the resolution of the histogram
+        /// buckets (about 6%), and is always clamped to the recorded
+        /// minimum and maximum.
+        /// \param q The quantile, in the range [0, 1].
+        duration percentile(double q) const {
+            if (count_ == 0) {
+                return duration(0);
+            }
+            q = std::min(std::max(q, 0.0), 1.0);
+            std::uint64_t rank(static_cast<std::uint64_t>(
+                                   q * static_cast<double>(count_) + 0.5));
+            rank = std::max<std::uint64_t>(rank, 1);
+
+            std::uint64_t seen(0);
+            for (size_t i = 0; i < counts_.size(); i++) {
+                seen += counts_[i];
+                if (seen >= rank) {
+                    std::uint64_t v(bucket_midpoint(i));
+                    return duration(std::min(std::max(v, min_), max_));
+                }
+            }
+            return duration(max_);
+        }
+
+        /// \brief Combine the samples of another snapshot into this one.
+        latency_snapshot& operator+=(const latency_snapshot& other) {
+            if (other.count_ == 0) {
+                return *this;
+            }
+            if (count_ == 0) {
+                return *this = other;
+            }
+            for (size_t i = 0; i < counts_.size(); i++) {
+                counts_[i] += other.counts_[i];
+            }
+            count_ += other.count_;
+            sum_ += other.sum_;
+            min_ = std::min(min_, other.min_);
+            max_ = std::max(max_, other.max_);
+            return *this;
+        }
+
+        /// \brief The median.
+        duration p50() const {
+            return percentile(0.5);
+        }
+
+        /// \brief The 99th percentile.
+        duration p99() const {
+            return percentile(0.99);
+        }
+
+        /// \brief The 99.9th percentile.
+        duration p999() const {
+            return percentile(0.999);
+        }
+
+    private:
+        friend class latency_histogram;
+
+        static std::uint64_t bucket_midpoint(size_t index);
+
+        std::vector<std::uint64_t> counts_;
+        std::uint64_t count_;
+        std::uint64_t sum_;
+        std::uint64_t min_;
+        std::uint64_t max_;
+    };
+
+    /// \brief A concurrent, fixed-size latency histogram.
+    ///
+    /// Samples are stored in log-linear buckets in the manner of an
+    /// HDR histogram: every power of two is divided into a fixed
+    /// number of linear sub-buckets, so the relative error of any
+    /// reported value is bounded regardless of its magnitude. Recording
+    /// is wait-free and uses only relaxed atomic operations, so it may
+    /// be called from any number of threads without coordination.
+    ///
+    /// Durations are recorded in nanoseconds. Samples longer than
+    /// about eighteen minutes are clamped into the highest bucket.
+    class latency_histogram {
+    public:
+        /// \brief The duration type used for all recorded values.
+        using duration = latency_snapshot::duration;
+
+        /// \brief Construct an empty histogram.
+        latency_histogram() {
+            reset();
+        }
+
+        latency_histogram(const latency_histogram&) = delete;
+        latency_histogram& operator=(const latency_histogram&) = delete;
+
+        /// \brief Record a single sample.
+        void record(duration d) {
+            std::uint64_t v(d.count() > 0 ?
+                            static_cast<std::uint64_t>(d.count()) : 0);
+            counts_[bucket_index(v)].fetch_add(1, std::memory_order_relaxed);
+            sum_.fetch_add(v, std::memory_order_relaxed);
+
+            std::uint64_t lo(min_.load(std::memory_order_relaxed));
+            while (v < lo &&
+                   !min_.compare_exchange_weak(lo, v, std::memory_order_relaxed)) {
+            }
+            std::uint64_t hi(max_.load(std::memory_order_relaxed));
+            while (v > hi &&
+                   !max_.compare_exchange_weak(hi, v, std::memory_order_relaxed)) {
+            }
+        }
+
+        /// \brief Take a copy of the current contents of the histogram.
+        ///
+        /// The snapshot is not atomic with respect to concurrent
+        /// recording, but every sample is either wholly included
+        /// or excluded from the bucket counts.
+        latency_snapshot snapshot() const {
+            latency_snapshot s;
+            s.counts_.resize(bucket_count);
+            std::uint64_t total(0);
+            for (size_t i = 0; i < bucket_count; i++) {
+                s.counts_[i] = counts_[i].load(std::memory_order_relaxed);
+                total += s.counts_[i];
+            }
+            s.count_ = total;
+            s.sum_ = sum_.load(std::memory_order_relaxed);
+            if (total > 0) {
+                s.min_ = min_.load(std::memory_order_relaxed);
+                s.max_ = max_.load(std::memory_order_relaxed);
+            }
+            return s;
+        }
+
+        /// \brief Discard all recorded samples.
+        ///
+        /// \warning Samples recorded concurrently with a reset may be
+        /// partially retained.
+        void reset() {
+            for (auto& c : counts_) {
+                c.store(0, std::memory_order_relaxed);
+            }
+            sum_.store(0, std::memory_order_relaxed);
+            min_.store(std::numeric_limits<std::uint64_t>::max(),
+                       std::memory_order_relaxed);
+            max_.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        friend class latency_snapshot;
+
+        // Each power of two above `sub_count` is split into
+        // `half_count` linear buckets; values below `sub_count`
+        // are recorded exactly.
+        enum : size_t {
+            sub_bits = 4,
+            sub_count = size_t(1) << sub_bits,
+            half_count = sub_count / 2,
+            max_bits = 40,
+            bucket_count = sub_count + (max_bits - sub_bits) * half_count
+        };
+
+        static unsigned most_significant_bit(std::uint64_t v) {
+            unsigned msb(0);
+            while (v >>= 1) {
+                msb++;
+            }
+            return msb;
+        }
+
+        static size_t bucket_index(std::uint64_t v) {
+            if (v < sub_count) {
+                return static_cast<size_t>(v);
+            }
+            unsigned msb(most_significant_bit(v));
+            if (msb >= max_bits) {
+                return bucket_count - 1;
+            }
+            unsigned shift(msb - (sub_bits - 1));
+            size_t top(static_cast<size_t>(v >> shift));
+            return sub_count + (shift - 1) * half_count + (top - half_count);
+        }
+
+        static std::uint64_t bucket_lower_bound(size_t index) {
+            if (index < sub_count) {
+                return index;
+            }
+            size_t shift((index - sub_count) / half_count + 1);
+            size_t top((index - sub_count) % half_count + half_count);
+            return static_cast<std::uint64_t>(top) << shift;
+        }
+
+        static std::uint64_t bucket_width(size_t index) {
+            if (index < sub_count) {
+                return 1;
+            }
+            size_t shift((index - sub_count) / half_count + 1);
+            return std::uint64_t(1) << shift;
+        }
+
+        std::array<std::atomic<std::uint64_t>, bucket_count> counts_;
+        std::atomic<std::uint64_t> sum_;
+        std::atomic<std::uint64_t> min_;
+        std::atomic<std::uint64_t> max_;
+    };
+
+    inline std::uint64_t latency_snapshot::bucket_midpoint(size_t index) {
+        return latency_histogram::bucket_lower_bound(index) +
+            latency_histogram::bucket_width(index) / 2;
+    }
+}
+
+#endif // CALLGRAPH_LATENCY_HISTOGRAM_HPP
@@ -0,0 +1,74 @@
+// callgraph/latency_report.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_LATENCY_REPORT_HPP
+#define CALLGRAPH_LATENCY_REPORT_HPP
+
+#include <callgraph/latency_histogram.hpp>
+#include <callgraph/detail/node_key.hpp>
+
+#include <unordered_map>
+
+namespace callgraph {
+    class graph_runner;
+
+    /// \brief Latency distributions recorded for a single node.
+    struct node_latency {
+        /// \brief The time spent invoking the node's callable.
+        latency_snapshot execution;
+
+        /// \brief The time between the node being enqueued and
+        /// a worker picking it up.
+        latency_snapshot queue_wait;
+    };
+
+    /// \brief A snapshot of the latency distributions recorded by
+    /// a graph_runner across all of its executions.
+    ///
+    /// This type is returned from graph_runner::latencies.
+    class latency_report {
+    public:
+        /// \brief The distribution of whole-run durations, measured
+        /// from the call to graph_runner::execute until the last leaf
+        /// node finished.
+        const latency_snapshot& run() const {
+            return run_;
+        }
+
+        /// \brief The combined execution time distribution of every node.
+        const latency_snapshot& execution() const {
+            return execution_;
+        }
+
+        /// \brief The combined queue wait distribution of every node.
+        const latency_snapshot& queue_wait() const {
+            return queue_wait_;
+        }
+
+        /// \brief Get the latency distributions of a single node.
+        /// \tparam T A Callable type, or a node wrapper which wraps
+        /// such a type.
+        /// \param t The callable used to connect the node to the graph.
+        /// \throws std::out_of_range if `t` is not a node of the graph.
+        template <typename T>
+        const node_latency& node(T&& t) const {
+            return nodes_.at(detail::to_node_key<T>::apply(t));
+        }
+
+        /// \brief Get the latency distributions of every node, keyed
+        /// by node identity.
+        const std::unordered_map<detail::node_key, node_latency>& nodes() const {
+            return nodes_;
+        }
+
+    private:
+        friend class graph_runner;
+
+        latency_snapshot run_;
+        latency_snapshot execution_;
+        latency_snapshot queue_wait_;
+        std::unordered_map<detail::node_key, node_latency> nodes_;
+    };
+}
+
+#endif // CALLGRAPH_LATENCY_REPORT_HPP
@@ -0,0 +1,42 @@
+// callgraph/memo_statistics.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_MEMO_STATISTICS_HPP
+#define CALLGRAPH_MEMO_STATISTICS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace callgraph {
+
+    /// \brief A snapshot of the counters kept by a memoized node's cache.
+    ///
+    /// Counters start at zero when the node is memoized and are never
+    /// reset. This type is returned from graph::memo_stats.
+    struct memo_statistics {
+        /// \brief The number of calls answered from the cache.
+        std::uint64_t hits = 0;
+
+        /// \brief The number of calls which invoked the callable.
+        std::uint64_t misses = 0;
+
+        /// \brief The number of cached results evicted to make room.
+        std::uint64_t evictions = 0;
+
+        /// \brief The number of results currently cached.
+        std::size_t size = 0;
+
+        /// \brief The greatest number of results the cache can hold.
+        std::size_t capacity = 0;
+
+        /// \brief The fraction of calls answered from the cache, in the
+        /// range [0, 1].
+        double hit_rate() const {
+            auto total(hits + misses);
+            return total > 0 ?
+                static_cast<double>(hits) / static_cast<double>(total) : 0.0;
+        }
+    };
+}
+
+#endif // CALLGRAPH_MEMO_STATISTICS_HPP
@@ -0,0 +1,118 @@
+// callgraph/parallel_map.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_PARALLEL_MAP_HPP
+#define CALLGRAPH_PARALLEL_MAP_HPP
+
+#include <callgraph/detail/node_traits.hpp>
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace callgraph {
+#ifndef NO_DOC
+    namespace detail {
+        template <typename T>
+        struct unary_argument;
+
+        template <typename R, typename A>
+        struct unary_argument<R(A)> {
+            using type = typename std::decay<A>::type;
+        };
+    }
+#endif // NO_DOC
+
+/// \brief A node which applies a function to every element of a vector,
+/// in parallel across the workers of a graph_runner.
+///
+/// The node takes a `std::vector` of the function's argument type and
+/// returns a `std::vector` of its results, in the same order. When a
+/// graph_runner executes the node, the range is split into chunks which
+/// idle workers claim as they go: early chunks are large, and they shrink
+/// as the range runs out, down to `grain` elements, so that workers
+/// finish together. Other runners, and incremental executions, apply the
+/// function serially.
+///
+/// The function is called concurrently, so it must be safe to call from
+/// several threads at once. Its result must be default constructible.
+/// \tparam F A Callable type which takes one parameter.
+    template <typename F>
+    class parallel_map {
+    public:
+        /// \brief The type of each element of the input.
+        using argument_type = typename detail::unary_argument<
+            typename detail::node_traits<F>::signature>::type;
+
+        /// \brief The type of each element of the result.
+        using value_type =
+            typename std::decay<typename detail::node_traits<F>::result_type>::type;
+
+        static_assert(!std::is_same<value_type, bool>::value,
+                      "std::vector<bool> cannot be written concurrently.");
+
+        /// \brief Construct a parallel map of `f`, split into chunks of at
+        /// least `grain` elements.
+        explicit parallel_map(F f, size_t grain = 1)
+            : f_(std::move(f)),
+              grain_(grain > 0 ? grain : 1),
+              input_(nullptr)
+            {
+            }
+
+        /// \brief Apply the function to every element of `input`, serially.
+        std::vector<value_type> operator()(const std::vector<argument_type>& input) const {
+            std::vector<value_type> output;
+            output.reserve(input.size());
+            for (const argument_type& x : input) {
+                output.push_back(f_(x));
+            }
+            return output;
+        }
+
+        /// \brief The smallest number of elements processed as one chunk.
+        size_t grain() const {
+            return grain_;
+        }
+
+#ifndef NO_DOC
+        // The parallel protocol used by graph_runner: begin, then run each
+        // index exactly once across any number of threads, then end.
+        using parallel_category = void;
+
+        size_t begin(const std::vector<argument_type>& input) {
+            input_ = &input;
+            output_.clear();
+            output_.resize(input.size());
+            return input.size();
+        }
+
+        void run(size_t first, size_t last) const {
+            for (size_t i = first; i < last; i++) {
+                output_[i] = f_((*input_)[i]);
+            }
+        }
+
+        std::vector<value_type> end() {
+            input_ = nullptr;
+            return std::move(output_);
+        }
+#endif // NO_DOC
+
+    private:
+        F f_;
+        size_t grain_;
+        const std::vector<argument_type>* input_;
+        mutable std::vector<value_type> output_;
+    };
+
+/// \brief Make a parallel_map of `f`.
+/// \see parallel_map
+    template <typename F>
+    parallel_map<typename std::decay<F>::type> make_parallel_map(F&& f, size_t grain = 1) {
+        return parallel_map<typename std::decay<F>::type>(std::forward<F>(f), grain);
+    }
+}
+
+#endif // CALLGRAPH_PARALLEL_MAP_HPP
@@ -0,0 +1,209 @@
+// callgraph/reduce.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_REDUCE_HPP
+#define CALLGRAPH_REDUCE_HPP
+
+#include <callgraph/detail/node_value.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace callgraph {
+
+/// \brief A node which combines the results of any number of nodes
+/// pairwise, in a balanced tree.
+///
+/// Connect inputs with graph::connect_gather. Every input must return
+/// exactly `T`. When a graph_runner executes the graph, each pair is
+/// combined by the worker which finishes the second of its halves, so
+/// the reduction overlaps with the nodes producing the inputs, and the
+/// node itself has at most one combination left to do. Incremental
+/// executions, and other runners, combine the inputs when the node runs,
+/// in the same tree.
+///
+/// `op` is called as `op(left, right)` with inputs in the order they were
+/// connected, and must be associative. It may be called concurrently.
+/// With no inputs, the node returns `T()`.
+/// \tparam T The type of each input, and of the result.
+/// \tparam Op A Callable type taking two `const T&` and returning `T`.
+    template <typename T, typename Op>
+    class reduce {
+    public:
+        /// \brief The type of each input.
+        using value_type = T;
+
+        /// \brief Construct a reduction which combines inputs with `op`.
+        explicit reduce(Op op)
+            : op_(std::move(op))
+            {
+            }
+
+        reduce(const reduce& other)
+            : op_(other.op_),
+              inputs_(other.inputs_)
+            {
+            }
+
+        reduce& operator=(const reduce&) = delete;
+
+        /// \brief Combine every input.
+        T operator()() {
+            if (inputs_.empty()) {
+                return T();
+            }
+            if (tree_ && tree_->done.load(std::memory_order_acquire)) {
+                const T* root(tree_->value[1]);
+                bool combined(tree_->leaves > 1 && root == &tree_->storage[1].get());
+                T result(combined ? std::move(tree_->storage[1].get()) : *root);
+                reset_tree();
+                return result;
+            }
+            reset_tree();
+            return combine(0, inputs_.size());
+        }
+
+        /// \brief The number of inputs connected.
+        size_t size() const {
+            return inputs_.size();
+        }
+
+#ifndef NO_DOC
+        using gather_category = void;
+        using reduce_category = void;
+
+        void add_input(const detail::node_value<T>& input) {
+            inputs_.push_back(&input);
+            tree_.reset();
+        }
+
+        void rebind(const detail::node_value_base& from,
+                    const detail::node_value_base& to) {
+            for (const detail::node_value<T>*& input : inputs_) {
+                if (input == &from) {
+                    input = static_cast<const detail::node_value<T>*>(&to);
+                }
+            }
+        }
+
+        // Prepare for the inputs of the next run to arrive.
+        void reset_tree() {
+            if (inputs_.empty()) {
+                return;
+            }
+            if (!tree_) {
+                tree_.reset(new tree(inputs_.size()));
+            }
+            tree& t(*tree_);
+            for (size_t i = 1; i < t.leaves; i++) {
+                if (t.value[i] == &t.storage[i].get()) {
+                    t.storage[i].destroy();
+                }
+                t.value[i] = nullptr;
+                t.arrived[i].store(0, std::memory_order_relaxed);
+            }
+            t.done.store(false, std::memory_order_relaxed);
+            // Padding leaves arrive empty straight away.
+            for (size_t i = 0; i < t.leaves; i++) {
+                t.value[t.leaves + i] = nullptr;
+            }
+            for (size_t i = inputs_.size(); i < t.leaves; i++) {
+                climb(t.leaves + i);
+            }
+        }
+
+        // Called once input `leaf` is ready, by the thread which made it.
+        void arrive(size_t leaf) {
+            if (!tree_) {
+                return;
+            }
+            tree_->value[tree_->leaves + leaf] = &inputs_[leaf]->get();
+            climb(tree_->leaves + leaf);
+        }
+#endif // NO_DOC
+
+    private:
+        // A complete binary tree over the inputs, padded to a power of
+        // two. Node i combines nodes 2i and 2i+1; the second of the two
+        // to arrive does the combining. Null values are empty.
+        struct tree {
+            explicit tree(size_t inputs)
+                : leaves(1)
+                {
+                    while (leaves < inputs) {
+                        leaves *= 2;
+                    }
+                    value.reset(new const T*[2 * leaves]());
+                    storage.reset(new detail::node_value_slot<T>[leaves]);
+                    arrived.reset(new std::atomic<int>[leaves]);
+                    for (size_t i = 0; i < leaves; i++) {
+                        arrived[i].store(0, std::memory_order_relaxed);
+                    }
+                }
+
+            ~tree() {
+                for (size_t i = 1; i < leaves; i++) {
+                    if (value[i] == &storage[i].get()) {
+                        storage[i].destroy();
+                    }
+                }
+            }
+
+            size_t leaves;
+            std::unique_ptr<const T*[]> value;
+            std::unique_ptr<detail::node_value_slot<T>[]> storage;
+            std::unique_ptr<std::atomic<int>[]> arrived;
+            std::atomic<bool> done{false};
+        };
+
+        void climb(size_t i) {
+            tree& t(*tree_);
+            while (i > 1) {
+                size_t parent(i / 2);
+                if (t.arrived[parent].fetch_add(1, std::memory_order_acq_rel) == 0) {
+                    return;
+                }
+                const T* left(t.value[2 * parent]);
+                const T* right(t.value[2 * parent + 1]);
+                if (left && right) {
+                    t.storage[parent].construct(op_(*left, *right));
+                    t.value[parent] = &t.storage[parent].get();
+                }
+                else {
+                    t.value[parent] = left ? left : right;
+                }
+                i = parent;
+            }
+            t.done.store(true, std::memory_order_release);
+        }
+
+        // Combine inputs [first, last) in the same shape as the tree.
+        T combine(size_t first, size_t last) const {
+            if (last - first == 1) {
+                return inputs_[first]->get();
+            }
+            size_t width(1);
+            while (width * 2 < last - first) {
+                width *= 2;
+            }
+            return op_(combine(first, first + width), combine(first + width, last));
+        }
+
+        Op op_;
+        std::vector<const detail::node_value<T>*> inputs_;
+        std::unique_ptr<tree> tree_;
+    };
+
+/// \brief Make a reduce node which combines inputs of type `T` with `op`.
+/// \see reduce
+    template <typename T, typename Op>
+    reduce<T, typename std::decay<Op>::type> make_reduce(Op&& op) {
+        return reduce<T, typename std::decay<Op>::type>(std::forward<Op>(op));
+    }
+}
+
+#endif // CALLGRAPH_REDUCE_HPP
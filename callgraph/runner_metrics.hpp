@@ -0,0 +1,98 @@
+// callgraph/runner_metrics.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_RUNNER_METRICS_HPP
+#define CALLGRAPH_RUNNER_METRICS_HPP
+
+#include <chrono>
+#include <cstdint>
+
+namespace callgraph {
+
+    /// \brief A snapshot of the cumulative counters kept by a graph_runner.
+    ///
+    /// All counters start at zero when the runner is constructed and
+    /// are never reset, so rates can be derived by differencing two
+    /// snapshots. This type is returned from graph_runner::metrics.
+    struct runner_metrics {
+        /// \brief The duration type used for all timers.
+        using duration = std::chrono::nanoseconds;
+
+        /// \brief The number of worker threads owned by the runner.
+        std::uint64_t workers = 0;
+
+        /// \brief The number of executions started.
+        std::uint64_t runs_started = 0;
+
+        /// \brief The number of executions which finished successfully.
+        std::uint64_t runs_completed = 0;
+
+        /// \brief The number of nodes pushed onto the work queue. A node
+        /// is pushed once, when the last of its parents finishes.
+        std::uint64_t tasks_enqueued = 0;
+
+        /// \brief The number of nodes invoked.
+        std::uint64_t tasks_executed = 0;
+
+        /// \brief The number of queued nodes discarded without being
+        /// invoked because their run had failed.
+        std::uint64_t tasks_skipped = 0;
+
+        /// \brief The number of optional nodes whose fallback was delivered
+        /// because their budget was exhausted before they were started.
+        std::uint64_t tasks_bypassed = 0;
+
+        /// \brief The number of nodes scheduled by an incremental
+        /// execution which kept their previous result, because nothing
+        /// they depend on changed.
+        std::uint64_t tasks_reused = 0;
+
+        /// \brief The number of nodes which were not invoked because a
+        /// branch node did not select them, or anything they depend on.
+        std::uint64_t tasks_pruned = 0;
+
+        /// \brief The number of tasks spawned by running nodes and queued.
+        std::uint64_t tasks_spawned = 0;
+
+        /// \brief The number of nodes run directly after the node before
+        /// them in a fused chain, without being queued.
+        /// \see graph::fuse
+        std::uint64_t tasks_fused = 0;
+
+        /// \brief The number of nodes run by the worker which released
+        /// them, without being queued, because they were classified as
+        /// cheap.
+        /// \see graph_runner::set_inlining
+        std::uint64_t tasks_inlined = 0;
+
+        /// \brief The number of nodes currently classified as cheap
+        /// enough to run inline.
+        /// \see graph_runner::set_inlining
+        std::uint64_t nodes_inlined = 0;
+
+        /// \brief The largest number of entries observed in the work queue.
+        std::uint64_t queue_high_water = 0;
+
+        /// \brief Total time workers spent invoking nodes.
+        duration busy_time = duration(0);
+
+        /// \brief Total time workers spent fetching work, including
+        /// contention on the work queue. A wait is accounted when it ends.
+        duration idle_time = duration(0);
+
+        /// \brief The part of `idle_time` spent blocked waiting for the
+        /// work queue to become non-empty.
+        duration queue_blocked_time = duration(0);
+
+        /// \brief The fraction of accounted worker time spent invoking
+        /// nodes, in the range [0, 1].
+        double utilization() const {
+            auto total(busy_time + idle_time);
+            return total.count() > 0 ?
+                static_cast<double>(busy_time.count()) /
+                static_cast<double>(total.count()) : 0.0;
+        }
+    };
+}
+
+#endif // CALLGRAPH_RUNNER_METRICS_HPP
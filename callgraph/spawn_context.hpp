@@ -0,0 +1,184 @@
+// callgraph/spawn_context.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_SPAWN_CONTEXT_HPP
+#define CALLGRAPH_SPAWN_CONTEXT_HPP
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace callgraph {
+#ifndef NO_DOC
+    namespace detail {
+        // A task spawned by a node. Its dependencies are guarded by the
+        // lock of the context which spawned it.
+        struct spawn_task {
+            explicit spawn_task(std::function<void()> f)
+                : fn(std::move(f)),
+                  pending(0),
+                  done(false)
+                {
+                }
+
+            std::function<void()> fn;
+            // Prerequisites which have not yet finished.
+            size_t pending;
+            bool done;
+            std::vector<spawn_task*> successors;
+        };
+
+        // Queues a ready task on a runner, on behalf of a node.
+        using spawn_schedule_fn = void (*)(void* runner, const void* node, spawn_task*);
+    }
+#endif // NO_DOC
+
+/// \brief The context through which a node spawns tasks while it runs.
+///
+/// A node made with make_spawner receives its context as its first
+/// parameter. Each task spawned is queued on the runner executing the
+/// node, and the node does not count as finished, so its children are
+/// not released, until the node has returned and every task it spawned
+/// has finished. Tasks may spawn further tasks through the same context,
+/// and may be given prerequisites, forming a small dynamic graph. The
+/// spawning worker never waits for its tasks.
+///
+/// When a node is run other than by a plain execution of a graph_runner,
+/// each task is run as soon as it is ready, by the thread which made it
+/// so. A task which throws fails the run, as a node would.
+    class spawn_context {
+    public:
+        /// \brief A handle to a spawned task, valid until the node
+        /// next runs.
+        using task = detail::spawn_task*;
+
+        /// \brief Construct a context which runs tasks as they are spawned.
+        spawn_context()
+            : schedule_(nullptr),
+              runner_(nullptr),
+              node_(nullptr),
+              joins_(0)
+            {
+            }
+
+        spawn_context(const spawn_context&) = delete;
+        spawn_context& operator=(const spawn_context&) = delete;
+
+        /// \brief Spawn `f`, a Callable type taking no parameters.
+        /// \return A handle which later tasks may name as a prerequisite.
+        template <typename F>
+        task spawn(F&& f) {
+            return spawn(std::forward<F>(f), {});
+        }
+
+        /// \brief Spawn `f`, to run once every task in `after` has finished.
+        /// \return A handle which later tasks may name as a prerequisite.
+        template <typename F>
+        task spawn(F&& f, std::initializer_list<task> after) {
+            task t(nullptr);
+            bool ready(false);
+            joins_.fetch_add(1, std::memory_order_relaxed);
+            {
+                std::unique_lock<std::mutex> lk(mutex_);
+                tasks_.emplace_back(std::function<void()>(std::forward<F>(f)));
+                t = &tasks_.back();
+                for (task prerequisite : after) {
+                    if (!prerequisite->done) {
+                        prerequisite->successors.push_back(t);
+                        t->pending++;
+                    }
+                }
+                ready = t->pending == 0;
+            }
+            if (ready) {
+                dispatch(t);
+            }
+            return t;
+        }
+
+#ifndef NO_DOC
+        // Start a run of the node, queueing its tasks with `schedule`,
+        // or running them inline if it is null. The node itself holds
+        // one join.
+        void begin(detail::spawn_schedule_fn schedule, void* runner, const void* node) {
+            tasks_.clear();
+            schedule_ = schedule;
+            runner_ = runner;
+            node_ = node;
+            error_ = nullptr;
+            joins_.store(1, std::memory_order_relaxed);
+        }
+
+        // Run a task taken from the runner's queue.
+        void run(task t) {
+            t->fn();
+            complete(t);
+        }
+
+        // Release one join, and report whether it was the last, so that
+        // the node has finished.
+        bool join() {
+            return joins_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        }
+
+        // Record an error thrown by the node or one of its tasks. The
+        // first is kept, for the worker releasing the last join to store
+        // in the node's result.
+        void fail(std::exception_ptr error) {
+            std::unique_lock<std::mutex> lk(mutex_);
+            if (!error_) {
+                error_ = std::move(error);
+            }
+        }
+
+        // The first error recorded, once the last join is released.
+        const std::exception_ptr& error() const {
+            return error_;
+        }
+#endif // NO_DOC
+
+    private:
+        void dispatch(task t) {
+            if (schedule_) {
+                schedule_(runner_, node_, t);
+            }
+            else {
+                run(t);
+                joins_.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        // Mark `t` finished, and dispatch its successors which are ready.
+        void complete(task t) {
+            std::vector<task> successors;
+            {
+                std::unique_lock<std::mutex> lk(mutex_);
+                t->done = true;
+                for (task s : t->successors) {
+                    if (--s->pending == 0) {
+                        successors.push_back(s);
+                    }
+                }
+            }
+            for (task s : successors) {
+                dispatch(s);
+            }
+        }
+
+        detail::spawn_schedule_fn schedule_;
+        void* runner_;
+        const void* node_;
+        std::atomic<size_t> joins_;
+        std::exception_ptr error_;
+        std::mutex mutex_;
+        // A deque, so that handles stay valid as tasks are added.
+        std::deque<detail::spawn_task> tasks_;
+    };
+}
+
+#endif // CALLGRAPH_SPAWN_CONTEXT_HPP
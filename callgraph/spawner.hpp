@@ -0,0 +1,74 @@
+// callgraph/spawner.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_SPAWNER_HPP
+#define CALLGRAPH_SPAWNER_HPP
+
+#include <callgraph/spawn_context.hpp>
+#include <callgraph/detail/node_traits.hpp>
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace callgraph {
+
+/// \brief A node which may spawn tasks while it runs.
+///
+/// The wrapped function takes a spawn_context as its first parameter,
+/// followed by the node's parameters, which are connected as usual. The
+/// node finishes once the function has returned and every task it spawned
+/// has finished.
+/// \tparam F A Callable type whose first parameter is a `spawn_context&`.
+/// \see spawn_context
+    template <typename F, typename S = typename detail::node_traits<F>::signature>
+    class spawner;
+
+/// \brief A node which may spawn tasks while it runs.
+/// \see spawner
+    template <typename F, typename R, typename... Args>
+    class spawner<F, R(spawn_context&, Args...)> {
+    public:
+        /// \brief Construct a spawning node which invokes `f`.
+        explicit spawner(F f)
+            : f_(std::move(f)),
+              context_(new spawn_context())
+            {
+            }
+
+        /// \brief Copy the function, with a context of its own.
+        spawner(const spawner& other)
+            : f_(other.f_),
+              context_(new spawn_context())
+            {
+            }
+
+        spawner& operator=(const spawner&) = delete;
+
+        /// \brief Invoke the function with this node's context.
+        R operator()(Args... args) {
+            return f_(*context_, std::forward<Args>(args)...);
+        }
+
+#ifndef NO_DOC
+        using spawn_category = void;
+
+        spawn_context& context() {
+            return *context_;
+        }
+#endif // NO_DOC
+
+    private:
+        F f_;
+        std::unique_ptr<spawn_context> context_;
+    };
+
+/// \brief Make a spawner of `f`.
+/// \see spawner
+    template <typename F>
+    spawner<typename std::decay<F>::type> make_spawner(F&& f) {
+        return spawner<typename std::decay<F>::type>(std::forward<F>(f));
+    }
+}
+
+#endif // CALLGRAPH_SPAWNER_HPP
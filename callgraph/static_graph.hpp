@@ -0,0 +1,497 @@
+// callgraph/static_graph.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_STATIC_GRAPH_HPP
+#define CALLGRAPH_STATIC_GRAPH_HPP
+
+#include <callgraph/detail/node_call.hpp>
+#include <callgraph/detail/node_param_list.hpp>
+#include <callgraph/detail/node_traits.hpp>
+#include <callgraph/detail/node_value.hpp>
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace callgraph {
+
+/// \brief An edge of a static_graph, which passes the result of `From`
+/// to parameter `Param` of `To`.
+    template <typename From, typename To, size_t Param = 0>
+    struct edge {};
+
+/// \brief An edge of a static_graph, which runs `To` after `From`
+/// without passing it the result of `From`.
+    template <typename From, typename To>
+    struct after {};
+
+/// \brief The edges of a static_graph.
+    template <typename... Edges>
+    struct edges {};
+
+#ifndef NO_DOC
+    namespace detail {
+        template <typename... Ts>
+        struct type_list {};
+
+        template <typename T, typename... Ts>
+        struct is_one_of : std::false_type
+        {};
+
+        template <typename T, typename U, typename... Ts>
+        struct is_one_of<T, U, Ts...>
+            : std::conditional<std::is_same<T, U>::value,
+                               std::true_type, is_one_of<T, Ts...>>::type
+        {};
+
+        template <bool...>
+        struct bool_pack;
+
+        template <bool... B>
+        using all_true = std::is_same<bool_pack<true, B...>, bool_pack<B..., true>>;
+
+        template <typename List, typename T>
+        struct add_node;
+
+        template <typename... Ts, typename T>
+        struct add_node<type_list<Ts...>, T> {
+            using type = typename std::conditional<is_one_of<T, Ts...>::value,
+                                                   type_list<Ts...>,
+                                                   type_list<Ts..., T>>::type;
+        };
+
+        // The nodes named by an edge list, in order of first appearance.
+        template <typename List, typename... Edges>
+        struct collect_nodes {
+            using type = List;
+        };
+
+        template <typename List, typename F, typename T, size_t P, typename... Edges>
+        struct collect_nodes<List, edge<F, T, P>, Edges...>
+            : collect_nodes<typename add_node<typename add_node<List, F>::type,
+                                              T>::type, Edges...>
+        {};
+
+        template <typename List, typename F, typename T, typename... Edges>
+        struct collect_nodes<List, after<F, T>, Edges...>
+            : collect_nodes<typename add_node<typename add_node<List, F>::type,
+                                              T>::type, Edges...>
+        {};
+
+        template <typename T, typename List>
+        struct index_of;
+
+        template <typename T, typename... Ts>
+        struct index_of<T, type_list<T, Ts...>>
+            : std::integral_constant<size_t, 0>
+        {};
+
+        template <typename T, typename U, typename... Ts>
+        struct index_of<T, type_list<U, Ts...>>
+            : std::integral_constant<size_t, 1 + index_of<T, type_list<Ts...>>::value>
+        {};
+
+        // An edge, by node index. Ordering edges bind no parameter.
+        struct static_edge {
+            size_t from;
+            size_t to;
+            size_t param;
+            bool binds;
+        };
+
+        template <typename Edge, typename List>
+        struct static_edge_of;
+
+        template <typename F, typename T, size_t P, typename List>
+        struct static_edge_of<edge<F, T, P>, List> {
+            static constexpr static_edge value() {
+                return static_edge{index_of<F, List>::value, index_of<T, List>::value,
+                                   P, true};
+            }
+        };
+
+        template <typename F, typename T, typename List>
+        struct static_edge_of<after<F, T>, List> {
+            static constexpr static_edge value() {
+                return static_edge{index_of<F, List>::value, index_of<T, List>::value,
+                                   0, false};
+            }
+        };
+
+        // The shape of a graph of N nodes and E edges.
+        template <size_t N, size_t E>
+        struct static_shape {
+            static_edge edges[E];
+            size_t arity[N];
+        };
+
+        // A topological order of the nodes, the level of each, which is
+        // the length of the longest path to it, and the number of levels.
+        template <size_t N>
+        struct static_plan {
+            size_t order[N];
+            size_t level[N];
+            size_t depth;
+            bool acyclic;
+        };
+
+        template <size_t N, size_t E>
+        constexpr static_plan<N> make_static_plan(const static_shape<N, E>& shape) {
+            static_plan<N> plan{};
+            size_t pending[N] = {};
+            bool placed[N] = {};
+            for (size_t e = 0; e < E; e++) {
+                pending[shape.edges[e].to]++;
+            }
+            for (size_t k = 0; k < N; k++) {
+                size_t next(N);
+                for (size_t i = 0; i < N && next == N; i++) {
+                    if (!placed[i] && pending[i] == 0) {
+                        next = i;
+                    }
+                }
+                if (next == N) {
+                    plan.acyclic = false;
+                    return plan;
+                }
+                placed[next] = true;
+                plan.order[k] = next;
+                for (size_t e = 0; e < E; e++) {
+                    const static_edge& edge(shape.edges[e]);
+                    if (edge.to == next && plan.level[edge.from] + 1 > plan.level[next]) {
+                        plan.level[next] = plan.level[edge.from] + 1;
+                    }
+                    if (edge.from == next) {
+                        pending[edge.to]--;
+                    }
+                }
+                if (plan.level[next] + 1 > plan.depth) {
+                    plan.depth = plan.level[next] + 1;
+                }
+            }
+            plan.acyclic = true;
+            return plan;
+        }
+
+        // Whether each parameter of each node is bound by exactly one
+        // edge, and no edge binds a parameter its node does not have.
+        template <size_t N, size_t E>
+        constexpr bool static_bindings_valid(const static_shape<N, E>& shape) {
+            for (size_t e = 0; e < E; e++) {
+                const static_edge& edge(shape.edges[e]);
+                if (edge.binds && edge.param >= shape.arity[edge.to]) {
+                    return false;
+                }
+            }
+            for (size_t i = 0; i < N; i++) {
+                for (size_t p = 0; p < shape.arity[i]; p++) {
+                    size_t count(0);
+                    for (size_t e = 0; e < E; e++) {
+                        const static_edge& edge(shape.edges[e]);
+                        if (edge.binds && edge.to == i && edge.param == p) {
+                            count++;
+                        }
+                    }
+                    if (count != 1) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        // The node whose result is bound to parameter `param` of `node`.
+        template <size_t N, size_t E>
+        constexpr size_t static_source(const static_shape<N, E>& shape,
+                                       size_t node, size_t param) {
+            for (size_t e = 0; e < E; e++) {
+                const static_edge& edge(shape.edges[e]);
+                if (edge.binds && edge.to == node && edge.param == param) {
+                    return edge.from;
+                }
+            }
+            return N;
+        }
+
+        template <typename T, size_t P, bool = (P < node_traits<T>::arity)>
+        struct static_param {
+            using type = void;
+        };
+
+        template <typename T, size_t P>
+        struct static_param<T, P, true> {
+            template <typename S>
+            struct of;
+
+            template <typename R, typename... Args>
+            struct of<R (Args...)> {
+                using type = typename node_param_type<P, Args...>::type;
+            };
+
+            using type = typename of<typename node_traits<T>::signature>::type;
+        };
+
+        // Check an edge's types, so that mistakes are reported at the
+        // edge rather than deep in the schedule.
+        template <typename Edge>
+        struct static_edge_check : std::true_type
+        {};
+
+        template <typename F, typename T, size_t P>
+        struct static_edge_check<edge<F, T, P>> {
+            using result_type = typename node_traits<F>::result_type;
+            using param_type = typename static_param<T, P>::type;
+            static_assert(P < node_traits<T>::arity,
+                          "An edge binds a parameter its target does not have.");
+            static_assert(!std::is_void<result_type>::value,
+                          "An edge which passes a result must start at a node "
+                          "which returns one; use after to order nodes.");
+            static_assert(std::is_void<param_type>::value ||
+                          std::is_void<result_type>::value ||
+                          std::is_constructible<param_type,
+                                                const result_type&>::value,
+                          "An edge's parameter cannot be initialised from its "
+                          "source's result.");
+            static constexpr bool value = true;
+        };
+
+        template <typename List>
+        struct static_nodes;
+
+        template <typename... Ts>
+        struct static_nodes<type_list<Ts...>> {
+            using tuple_type = std::tuple<Ts...>;
+            using results_type = std::tuple<
+                node_value<typename node_traits<Ts>::result_type>...>;
+
+            static_assert(all_true<std::is_class<Ts>::value...>::value,
+                          "Static graph nodes must be function objects, each "
+                          "of its own type.");
+
+            template <typename T>
+            using contains = is_one_of<typename std::decay<T>::type, Ts...>;
+
+            template <typename... Edges>
+            static constexpr static_shape<sizeof...(Ts), sizeof...(Edges)> shape() {
+                return static_shape<sizeof...(Ts), sizeof...(Edges)>{
+                    {static_edge_of<Edges, type_list<Ts...>>::value()...},
+                    {static_cast<size_t>(node_traits<Ts>::arity)...}};
+            }
+        };
+
+        // Takes the argument of type T from a constructor's arguments,
+        // or default constructs T if there is none.
+        template <typename T>
+        T static_pick() {
+            return T();
+        }
+
+        template <typename T, typename A, typename... As>
+        T static_pick(A&& a, As&&... as);
+
+        template <typename T, typename A, typename... As>
+        T static_pick_first(std::true_type, A&& a, As&&...) {
+            return T(std::forward<A>(a));
+        }
+
+        template <typename T, typename A, typename... As>
+        T static_pick_first(std::false_type, A&&, As&&... as) {
+            return static_pick<T>(std::forward<As>(as)...);
+        }
+
+        template <typename T, typename A, typename... As>
+        T static_pick(A&& a, As&&... as) {
+            return static_pick_first<T>(std::is_same<T, typename std::decay<A>::type>(),
+                                        std::forward<A>(a), std::forward<As>(as)...);
+        }
+
+        // The parameters of node I of a static graph, read from the
+        // results of the nodes bound to them.
+        template <typename Graph, size_t I>
+        struct static_params {
+            const Graph* graph;
+        };
+
+        template <size_t N, typename Graph, size_t I>
+        typename static_param<typename Graph::template node_type<I>, N>::type
+        get_node_params(const static_params<Graph, I>& params) {
+            return params.graph->template read<I, N>();
+        }
+    }
+#endif // NO_DOC
+
+    template <typename Edges>
+    class static_graph;
+
+/// \brief A graph whose topology is fixed at compile time, given as a
+/// list of edges between function object types.
+///
+/// Each node is a function object of a distinct class type, such as the
+/// type of a lambda, and is stored by value in a `std::tuple`. The graph
+/// checks at compile time that it is acyclic and that every parameter of
+/// every node is bound by exactly one edge to a result it can be
+/// initialised from, and computes a topological order and the level of
+/// each node. Executing the graph calls every node in that order on the
+/// calling thread, through code generated for this graph alone: there
+/// is no type erasure, no allocation and no lookup at run time. Results
+/// are kept until the next execution.
+///
+///     using G = callgraph::static_graph<callgraph::edges<
+///         callgraph::edge<A, B>,
+///         callgraph::edge<A, C>,
+///         callgraph::edge<B, D, 0>,
+///         callgraph::edge<C, D, 1>>>;
+///     G g(a, b, c, d);
+///     g();
+///     int result(g.get<D>());
+///
+/// \tparam Edges An `edges` list of `edge` and `after` types.
+    template <typename... Edges>
+    class static_graph<edges<Edges...>> {
+        using node_list =
+            typename detail::collect_nodes<detail::type_list<>, Edges...>::type;
+        using nodes = detail::static_nodes<node_list>;
+
+    public:
+        /// \brief A `std::tuple` of the node types, in order of their first
+        /// appearance in the edge list.
+        using nodes_type = typename nodes::tuple_type;
+
+        /// \brief The number of nodes.
+        static constexpr size_t size() {
+            return std::tuple_size<nodes_type>::value;
+        }
+
+        /// \brief The number of levels, which is the length of the
+        /// longest path through the graph plus one.
+        static constexpr size_t depth() {
+            return plan().depth;
+        }
+
+        /// \brief The level of node `T`: zero for nodes without parents,
+        /// and otherwise one more than the level of its deepest parent.
+        template <typename T>
+        static constexpr size_t level() {
+            return plan().level[detail::index_of<T, node_list>::value];
+        }
+
+        /// \brief The position of node `T` in the order of execution.
+        template <typename T>
+        static constexpr size_t position() {
+            return position(detail::index_of<T, node_list>::value, 0);
+        }
+
+        /// \brief Construct the graph from its nodes, in any order. Nodes
+        /// which are not given are default constructed.
+        template <typename... Ts,
+                  typename = typename std::enable_if<detail::all_true<
+                      nodes::template contains<Ts>::value...>::value>::type>
+        explicit static_graph(Ts&&... ts)
+            : static_graph(sequence(), std::forward<Ts>(ts)...)
+            {
+            }
+
+        /// \brief Execute every node, in topological order, on the calling
+        /// thread.
+        ///
+        /// If a node throws, no further nodes are called, and the exception
+        /// propagates to the caller.
+        void operator()() {
+            reset(sequence());
+            run(sequence());
+        }
+
+        /// \brief Get node `T`.
+        template <typename T>
+        T& node() {
+            return std::get<detail::index_of<T, node_list>::value>(nodes_);
+        }
+
+        /// \brief Get node `T`.
+        template <typename T>
+        const T& node() const {
+            return std::get<detail::index_of<T, node_list>::value>(nodes_);
+        }
+
+        /// \brief Get the result of node `T` from the last execution.
+        /// \throws result_not_ready if `T` did not run to completion.
+        template <typename T>
+        const typename detail::node_traits<T>::result_type& get() const {
+            static_assert(!std::is_void<
+                          typename detail::node_traits<T>::result_type>::value,
+                          "Only nodes which return a value have a result.");
+            return std::get<detail::index_of<T, node_list>::value>(results_).get();
+        }
+
+#ifndef NO_DOC
+        template <size_t I>
+        using node_type = typename std::tuple_element<I, nodes_type>::type;
+
+        // Read parameter P of node I from the result bound to it.
+        template <size_t I, size_t P>
+        typename detail::static_param<node_type<I>, P>::type read() const {
+            using type = typename detail::static_param<node_type<I>, P>::type;
+            return static_cast<type>(
+                std::get<detail::static_source(shape(), I, P)>(results_).get());
+        }
+#endif // NO_DOC
+
+    private:
+        static_assert(sizeof...(Edges) > 0, "A static graph needs at least one edge.");
+        static_assert(detail::all_true<detail::static_edge_check<Edges>::value...>::value,
+                      "");
+
+        using sequence = typename detail::generate_node_call_sequence<
+            std::tuple_size<nodes_type>::value>::type;
+
+        static constexpr detail::static_shape<std::tuple_size<nodes_type>::value,
+                                              sizeof...(Edges)> shape() {
+            return nodes::template shape<Edges...>();
+        }
+
+        static constexpr detail::static_plan<std::tuple_size<nodes_type>::value> plan() {
+            return detail::make_static_plan(shape());
+        }
+
+        static constexpr size_t position(size_t node, size_t k) {
+            return plan().order[k] == node ? k : position(node, k + 1);
+        }
+
+        template <size_t... I, typename... Ts>
+        static_graph(detail::node_call_sequence<I...>, Ts&&... ts)
+            : nodes_(detail::static_pick<node_type<I>>(std::forward<Ts>(ts)...)...)
+            {
+                static_assert(plan().acyclic, "A static graph must not have cycles.");
+                static_assert(detail::static_bindings_valid(shape()),
+                              "Every parameter of every node must be bound by "
+                              "exactly one edge.");
+            }
+
+        template <size_t... I>
+        void reset(detail::node_call_sequence<I...>) {
+            int expand[] = {0, (std::get<I>(results_).reset(), 0)...};
+            (void)expand;
+        }
+
+        // Run each node in topological order.
+        template <size_t... K>
+        void run(detail::node_call_sequence<K...>) {
+            int expand[] = {0, (run_node<plan().order[K]>(), 0)...};
+            (void)expand;
+        }
+
+        template <size_t I>
+        void run_node() {
+            using signature = typename detail::node_traits<node_type<I>>::signature;
+            detail::static_params<static_graph, I> params{this};
+            detail::node_call<signature>::apply(std::get<I>(nodes_), params,
+                                                std::get<I>(results_));
+        }
+
+        nodes_type nodes_;
+        typename nodes::results_type results_;
+    };
+}
+
+#endif // CALLGRAPH_STATIC_GRAPH_HPP
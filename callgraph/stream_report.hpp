@@ -0,0 +1,109 @@
+// callgraph/stream_report.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_STREAM_REPORT_HPP
+#define CALLGRAPH_STREAM_REPORT_HPP
+
+#include <callgraph/detail/node_key.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+namespace callgraph {
+    class stream_runner;
+
+    /// \brief Counters recorded for a single stage of a streaming graph.
+    struct stream_stage {
+        /// \brief The duration type used for all timers.
+        using duration = std::chrono::nanoseconds;
+
+        /// \brief The number of items the stage has processed.
+        std::uint64_t items = 0;
+
+        /// \brief The time spent invoking the node's callable.
+        duration busy_time = duration::zero();
+
+        /// \brief The time spent waiting for an item on every input.
+        duration input_wait_time = duration::zero();
+
+        /// \brief The time spent waiting for room on every output.
+        duration output_wait_time = duration::zero();
+
+        /// \brief The items processed per second of streaming.
+        double throughput = 0.0;
+    };
+
+    /// \brief Occupancy of the bounded queue along one edge of a
+    /// streaming graph.
+    struct stream_queue {
+        /// \brief The greatest number of items the queue holds.
+        std::size_t capacity = 0;
+
+        /// \brief The number of items queued when the report was taken.
+        std::size_t size = 0;
+
+        /// \brief The largest number of items observed in the queue.
+        std::size_t high_water = 0;
+
+        /// \brief The mean number of items in the queue, sampled as each
+        /// item is pushed.
+        double mean_occupancy = 0.0;
+    };
+
+    /// \brief A snapshot of the counters kept by a stream_runner across
+    /// all of its executions.
+    ///
+    /// This type is returned from stream_runner::report.
+    class stream_report {
+    public:
+        /// \brief The duration type used for all timers.
+        using duration = std::chrono::nanoseconds;
+
+        /// \brief The time spent streaming, summed over every execution.
+        duration elapsed() const {
+            return elapsed_;
+        }
+
+        /// \brief Get the counters of a single stage.
+        /// \tparam T A Callable type, or a node wrapper which wraps
+        /// such a type.
+        /// \throws std::out_of_range if `t` is not a stage of the graph.
+        template <typename T>
+        const stream_stage& stage(T&& t) const {
+            return stages_.at(detail::to_node_key<T>::apply(t));
+        }
+
+        /// \brief Get the occupancy of the queue from `f` to `g`.
+        /// \throws std::out_of_range if `f` is not connected to `g`.
+        template <typename F, typename G>
+        const stream_queue& queue(F&& f, G&& g) const {
+            return queues_.at(std::make_pair(detail::to_node_key<F>::apply(f),
+                                             detail::to_node_key<G>::apply(g)));
+        }
+
+        /// \brief Get the counters of every stage, keyed by node identity.
+        const std::unordered_map<detail::node_key, stream_stage>& stages() const {
+            return stages_;
+        }
+
+        /// \brief Get the occupancy of every queue, keyed by the identity
+        /// of the nodes at either end.
+        const std::map<std::pair<detail::node_key, detail::node_key>,
+                       stream_queue>& queues() const {
+            return queues_;
+        }
+
+    private:
+        friend class stream_runner;
+
+        duration elapsed_ = duration::zero();
+        std::unordered_map<detail::node_key, stream_stage> stages_;
+        std::map<std::pair<detail::node_key, detail::node_key>, stream_queue> queues_;
+    };
+}
+
+#endif // CALLGRAPH_STREAM_REPORT_HPP
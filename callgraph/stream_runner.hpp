@@ -0,0 +1,527 @@
+// callgraph/stream_runner.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_STREAM_RUNNER_HPP
+#define CALLGRAPH_STREAM_RUNNER_HPP
+
+#include <callgraph/graph.hpp>
+#include <callgraph/stream_report.hpp>
+#include <callgraph/detail/graph_node.hpp>
+#include <callgraph/detail/stream_buffer.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace callgraph {
+
+/// \brief Thrown by a node of a streaming graph to end the stream.
+///
+/// A source throws this once it has no more items. The stages which
+/// read from it end once they have processed every item it produced.
+    class stream_end : public std::runtime_error {
+    public:
+        stream_end()
+            : runtime_error("The stream has ended.")
+            {
+            }
+    };
+
+/// \brief A stream runner is a non-copyable type which runs a callgraph
+/// as a pipeline over a sequence of items.
+///
+/// Every node of the graph becomes a stage with its own thread, which is
+/// invoked once per item. Source nodes produce the next item each time
+/// they are invoked. Every edge of the graph becomes a bounded queue:
+/// a stage runs as soon as each of its inputs holds an item, and waits
+/// while any of its outputs is full, so a slow stage holds back the
+/// stages feeding it rather than letting its queues grow.
+///
+/// A stream runs until a node throws stream_end, or for a given number of
+/// items. The end flows through the graph along its edges: a stage ends
+/// once a parent has ended and every item it produced has been taken,
+/// and a stage whose outputs have all ended ends too. One execution can
+/// therefore stream any number of items without draining the pipeline.
+///
+/// Parameters are copied into the queues, so they must be copy
+/// constructible, and gather and reduce nodes cannot be streamed. Branch
+/// cases and optional budgets have no effect on streaming. Memoized nodes
+/// look up the inputs of each item in their cache, as they do in any
+/// other execution.
+/// While a stream runner exists, its graph must not be executed by any
+/// other runner.
+    class stream_runner {
+    public:
+        /// \brief Construct a stream runner which wraps a graph, with
+        /// queues of 64 items.
+        stream_runner(graph& g)
+            : stream_runner(g, 64)
+            {
+            }
+
+        /// \brief Construct a stream runner which wraps a graph, with
+        /// queues of `capacity` items.
+        /// \throws std::runtime_error if the graph has a gather or reduce
+        /// node.
+        stream_runner(graph& g, size_t capacity)
+            : graph_(&g),
+              capacity_(std::max<size_t>(capacity, 1)),
+              on_(true),
+              generation_(0),
+              items_(0),
+              stopped_(false),
+              active_(0),
+              elapsed_(clock_type::duration::zero())
+            {
+                for (auto& pair : graph_->nodes_) {
+                    for (const auto& input : pair.second.inputs_) {
+                        if (input.to >= 0 &&
+                            !pair.second.port(static_cast<size_t>(input.to))) {
+                            throw std::runtime_error(
+                                "Gather and reduce nodes cannot be streamed.");
+                        }
+                    }
+                }
+                std::vector<stage*> by_id(graph_->next_id_, nullptr);
+                for (auto& pair : graph_->nodes_) {
+                    if (&pair.second != graph_->root_node_) {
+                        stages_.emplace_back(new stage(pair.first, &pair.second));
+                        by_id[pair.second.id()] = stages_.back().get();
+                    }
+                }
+                for (auto& s : stages_) {
+                    for (const graph_node_type* child : s->node->children_) {
+                        connect(*s, *by_id[child->id()]);
+                    }
+                }
+                // Data bindings may have been reduced out of the children.
+                for (auto& s : stages_) {
+                    for (const auto& input : s->node->inputs_) {
+                        if (input.source == graph_->root_node_) {
+                            continue;
+                        }
+                        output& out(connect(*by_id[input.source->id()], *s));
+                        if (input.to >= 0) {
+                            detail::node_stream_port* port(
+                                s->node->port(static_cast<size_t>(input.to)));
+                            port->open_stream(capacity_);
+                            out.ports.push_back(port);
+                            s->inputs.push_back(port);
+                        }
+                    }
+                }
+                for (auto& s : stages_) {
+                    stage* ptr(s.get());
+                    s->thread = std::thread([this, ptr] { work(*ptr); });
+                }
+            }
+
+        /// \brief Stream runner destructor. Wait for the current execution
+        /// to stop, and restore the graph's parameters.
+        ~stream_runner() {
+            {
+                std::unique_lock<std::mutex> lk(mutex_);
+                on_ = false;
+                stopped_.store(true);
+            }
+            start_.notify_all();
+            wake_all();
+            for (auto& s : stages_) {
+                if (s->thread.joinable()) {
+                    s->thread.join();
+                }
+            }
+            for (auto& s : stages_) {
+                for (detail::node_stream_port* port : s->inputs) {
+                    port->open_stream(0);
+                }
+            }
+        }
+
+        stream_runner(const stream_runner&) = delete;
+        stream_runner& operator=(const stream_runner&) = delete;
+        stream_runner(stream_runner&&) = delete;
+        stream_runner& operator=(stream_runner&&) = delete;
+
+        /// \brief Stream items through the graph asynchronously until a
+        /// node throws stream_end.
+        ///
+        /// If a node throws anything else, every stage stops, and the
+        /// first exception thrown is rethrown from the returned future.
+        /// \return A future which can be used to wait for the stream to
+        /// finish or to catch any exception thrown.
+        /// \warning Subsequent executions must not be invoked until
+        /// previous calls have finished.
+        std::future<void> execute() {
+            return execute(std::numeric_limits<size_t>::max());
+        }
+
+        /// \brief Stream at most `items` items through the graph
+        /// asynchronously.
+        ///
+        /// Each node is invoked `items` times, unless a node throws
+        /// stream_end first.
+        /// \see execute()
+        std::future<void> execute(size_t items) {
+            std::unique_lock<std::mutex> lk(mutex_);
+            // Discard anything left queued by a failed execution.
+            for (auto& s : stages_) {
+                s->produced.store(0);
+                s->consumed.store(0);
+                s->ended.store(false);
+                for (detail::node_stream_port* port : s->inputs) {
+                    port->stream_clear();
+                }
+            }
+            error_ = nullptr;
+            stopped_.store(false);
+            done_ = std::promise<void>();
+            std::future<void> future(done_.get_future());
+            started_ = clock_type::now();
+            if (stages_.empty()) {
+                done_.set_value();
+                return future;
+            }
+            items_ = items;
+            active_.store(stages_.size());
+            generation_++;
+            lk.unlock();
+            start_.notify_all();
+            return future;
+        }
+
+        /// \brief Take a snapshot of the runner's counters.
+        ///
+        /// This may be called at any time, including while the graph is
+        /// streaming.
+        stream_report report() const {
+            using duration = stream_report::duration;
+            auto load = [](const std::atomic<std::uint64_t>& a) {
+                return a.load(std::memory_order_relaxed);
+            };
+            stream_report r;
+            {
+                std::unique_lock<std::mutex> lk(mutex_);
+                r.elapsed_ = std::chrono::duration_cast<duration>(elapsed_);
+                if (active_.load() > 0) {
+                    r.elapsed_ += std::chrono::duration_cast<duration>(
+                        clock_type::now() - started_);
+                }
+            }
+            double seconds(std::chrono::duration<double>(r.elapsed_).count());
+            for (auto& s : stages_) {
+                stream_stage& st(r.stages_[s->key]);
+                st.items = load(s->items);
+                st.busy_time = duration(load(s->busy_time));
+                st.input_wait_time = duration(load(s->input_wait_time));
+                st.output_wait_time = duration(load(s->output_wait_time));
+                st.throughput = seconds > 0 ?
+                    static_cast<double>(st.items) / seconds : 0.0;
+                for (auto& out : s->outputs) {
+                    stream_queue& q(r.queues_[std::make_pair(s->key, out->target->key)]);
+                    std::uint64_t produced(s->produced.load());
+                    std::uint64_t consumed(out->target->consumed.load());
+                    std::uint64_t samples(load(out->samples));
+                    q.capacity = capacity_;
+                    q.size = produced > consumed ? produced - consumed : 0;
+                    q.high_water = load(out->high_water);
+                    q.mean_occupancy = samples > 0 ?
+                        static_cast<double>(load(out->occupancy)) /
+                        static_cast<double>(samples) : 0.0;
+                }
+            }
+            return r;
+        }
+
+    private:
+        using graph_node_type = callgraph::detail::graph_node;
+        using clock_type = std::chrono::steady_clock;
+
+        struct stage;
+
+        // An edge to another stage, with the parameters of that stage
+        // which are bound to this one.
+        struct output {
+            stage* target;
+            std::vector<detail::node_stream_port*> ports;
+            std::atomic<std::uint64_t> high_water{0};
+            std::atomic<std::uint64_t> occupancy{0};
+            std::atomic<std::uint64_t> samples{0};
+        };
+
+        struct stage {
+            stage(detail::node_key k, const graph_node_type* n)
+                : key(k),
+                  node(n)
+                {
+                }
+
+            detail::node_key key;
+            const graph_node_type* node;
+            std::vector<stage*> parents;
+            std::vector<std::unique_ptr<output>> outputs;
+            std::vector<detail::node_stream_port*> inputs;
+            // Items produced into the outputs, and taken from the inputs.
+            std::atomic<std::uint64_t> produced{0};
+            std::atomic<std::uint64_t> consumed{0};
+            // Set once the stage will produce nothing more in this
+            // execution, after its last item is counted.
+            std::atomic<bool> ended{false};
+            std::mutex mutex;
+            std::condition_variable wake;
+            std::atomic<bool> waiting{false};
+            std::atomic<std::uint64_t> items{0};
+            // Timers, in nanoseconds.
+            std::atomic<std::uint64_t> busy_time{0};
+            std::atomic<std::uint64_t> input_wait_time{0};
+            std::atomic<std::uint64_t> output_wait_time{0};
+            std::thread thread;
+        };
+
+        output& connect(stage& from, stage& to) {
+            for (auto& out : from.outputs) {
+                if (out->target == &to) {
+                    return *out;
+                }
+            }
+            from.outputs.emplace_back(new output());
+            from.outputs.back()->target = &to;
+            to.parents.push_back(&from);
+            return *from.outputs.back();
+        }
+
+        static void add(std::atomic<std::uint64_t>& counter,
+                        clock_type::duration d) {
+            counter.fetch_add(static_cast<std::uint64_t>(
+                                  std::chrono::duration_cast<
+                                  std::chrono::nanoseconds>(d).count()),
+                              std::memory_order_relaxed);
+        }
+
+        bool stopped() const {
+            return stopped_.load();
+        }
+
+        // Block `s` until `ready` holds, or the execution stops. Returns
+        // false if it stopped. Whoever makes `ready` hold calls wake(s).
+        template <typename P>
+        bool wait_for(stage& s, P ready) {
+            if (ready()) {
+                return true;
+            }
+            std::unique_lock<std::mutex> lk(s.mutex);
+            s.waiting.store(true);
+            while (!ready() && !stopped()) {
+                s.wake.wait(lk);
+            }
+            s.waiting.store(false);
+            return !stopped();
+        }
+
+        void wake(stage& s) {
+            if (s.waiting.load()) {
+                std::unique_lock<std::mutex> lk(s.mutex);
+                s.wake.notify_one();
+            }
+        }
+
+        void wake_all() {
+            for (auto& s : stages_) {
+                std::unique_lock<std::mutex> lk(s->mutex);
+                s->wake.notify_all();
+            }
+        }
+
+        // Stop the current execution with `error`. The first error wins.
+        void fail(std::exception_ptr error) {
+            {
+                std::unique_lock<std::mutex> lk(mutex_);
+                if (!error_) {
+                    error_ = std::move(error);
+                }
+                stopped_.store(true);
+            }
+            wake_all();
+        }
+
+        // End the stream at `s`, and wake the stages either side of it.
+        void end(stage& s) {
+            s.ended.store(true);
+            for (auto& out : s.outputs) {
+                wake(*out->target);
+            }
+            for (stage* parent : s.parents) {
+                wake(*parent);
+            }
+        }
+
+        // Whether `parent` has ended without producing item `i`.
+        static bool exhausted(const stage* parent, std::uint64_t i) {
+            return parent->ended.load() && parent->produced.load() <= i;
+        }
+
+        void run_stage(stage& s, std::uint64_t items) {
+            for (std::uint64_t i = 0; i < items && !stopped(); i++) {
+                auto start(clock_type::now());
+                bool ready(wait_for(s, [&s, i] {
+                            return std::all_of(
+                                s.parents.begin(), s.parents.end(),
+                                [i](const stage* p) { return p->produced.load() > i; }) ||
+                                std::any_of(s.parents.begin(), s.parents.end(),
+                                            [i](const stage* p) { return exhausted(p, i); });
+                        }));
+                if (!ready) {
+                    break;
+                }
+                if (std::any_of(s.parents.begin(), s.parents.end(),
+                                [i](const stage* p) { return exhausted(p, i); })) {
+                    end(s);
+                    break;
+                }
+                auto invoked(clock_type::now());
+                add(s.input_wait_time, invoked - start);
+                try {
+                    s.node->release_result();
+                    s.node->execute();
+                }
+                catch(const stream_end&) {
+                    end(s);
+                    break;
+                }
+                catch(...) {
+                    fail(std::current_exception());
+                    break;
+                }
+                auto finished(clock_type::now());
+                add(s.busy_time, finished - invoked);
+
+                for (detail::node_stream_port* port : s.inputs) {
+                    port->stream_pop();
+                }
+                s.consumed.store(i + 1);
+                for (stage* parent : s.parents) {
+                    wake(*parent);
+                }
+
+                size_t capacity(capacity_);
+                ready = wait_for(s, [&s, i, capacity] {
+                        return std::all_of(
+                            s.outputs.begin(), s.outputs.end(),
+                            [i, capacity](const std::unique_ptr<output>& out) {
+                                return out->target->ended.load() ||
+                                    out->target->consumed.load() + capacity > i;
+                            });
+                    });
+                if (!ready) {
+                    break;
+                }
+                add(s.output_wait_time, clock_type::now() - finished);
+                try {
+                    for (auto& out : s.outputs) {
+                        // Nothing reads the queues of an ended stage.
+                        if (out->target->ended.load()) {
+                            continue;
+                        }
+                        for (detail::node_stream_port* port : out->ports) {
+                            port->stream_push();
+                        }
+                        record_occupancy(*out, i + 1 - out->target->consumed.load());
+                    }
+                }
+                catch(...) {
+                    fail(std::current_exception());
+                    break;
+                }
+                s.produced.store(i + 1);
+                for (auto& out : s.outputs) {
+                    wake(*out->target);
+                }
+                s.items.fetch_add(1, std::memory_order_relaxed);
+                if (!s.outputs.empty() &&
+                    std::all_of(s.outputs.begin(), s.outputs.end(),
+                                [](const std::unique_ptr<output>& out) {
+                                    return out->target->ended.load();
+                                })) {
+                    end(s);
+                    break;
+                }
+            }
+            s.node->release_result();
+        }
+
+        static void record_occupancy(output& out, std::uint64_t size) {
+            out.occupancy.fetch_add(size, std::memory_order_relaxed);
+            out.samples.fetch_add(1, std::memory_order_relaxed);
+            if (size > out.high_water.load(std::memory_order_relaxed)) {
+                out.high_water.store(size, std::memory_order_relaxed);
+            }
+        }
+
+        void work(stage& s) {
+            std::uint64_t seen(0);
+            for (;;) {
+                std::uint64_t items;
+                {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    start_.wait(lk, [this, seen] {
+                            return !on_ || generation_ != seen;
+                        });
+                    if (!on_) {
+                        return;
+                    }
+                    seen = generation_;
+                    items = items_;
+                }
+                run_stage(s, items);
+                if (active_.fetch_sub(1) == 1) {
+                    finish();
+                }
+            }
+        }
+
+        void finish() {
+            std::unique_lock<std::mutex> lk(mutex_);
+            elapsed_ += clock_type::now() - started_;
+            try {
+                if (error_) {
+                    done_.set_exception(error_);
+                }
+                else {
+                    done_.set_value();
+                }
+            }
+            catch(...) {}
+        }
+
+        graph* graph_;
+        size_t capacity_;
+
+        // Guarded by mutex_.
+        bool on_;
+        std::uint64_t generation_;
+        std::uint64_t items_;
+        std::exception_ptr error_;
+        std::promise<void> done_;
+        clock_type::time_point started_;
+
+        std::atomic<bool> stopped_;
+        std::atomic<size_t> active_;
+        clock_type::duration elapsed_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable start_;
+        std::vector<std::unique_ptr<stage>> stages_;
+    };
+}
+
+#endif // CALLGRAPH_STREAM_RUNNER_HPP
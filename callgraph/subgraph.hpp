@@ -0,0 +1,125 @@
+// callgraph/subgraph.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_SUBGRAPH_HPP
+#define CALLGRAPH_SUBGRAPH_HPP
+
+#include <callgraph/graph.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+namespace callgraph {
+#ifndef NO_DOC
+    namespace detail {
+        // The node through which a value enters a subgraph.
+        template <typename T>
+        struct subgraph_input {
+            using value_type = typename std::decay<T>::type;
+
+            value_type operator()(const value_type& x) const {
+                return x;
+            }
+
+            // Nodes are keyed by address, so the inputs of a subgraph
+            // must not share one.
+            char distinct = 0;
+        };
+
+        // The node through which a subgraph's result leaves it.
+        template <typename R>
+        struct subgraph_output {
+            using value_type = typename std::decay<R>::type;
+
+            value_type operator()(const value_type& x) const {
+                return x;
+            }
+        };
+
+        template <>
+        struct subgraph_output<void> {
+            void operator()() const {
+            }
+        };
+    }
+#endif // NO_DOC
+
+    template <typename S>
+    class subgraph;
+
+/// \brief A reusable fragment of a graph, with typed inputs and a typed
+/// output, which can be inserted into another graph as a node.
+///
+/// Build the fragment as any other graph, reading parameter `N` of the
+/// signature by connecting from `input<N>()`, and connecting the node
+/// which computes the fragment's result to `output()`. Then insert the
+/// subgraph into a graph with graph::insert, and connect to the same
+/// inputs and output there.
+///
+/// Insertion moves the fragment's nodes into the enclosing graph, so they
+/// are scheduled on its runner's workers like any other node: entering
+/// and leaving the fragment costs one copy of each value, and no threads
+/// or blocking. Subgraphs may be inserted into other subgraphs. A
+/// subgraph is not run on its own.
+/// \tparam R The type of the fragment's result, or `void`.
+/// \tparam Params The types of the fragment's inputs.
+    template <typename R, typename... Params>
+    class subgraph<R(Params...)> : public graph {
+    public:
+        /// \brief The type of input `N`.
+        template <size_t N>
+        using input_type = detail::subgraph_input<
+            typename std::tuple_element<N, std::tuple<Params...>>::type>;
+
+        /// \brief The type of the output.
+        using output_type = detail::subgraph_output<R>;
+
+        /// \brief Construct a subgraph consisting only of its inputs and
+        /// output.
+        subgraph()
+            : inputs_(new std::tuple<detail::subgraph_input<Params>...>()),
+              output_(new output_type())
+            {
+                add_ports(std::integral_constant<size_t, 0>());
+            }
+
+        /// \brief Get the node which supplies input `N` of the fragment.
+        ///
+        /// The same node is the target which the enclosing graph connects
+        /// to, once the subgraph is inserted.
+        template <size_t N>
+        input_type<N>& input() const {
+            return std::get<N>(*inputs_);
+        }
+
+        /// \brief Get the node which receives the fragment's result.
+        ///
+        /// The same node is the source which the enclosing graph connects
+        /// from, once the subgraph is inserted.
+        output_type& output() const {
+            return *output_;
+        }
+
+    private:
+        template <size_t N>
+        void add_ports(std::integral_constant<size_t, N>) {
+            ensure_node(std::get<N>(*inputs_));
+            set_name(std::get<N>(*inputs_), "input " + std::to_string(N));
+            add_ports(std::integral_constant<size_t, N + 1>());
+        }
+
+        void add_ports(std::integral_constant<size_t, sizeof...(Params)>) {
+            ensure_node(*output_);
+            set_name(*output_, "output");
+        }
+
+        // Held on the heap, so that the handles outlive moves.
+        std::unique_ptr<std::tuple<detail::subgraph_input<Params>...>> inputs_;
+        std::unique_ptr<output_type> output_;
+    };
+}
+
+#endif // CALLGRAPH_SUBGRAPH_HPP
@@ -0,0 +1,359 @@
+// callgraph/task.hpp
+// License: BSD-2-Clause
+
+#ifndef CALLGRAPH_TASK_HPP
+#define CALLGRAPH_TASK_HPP
+
+#include <callgraph/detail/async_target.hpp>
+
+#if !defined(__cpp_impl_coroutine)
+#error "callgraph/task.hpp requires C++20 coroutines."
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace callgraph {
+#ifndef NO_DOC
+    namespace detail {
+        struct task_promise_base {
+            struct final_awaiter {
+                bool await_ready() const noexcept {
+                    return false;
+                }
+
+                template <typename P>
+                void await_suspend(std::coroutine_handle<P> h) noexcept {
+                    h.promise().finish();
+                }
+
+                void await_resume() const noexcept {
+                }
+            };
+
+            // Coroutines start once the runner has bound them.
+            std::suspend_always initial_suspend() noexcept {
+                return {};
+            }
+
+            final_awaiter final_suspend() noexcept {
+                return {};
+            }
+
+            void unhandled_exception() noexcept {
+                error = std::current_exception();
+            }
+
+            // Continue the suspended coroutine, on the runner if it has one.
+            void resume() {
+                if (target.resume) {
+                    target.resume(target.runner, target.node);
+                }
+                else {
+                    self.resume();
+                }
+            }
+
+            // Report that the coroutine has finished. The runner may
+            // destroy the coroutine before this returns.
+            void finish() noexcept {
+                if (target.finish) {
+                    async_target t(target);
+                    t.finish(t.runner, t.node);
+                    return;
+                }
+                std::unique_lock<std::mutex> lk(mutex);
+                finished = true;
+                done.notify_all();
+            }
+
+            // Run the coroutine on this thread, and on whichever threads
+            // wake it, until it finishes.
+            void run_inline() {
+                target = async_target();
+                self.resume();
+                std::unique_lock<std::mutex> lk(mutex);
+                done.wait(lk, [this] { return finished; });
+            }
+
+            async_target target = async_target();
+            std::coroutine_handle<> self;
+            std::exception_ptr error;
+            std::mutex mutex;
+            std::condition_variable done;
+            bool finished = false;
+        };
+
+        template <typename T>
+        struct task_promise : task_promise_base {
+            template <typename U>
+            void return_value(U&& u) {
+                value.emplace(std::forward<U>(u));
+            }
+
+            const T& get() const {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+                return *value;
+            }
+
+            std::optional<T> value;
+        };
+
+        template <>
+        struct task_promise<void> : task_promise_base {
+            void return_void() {
+            }
+
+            void get() const {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+        };
+
+        // The type a task converts to; tasks of void convert to nothing.
+        template <typename T>
+        struct task_value {
+            using type = T;
+        };
+
+        template <>
+        struct task_value<void> {
+            struct type {};
+        };
+
+        template <typename P>
+        task_promise_base& promise_of(std::coroutine_handle<P> h) {
+            static_assert(std::is_base_of<task_promise_base, P>::value,
+                          "Only a callgraph::task can await this.");
+            return h.promise();
+        }
+    }
+#endif // NO_DOC
+
+/// \brief The result of a node written as a coroutine.
+///
+/// A node which returns `task<T>` may `co_await` while it runs. Under a
+/// graph_runner, a suspended node releases its worker, and is resumed on
+/// the runner's workers once what it awaits completes, if that is a
+/// completion or reschedule. Other awaitables resume the node on the
+/// thread which completes them. The node's children are released once
+/// the coroutine returns, and read the value it returned through the
+/// task, which converts to `const T&`.
+///
+/// Other runners, and incremental executions, wait for the coroutine to
+/// finish before moving on.
+/// \tparam T The type of the value returned with `co_return`.
+    template <typename T = void>
+    class task {
+    public:
+        /// \brief The promise type of the coroutine.
+        struct promise_type : detail::task_promise<T> {
+            task get_return_object() {
+                auto h(std::coroutine_handle<promise_type>::from_promise(*this));
+                this->self = h;
+                return task(h);
+            }
+        };
+
+        /// \brief Move-construct a task.
+        task(task&& other) noexcept
+            : h_(std::exchange(other.h_, nullptr))
+            {
+            }
+
+        task(const task&) = delete;
+        task& operator=(const task&) = delete;
+        task& operator=(task&&) = delete;
+
+        /// \brief Destroy the coroutine.
+        ~task() {
+            if (h_) {
+                h_.destroy();
+            }
+        }
+
+        /// \brief Get the value the coroutine returned, or rethrow the
+        /// exception it threw.
+        decltype(auto) get() const {
+            return h_.promise().get();
+        }
+
+        /// \brief Get the value the coroutine returned, so that consumers
+        /// may take a parameter of type `T`.
+        /// \see get
+        operator const typename detail::task_value<T>::type&() const {
+            return h_.promise().get();
+        }
+
+#ifndef NO_DOC
+        using async_category = void;
+
+        void start(const detail::async_target& target) const {
+            h_.promise().target = target;
+            h_.resume();
+        }
+
+        void resume() const {
+            h_.resume();
+        }
+
+        void run_inline() const {
+            h_.promise().run_inline();
+        }
+
+        const std::exception_ptr& error() const {
+            return h_.promise().error;
+        }
+#endif // NO_DOC
+
+    private:
+        explicit task(std::coroutine_handle<promise_type> h)
+            : h_(h)
+            {
+            }
+
+        std::coroutine_handle<promise_type> h_;
+    };
+
+/// \brief A value delivered from outside the graph, which a task awaits.
+///
+/// A node awaits the completion with `co_await`, and another thread
+/// delivers the value with set, which resumes the node. Each completion
+/// is awaited once; reset it before it is awaited again.
+/// \tparam T The type of the value delivered, or `void`.
+    template <typename T = void>
+    class completion {
+    public:
+        completion()
+            : state_(empty),
+              waiter_(nullptr)
+            {
+            }
+
+        completion(const completion&) = delete;
+        completion& operator=(const completion&) = delete;
+
+        /// \brief Deliver `value`, resuming the node awaiting it.
+        template <typename U = T>
+        typename std::enable_if<!std::is_void<U>::value>::type set(U value) {
+            value_.emplace(std::move(value));
+            notify();
+        }
+
+        /// \brief Complete, resuming the node awaiting it.
+        template <typename U = T>
+        typename std::enable_if<std::is_void<U>::value>::type set() {
+            notify();
+        }
+
+        /// \brief Deliver an exception, which is thrown from `co_await`.
+        void set_exception(std::exception_ptr error) {
+            error_ = std::move(error);
+            notify();
+        }
+
+        /// \brief Forget the delivered value, so that the completion can
+        /// be awaited again. It must not be awaited while it is reset.
+        void reset() {
+            value_.reset();
+            error_ = nullptr;
+            waiter_ = nullptr;
+            state_.store(empty, std::memory_order_relaxed);
+        }
+
+#ifndef NO_DOC
+        struct awaiter {
+            bool await_ready() const noexcept {
+                return c->state_.load(std::memory_order_acquire) == delivered;
+            }
+
+            template <typename P>
+            bool await_suspend(std::coroutine_handle<P> h) {
+                c->waiter_ = &detail::promise_of(h);
+                int expected(empty);
+                // If the value arrived meanwhile, carry on without suspending.
+                return c->state_.compare_exchange_strong(
+                    expected, waiting, std::memory_order_acq_rel);
+            }
+
+            T await_resume() {
+                if (c->error_) {
+                    std::rethrow_exception(c->error_);
+                }
+                return c->value(std::is_void<T>());
+            }
+
+            completion* c;
+        };
+
+        awaiter operator co_await() {
+            return awaiter{this};
+        }
+#endif // NO_DOC
+
+    private:
+        enum : int {
+            empty,
+            waiting,
+            delivered
+        };
+
+        using storage_type = typename std::conditional<
+            std::is_void<T>::value, bool, T>::type;
+
+        void notify() {
+            if (state_.exchange(delivered, std::memory_order_acq_rel) == waiting) {
+                waiter_->resume();
+            }
+        }
+
+        T value(std::false_type) {
+            return std::move(*value_);
+        }
+
+        void value(std::true_type) {
+        }
+
+        std::atomic<int> state_;
+        detail::task_promise_base* waiter_;
+        std::optional<storage_type> value_;
+        std::exception_ptr error_;
+    };
+
+/// \brief An awaitable which moves a task back onto the runner's workers.
+///
+/// Awaiting it suspends the node and queues it to continue on a worker,
+/// for example after awaiting something which resumes it on another
+/// thread. Without a runner it does nothing.
+    struct reschedule {
+#ifndef NO_DOC
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        template <typename P>
+        bool await_suspend(std::coroutine_handle<P> h) {
+            detail::task_promise_base& promise(detail::promise_of(h));
+            if (!promise.target.resume) {
+                return false;
+            }
+            promise.resume();
+            return true;
+        }
+
+        void await_resume() const noexcept {
+        }
+#endif // NO_DOC
+    };
+}
+
+#endif // CALLGRAPH_TASK_HPP
@@ -0,0 +1,127 @@
+// callgraph/callgraph_alloc_test.cpp
+// License: BSD-2-Clause
+/// \brief Count heap allocations made while executing a graph.
+
+#include "test.hpp"
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    std::atomic<size_t> allocations(0);
+}
+
+// Replace the global allocation functions for this test binary, which
+// holds no other tests; every allocation is counted, whichever thread
+// makes it.
+void* operator new(size_t n) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p(std::malloc(n > 0 ? n : 1));
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+// GCC pairs the built-in operator new with operator delete, and warns
+// about the free once a replacement delete is inlined into its callers.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+    // Execute the graph `runs` times and return the number of allocations
+    // made per run.
+    template <typename R>
+    double allocations_per_run(R& runner, size_t runs) {
+        size_t before(allocations.load());
+        for (size_t i = 0; i < runs; i++) {
+            runner.execute().get();
+        }
+        size_t after(allocations.load());
+        return static_cast<double>(after - before) / static_cast<double>(runs);
+    }
+
+    struct add {
+        int operator()(int x, int y) const { return x + y; }
+    };
+}
+
+CALLGRAPH_TEST(callgraph_preallocated_runs_without_allocating) {
+    int result(0);
+    auto a = [] { return 1; };
+    auto b = [] { return 2; };
+    auto c = [](int x) { return x * 10; };
+    add d;
+    auto e = [&result](int x) { result = x; };
+    auto f = [] {};
+    auto g = [] {};
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect(b);
+    pipe.connect<0>(a, c);
+    pipe.connect<0>(c, d);
+    pipe.connect<1>(b, d);
+    pipe.connect<0>(d, e);
+    pipe.connect(f);
+    pipe.connect(f, g);
+    pipe.connect(e, g);
+
+    callgraph::graph_runner runner(pipe, callgraph::preallocate);
+    CALLGRAPH_EQUAL(allocations_per_run(runner, 1), 0.0);
+    CALLGRAPH_EQUAL(result, 12);
+    CALLGRAPH_EQUAL(allocations_per_run(runner, 100), 0.0);
+    CALLGRAPH_EQUAL(result, 12);
+}
+
+CALLGRAPH_TEST(callgraph_warm_runner_runs_without_allocating) {
+    auto a = [] { return 1; };
+    auto b = [](int x) { return x + 1; };
+    auto c = [](int) {};
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect<0>(a, b);
+    pipe.connect<0>(b, c);
+
+    callgraph::graph_runner runner(pipe);
+    allocations_per_run(runner, 10);
+    CALLGRAPH_EQUAL(allocations_per_run(runner, 100), 0.0);
+}
+
+CALLGRAPH_TEST(callgraph_preallocated_inlining_runs_without_allocating) {
+    auto a = [] { return 1; };
+    auto b = [](int x) { return x + 1; };
+    auto c = [](int x) { return x * 2; };
+    add d;
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect<0>(a, b);
+    pipe.connect<0>(a, c);
+    pipe.connect<0>(b, d);
+    pipe.connect<1>(c, d);
+
+    // Every node is classified as cheap after the first run, and the
+    // second is the first to run nodes inline.
+    callgraph::graph_runner runner(pipe, callgraph::preallocate);
+    runner.set_inlining(1, std::chrono::seconds(1));
+    CALLGRAPH_EQUAL(allocations_per_run(runner, 1), 0.0);
+    CALLGRAPH_EQUAL(allocations_per_run(runner, 1), 0.0);
+    CALLGRAPH_CHECK(runner.inlined(d));
+    CALLGRAPH_CHECK(runner.metrics().tasks_inlined > 0u);
+}
@@ -0,0 +1,139 @@
+// callgraph/callgraph_branch_test.cpp
+// License: BSD-2-Clause
+/// \brief Check branch nodes and the pruning of unselected cases.
+
+#include "test.hpp"
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <atomic>
+
+CALLGRAPH_TEST(callgraph_branch_selects_case) {
+    int choice(0);
+    std::atomic<int> left_calls(0), right_calls(0), after_calls(0), always_calls(0);
+    auto select = [&choice] { return choice; };
+    auto left = [&left_calls] { left_calls++; return 1; };
+    auto right = [&right_calls] { right_calls++; return 2; };
+    auto after = [&after_calls] (int) { after_calls++; };
+    auto always = [&always_calls] { always_calls++; };
+
+    callgraph::graph pipe;
+    pipe.connect(select);
+    pipe.connect(select, left);
+    pipe.connect(select, right);
+    pipe.connect(select, always);
+    pipe.connect<0>(right, after);
+    pipe.set_case(select, left, 0);
+    pipe.set_case(select, right, 1);
+
+    callgraph::graph_runner runner(pipe);
+    runner().get();
+    CALLGRAPH_EQUAL(left_calls.load(), 1);
+    CALLGRAPH_EQUAL(right_calls.load(), 0);
+    CALLGRAPH_EQUAL(after_calls.load(), 0);
+    CALLGRAPH_EQUAL(always_calls.load(), 1);
+    CALLGRAPH_EQUAL(runner.metrics().tasks_pruned, 2u);
+
+    choice = 1;
+    runner().get();
+    CALLGRAPH_EQUAL(left_calls.load(), 1);
+    CALLGRAPH_EQUAL(right_calls.load(), 1);
+    CALLGRAPH_EQUAL(after_calls.load(), 1);
+    CALLGRAPH_EQUAL(always_calls.load(), 2);
+    CALLGRAPH_EQUAL(runner.metrics().tasks_pruned, 3u);
+
+    // No case matches, so both cases are pruned.
+    choice = 2;
+    runner().get();
+    CALLGRAPH_EQUAL(left_calls.load(), 1);
+    CALLGRAPH_EQUAL(right_calls.load(), 1);
+    CALLGRAPH_EQUAL(always_calls.load(), 3);
+    CALLGRAPH_EQUAL(runner.metrics().runs_completed, 3u);
+}
+
+CALLGRAPH_TEST(callgraph_branch_prunes_dependents) {
+    bool enabled(false);
+    std::atomic<int> calls(0);
+    auto gate = [&enabled] { return enabled; };
+    auto a = [] { return 1; };
+    auto b = [&calls] { calls++; return 2; };
+    auto join = [&calls] (int x, int y) { calls++; return x + y; };
+    auto sink = [&calls] (int) { calls++; };
+
+    callgraph::graph pipe;
+    pipe.connect(gate);
+    pipe.connect(a);
+    pipe.connect(gate, b);
+    pipe.connect<0>(a, join);
+    pipe.connect<1>(b, join);
+    pipe.connect<0>(join, sink);
+    pipe.set_case(gate, b, 1);
+
+    callgraph::graph_runner runner(pipe);
+    runner().get();
+    CALLGRAPH_EQUAL(calls.load(), 0);
+    CALLGRAPH_EQUAL(runner.metrics().tasks_pruned, 3u);
+
+    enabled = true;
+    runner().get();
+    CALLGRAPH_EQUAL(calls.load(), 3);
+}
+
+CALLGRAPH_TEST(callgraph_branch_survives_reduce) {
+    int choice(1);
+    std::atomic<int> calls(0);
+    auto select = [&choice] { return choice; };
+    auto a = [] { return 1; };
+    auto b = [&calls] (int, int) { calls++; };
+
+    callgraph::graph pipe;
+    pipe.connect(select);
+    pipe.connect(select, a);
+    pipe.connect<0>(select, b);
+    pipe.connect<1>(a, b);
+    pipe.set_case(select, b, 0);
+    pipe.reduce();
+
+    callgraph::graph_runner runner(pipe);
+    runner().get();
+    CALLGRAPH_EQUAL(calls.load(), 0);
+    choice = 0;
+    runner().get();
+    CALLGRAPH_EQUAL(calls.load(), 1);
+}
+
+CALLGRAPH_TEST(callgraph_branch_incremental) {
+    int choice(0);
+    std::atomic<int> calls(0);
+    auto select = [&choice] { return choice; };
+    auto a = [&calls] { calls++; };
+
+    callgraph::graph pipe;
+    pipe.connect(select);
+    pipe.connect(select, a);
+    pipe.set_case(select, a, 1);
+
+    callgraph::graph_runner runner(pipe);
+    runner.execute_incremental().get();
+    CALLGRAPH_EQUAL(calls.load(), 0);
+
+    // Pruning leaves results stale, so the graph runs again in full.
+    choice = 1;
+    runner.execute_incremental().get();
+    CALLGRAPH_EQUAL(calls.load(), 1);
+    runner.execute_incremental().get();
+    CALLGRAPH_EQUAL(calls.load(), 1);
+}
+
+CALLGRAPH_TEST(callgraph_branch_unknown_edge) {
+    auto select = [] { return 0; };
+    auto a = [] { return 1; };
+    auto b = [] {};
+    auto c = [] {};
+
+    callgraph::graph pipe;
+    pipe.connect(select);
+    pipe.connect(select, a);
+    pipe.connect(b);
+    CALLGRAPH_THROWS(pipe.set_case(select, b, 0));
+    CALLGRAPH_THROWS(pipe.set_case(select, c, 0));
+}
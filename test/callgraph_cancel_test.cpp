@@ -0,0 +1,210 @@
+// callgraph/callgraph_cancel_test.cpp
+// License: BSD-2-Clause
+/// \brief Check cancellation tokens and deadlines.
+
+#include "test.hpp"
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace {
+    bool throws_cancelled(std::future<void>& future) {
+        try {
+            future.get();
+        }
+        catch (const callgraph::deadline_exceeded&) {
+            return false;
+        }
+        catch (const callgraph::cancelled_error&) {
+            return true;
+        }
+        return false;
+    }
+
+    bool throws_deadline(std::future<void>& future) {
+        try {
+            future.get();
+        }
+        catch (const callgraph::deadline_exceeded&) {
+            return true;
+        }
+        return false;
+    }
+}
+
+CALLGRAPH_TEST(callgraph_cancel_before_execute) {
+    std::atomic<int> calls(0);
+    auto a = [&calls] { calls++; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+
+    callgraph::cancellation_token token;
+    token.cancel();
+    callgraph::graph_runner runner(pipe);
+    auto future = runner.execute(token);
+    CALLGRAPH_CHECK(throws_cancelled(future));
+    CALLGRAPH_EQUAL(calls.load(), 0);
+}
+
+CALLGRAPH_TEST(callgraph_cancel_from_node) {
+    std::atomic<int> calls(0);
+    callgraph::cancellation_token token;
+    auto a = [token] { token.cancel(); };
+    auto b = [&calls] { calls++; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect(a, b);
+
+    callgraph::graph_runner runner(pipe);
+    auto future = runner.execute(token);
+    CALLGRAPH_CHECK(throws_cancelled(future));
+    CALLGRAPH_EQUAL(calls.load(), 0);
+    CALLGRAPH_EQUAL(runner.metrics().tasks_executed, 2u);
+}
+
+CALLGRAPH_TEST(callgraph_cancel_polled_by_running_node) {
+    using std::chrono::milliseconds;
+    callgraph::cancellation_token token;
+    auto a = [token] {
+        while (!token.cancelled()) {
+            std::this_thread::yield();
+        }
+    };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+
+    callgraph::graph_runner runner(pipe);
+    auto future = runner.execute(token);
+    std::this_thread::sleep_for(milliseconds(10));
+    token.cancel();
+    auto status = future.wait_for(std::chrono::seconds(1));
+    CALLGRAPH_EQUAL(status, std::future_status::ready);
+    CALLGRAPH_CHECK(throws_cancelled(future));
+}
+
+CALLGRAPH_TEST(callgraph_deadline_expires_running_node) {
+    using std::chrono::milliseconds;
+    callgraph::graph_runner* runner_ptr(nullptr);
+    auto a = [&runner_ptr] {
+        auto give_up(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+        while (!runner_ptr->token().cancelled() &&
+               std::chrono::steady_clock::now() < give_up) {
+            std::this_thread::sleep_for(milliseconds(1));
+        }
+    };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+
+    // The only worker is busy with the node, which sees the deadline
+    // through the run's token.
+    callgraph::graph_runner runner(pipe);
+    runner_ptr = &runner;
+    callgraph::cancellation_token token;
+    auto start(std::chrono::steady_clock::now());
+    auto future = runner.execute(token, start + milliseconds(20));
+    auto status = future.wait_for(std::chrono::seconds(1));
+    CALLGRAPH_EQUAL(status, std::future_status::ready);
+    CALLGRAPH_CHECK(throws_deadline(future));
+    CALLGRAPH_CHECK(runner.token().cancelled());
+    CALLGRAPH_CHECK(!token.cancelled());
+}
+
+CALLGRAPH_TEST(callgraph_deadline_leaves_token_usable) {
+    using std::chrono::milliseconds;
+    std::atomic<int> calls(0);
+    auto a = [] { std::this_thread::sleep_for(milliseconds(30)); };
+    auto b = [&calls] { calls++; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect(a, b);
+
+    // The deadline expires one run; the caller's token still runs the
+    // next.
+    callgraph::graph_runner runner(pipe, 1);
+    callgraph::cancellation_token token;
+    auto future = runner.execute(
+        token, std::chrono::steady_clock::now() + milliseconds(10));
+    CALLGRAPH_CHECK(throws_deadline(future));
+    CALLGRAPH_EQUAL(calls.load(), 0);
+
+    runner.execute(token).get();
+    CALLGRAPH_EQUAL(calls.load(), 1);
+    CALLGRAPH_CHECK(!runner.token().cancelled());
+
+    // The run's token follows the caller's.
+    auto cancel = [&token] { token.cancel(); };
+    pipe.connect(b, cancel);
+    runner.execute(token).wait();
+    CALLGRAPH_CHECK(runner.token().cancelled());
+}
+
+CALLGRAPH_TEST(callgraph_deadline_drops_queued_nodes) {
+    using std::chrono::milliseconds;
+    std::atomic<int> calls(0);
+    auto a = [] { std::this_thread::sleep_for(milliseconds(30)); };
+    auto b = [&calls] { calls++; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect(a, b);
+
+    callgraph::graph_runner runner(pipe, 1);
+    auto future = runner.execute(
+        std::chrono::steady_clock::now() + milliseconds(10));
+    CALLGRAPH_CHECK(throws_deadline(future));
+    CALLGRAPH_EQUAL(calls.load(), 0);
+}
+
+CALLGRAPH_TEST(callgraph_deadline_not_reached) {
+    std::atomic<int> calls(0);
+    auto a = [&calls] { calls++; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+
+    callgraph::graph_runner runner(pipe);
+    for (int i = 0; i < 10; i++) {
+        runner.execute(std::chrono::steady_clock::now() +
+                       std::chrono::seconds(10)).get();
+    }
+    CALLGRAPH_EQUAL(calls.load(), 10);
+
+    // A runner whose last run expired runs normally again.
+    runner.execute(std::chrono::steady_clock::now()).wait();
+    runner.execute().get();
+    CALLGRAPH_EQUAL(calls.load(), 11);
+}
+
+CALLGRAPH_TEST(callgraph_deadline_any_precision) {
+    using std::chrono::milliseconds;
+    std::atomic<int> calls(0);
+    auto a = [&calls] { calls++; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+
+    // Deadlines of any steady_clock precision select the deadline
+    // overloads, rather than being taken for target nodes.
+    callgraph::graph_runner runner(pipe);
+    auto later(std::chrono::time_point_cast<milliseconds>(
+                   std::chrono::steady_clock::now()) + milliseconds(500));
+    runner.execute(later).get();
+    CALLGRAPH_EQUAL(calls.load(), 1);
+
+    callgraph::cancellation_token token;
+    runner.execute(token, later).get();
+    runner.execute_incremental(token, later).get();
+    CALLGRAPH_EQUAL(calls.load(), 3);
+
+    auto earlier(std::chrono::time_point_cast<milliseconds>(
+                     std::chrono::steady_clock::now()) - milliseconds(1));
+    auto future = runner.execute(earlier);
+    CALLGRAPH_CHECK(throws_deadline(future));
+}
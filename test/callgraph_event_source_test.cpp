@@ -0,0 +1,178 @@
+// callgraph/callgraph_event_source_test.cpp
+// License: BSD-2-Clause
+/// \brief Check nodes triggered by file descriptor readiness.
+
+#include "test.hpp"
+#include <callgraph/event_source.hpp>
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <thread>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+CALLGRAPH_TEST(callgraph_event_source_pipe) {
+    int fds[2];
+    CALLGRAPH_CHECK(::pipe(fds) == 0);
+    std::atomic<bool> other_ran(false);
+    char seen(0);
+
+    callgraph::event_source readable(fds[0]);
+    auto consume = [&seen] (callgraph::fd_event e) {
+        CALLGRAPH_CHECK(e.events & callgraph::event_source::readable);
+        CALLGRAPH_EQUAL(::read(e.fd, &seen, 1), 1);
+    };
+    auto before = [] {};
+    auto other = [&other_ran] { other_ran = true; };
+
+    // `other` is queued behind the event source, so with one worker it
+    // only runs if the source does not hold the worker while it waits.
+    callgraph::graph g;
+    g.connect(readable);
+    g.connect(before);
+    g.connect(before, other);
+    g.connect<0>(readable, consume);
+
+    callgraph::graph_runner runner(g, 1);
+    for (char c = 'a'; c <= 'c'; c++) {
+        other_ran = false;
+        std::thread writer([&other_ran, &fds, c] {
+            while (!other_ran) {
+                std::this_thread::yield();
+            }
+            ssize_t n(::write(fds[1], &c, 1));
+            (void)n;
+        });
+        auto done(runner());
+        bool finished(done.wait_for(std::chrono::seconds(10)) ==
+                      std::future_status::ready);
+        writer.join();
+        CALLGRAPH_CHECK(finished);
+        done.get();
+        CALLGRAPH_EQUAL(seen, c);
+    }
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+CALLGRAPH_TEST(callgraph_event_source_timer) {
+    int timer(::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC));
+    CALLGRAPH_CHECK(timer >= 0);
+    std::uint64_t expirations(0);
+
+    callgraph::event_source tick(timer);
+    auto consume = [&expirations] (const callgraph::fd_event& e) {
+        std::uint64_t n(0);
+        CALLGRAPH_EQUAL(::read(e.fd, &n, sizeof(n)), static_cast<ssize_t>(sizeof(n)));
+        expirations += n;
+    };
+
+    callgraph::graph g;
+    g.connect(tick);
+    g.connect<0>(tick, consume);
+
+    callgraph::graph_runner runner(g, 2);
+    for (int i = 1; i <= 3; i++) {
+        itimerspec spec = {};
+        spec.it_value.tv_nsec = 5 * 1000 * 1000;
+        ::timerfd_settime(timer, 0, &spec, nullptr);
+        runner().get();
+        CALLGRAPH_EQUAL(expirations, static_cast<std::uint64_t>(i));
+    }
+    ::close(timer);
+}
+
+CALLGRAPH_TEST(callgraph_event_source_eventfd) {
+    int event(::eventfd(0, EFD_CLOEXEC));
+    std::uint64_t seen(0);
+
+    callgraph::event_source signalled(event);
+    auto consume = [&seen] (callgraph::fd_event e) {
+        CALLGRAPH_EQUAL(::read(e.fd, &seen, sizeof(seen)),
+                        static_cast<ssize_t>(sizeof(seen)));
+    };
+
+    callgraph::graph g;
+    g.connect(signalled);
+    g.connect<0>(signalled, consume);
+
+    // Already ready when the run starts.
+    std::uint64_t one(7);
+    CALLGRAPH_EQUAL(::write(event, &one, sizeof(one)), static_cast<ssize_t>(sizeof(one)));
+    callgraph::graph_runner runner(g, 2);
+    runner().get();
+    CALLGRAPH_EQUAL(seen, 7u);
+
+    // Incremental executions wait on the worker.
+    seen = 0;
+    CALLGRAPH_EQUAL(::write(event, &one, sizeof(one)), static_cast<ssize_t>(sizeof(one)));
+    runner.execute_incremental().get();
+    CALLGRAPH_EQUAL(seen, 7u);
+    ::close(event);
+}
+
+CALLGRAPH_TEST(callgraph_event_source_bad_descriptor) {
+    bool ran(false);
+    callgraph::event_source bad(-1);
+    auto consume = [&ran] (callgraph::fd_event) { ran = true; };
+
+    callgraph::graph g;
+    g.connect(bad);
+    g.connect<0>(bad, consume);
+
+    callgraph::graph_runner runner(g, 2);
+    CALLGRAPH_THROWS(runner().get());
+    CALLGRAPH_CHECK(!ran);
+}
+
+CALLGRAPH_TEST(callgraph_event_source_stopped) {
+    int fds[2];
+    CALLGRAPH_CHECK(::pipe(fds) == 0);
+    char seen(0);
+
+    callgraph::event_source readable(fds[0]);
+    auto consume = [&seen] (callgraph::fd_event e) {
+        CALLGRAPH_EQUAL(::read(e.fd, &seen, 1), 1);
+    };
+
+    callgraph::graph g;
+    g.connect(readable);
+    g.connect<0>(readable, consume);
+    callgraph::graph_runner runner(g, 2);
+
+    // Nothing is ever written, so only the deadline ends the run.
+    auto done(runner.execute(std::chrono::steady_clock::now() +
+                             std::chrono::milliseconds(50)));
+    CALLGRAPH_CHECK(done.wait_for(std::chrono::seconds(2)) ==
+                    std::future_status::ready);
+    try {
+        done.get();
+        CALLGRAPH_CHECK(false);
+    }
+    catch (const callgraph::deadline_exceeded&) {}
+
+    // Cancelling the token stops a run waiting on an idle descriptor.
+    callgraph::cancellation_token token;
+    done = runner.execute(token);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    token.cancel();
+    CALLGRAPH_CHECK(done.wait_for(std::chrono::seconds(2)) ==
+                    std::future_status::ready);
+    try {
+        done.get();
+        CALLGRAPH_CHECK(false);
+    }
+    catch (const callgraph::cancelled_error&) {}
+
+    // The descriptor can be watched again by the next run.
+    char c('x');
+    CALLGRAPH_EQUAL(::write(fds[1], &c, 1), 1);
+    runner().get();
+    CALLGRAPH_EQUAL(seen, 'x');
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
@@ -0,0 +1,146 @@
+// callgraph/callgraph_exception_test.cpp
+// License: BSD-2-Clause
+/// \brief Check that exceptions thrown by nodes stop the run and reach
+/// the caller.
+
+#include "test.hpp"
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+CALLGRAPH_TEST(callgraph_exception_reaches_future) {
+    auto a = [] () -> int { throw std::logic_error("a"); };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+
+    callgraph::graph_runner runner(pipe);
+    auto future = runner();
+    auto status = future.wait_for(std::chrono::seconds(1));
+    CALLGRAPH_EQUAL(status, std::future_status::ready);
+    CALLGRAPH_THROWS(future.get());
+}
+
+CALLGRAPH_TEST(callgraph_exception_skips_dependents) {
+    std::atomic<int> calls(0);
+    auto a = [] () -> int { throw std::logic_error("a"); };
+    auto b = [&calls] (int x) { calls++; return x; };
+    auto c = [&calls] (int x) { calls++; return x; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect<0>(a, b);
+    pipe.connect<0>(b, c);
+
+    callgraph::graph_runner runner(pipe);
+    auto future = runner();
+    CALLGRAPH_THROWS(future.get());
+    CALLGRAPH_EQUAL(calls.load(), 0);
+
+    auto m = runner.metrics();
+    CALLGRAPH_EQUAL(m.runs_started, 1u);
+    CALLGRAPH_EQUAL(m.runs_completed, 0u);
+}
+
+CALLGRAPH_TEST(callgraph_exception_discards_queue) {
+    std::atomic<int> calls(0);
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool started(false);
+    callgraph::graph_runner* runner_ptr(nullptr);
+
+    auto gate = [] {};
+    // `a` throws once a b node has started, so that one worker is busy
+    // with it and the other three b nodes are still queued.
+    auto a = [&] {
+        std::unique_lock<std::mutex> lk(mutex);
+        cv.wait(lk, [&started] { return started; });
+        throw std::logic_error("a");
+    };
+    // The b node which starts holds its worker until the other worker
+    // has discarded a queued b node, so the failure has been seen.
+    auto b = [&] {
+        {
+            std::unique_lock<std::mutex> lk(mutex);
+            started = true;
+        }
+        cv.notify_all();
+        while (runner_ptr->metrics().tasks_skipped == 0) {
+            std::this_thread::yield();
+        }
+        calls++;
+    };
+    auto b1 = [b] { b(); };
+    auto b2 = [b] { b(); };
+    auto b3 = [b] { b(); };
+    auto b4 = [b] { b(); };
+
+    callgraph::graph pipe;
+    pipe.connect(gate);
+    pipe.connect(a);
+    pipe.connect(gate, b1);
+    pipe.connect(gate, b2);
+    pipe.connect(gate, b3);
+    pipe.connect(gate, b4);
+
+    callgraph::graph_runner runner(pipe, 2);
+    runner_ptr = &runner;
+    CALLGRAPH_THROWS(runner().get());
+    CALLGRAPH_EQUAL(calls.load(), 1);
+    CALLGRAPH_EQUAL(runner.metrics().tasks_skipped, 3u);
+}
+
+CALLGRAPH_TEST(callgraph_exception_first_wins) {
+    auto a = [] () -> int { throw std::logic_error("a"); };
+    auto b = [] () -> int { throw std::runtime_error("b"); };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect(b);
+
+    callgraph::graph_runner runner(pipe, 1);
+    auto future = runner();
+    bool caught(false);
+    try {
+        future.get();
+    }
+    catch (const std::exception&) {
+        caught = true;
+    }
+    CALLGRAPH_CHECK(caught);
+
+    auto m = runner.metrics();
+    CALLGRAPH_EQUAL(m.tasks_executed + m.tasks_skipped, 3u);
+}
+
+CALLGRAPH_TEST(callgraph_exception_runner_reusable) {
+    std::atomic<bool> fail(true);
+    int result(0);
+    auto a = [&fail] () -> int {
+        if (fail) {
+            throw std::logic_error("a");
+        }
+        return 42;
+    };
+    auto b = [&result] (int x) { result = x; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect<0>(a, b);
+
+    callgraph::graph_runner runner(pipe);
+    CALLGRAPH_THROWS(runner().get());
+    CALLGRAPH_EQUAL(result, 0);
+
+    fail = false;
+    auto future = runner();
+    auto status = future.wait_for(std::chrono::seconds(1));
+    CALLGRAPH_EQUAL(status, std::future_status::ready);
+    future.get();
+    CALLGRAPH_EQUAL(result, 42);
+}
@@ -0,0 +1,93 @@
+// callgraph/callgraph_export_test.cpp
+// License: BSD-2-Clause
+/// \brief Check DOT and JSON export of graphs.
+
+#include "test.hpp"
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_exporter.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+    bool contains(const std::string& s, const std::string& sub) {
+        return s.find(sub) != std::string::npos;
+    }
+
+    struct source_functor {
+        int operator()() const { return 1; }
+    };
+}
+
+CALLGRAPH_TEST(callgraph_export_dot) {
+    callgraph::graph pipe;
+    source_functor a;
+    auto b = [](int, int) {};
+
+    pipe.connect(a);
+    pipe.connect<0>(a, b);
+    pipe.connect<1>(a, b);
+    pipe.set_name(b, "sink");
+
+    std::ostringstream os;
+    callgraph::graph_exporter(pipe).write_dot(os);
+    std::string dot(os.str());
+
+    CALLGRAPH_CHECK(contains(dot, "digraph callgraph {"));
+    CALLGRAPH_CHECK(contains(dot, "label=\"root\""));
+    CALLGRAPH_CHECK(contains(dot, "label=\"sink\""));
+    CALLGRAPH_CHECK(contains(dot, "source_functor"));
+    CALLGRAPH_CHECK(contains(dot, "n1 -> n2 [label=\"->0, ->1\"]"));
+    CALLGRAPH_CHECK(!contains(dot, "red"));
+}
+
+CALLGRAPH_TEST(callgraph_export_json_critical_path) {
+    using std::chrono::milliseconds;
+    callgraph::graph pipe;
+
+    auto a = [] { return 1; };
+    auto slow = [](int x) {
+        std::this_thread::sleep_for(milliseconds(2));
+        return x;
+    };
+    auto fast = [](int x) { return x; };
+    auto d = [](int, int) {};
+
+    pipe.connect(a);
+    pipe.connect<0>(a, slow);
+    pipe.connect<0>(a, fast);
+    pipe.connect<0>(slow, d);
+    pipe.connect<1>(fast, d);
+    pipe.set_name(a, "a");
+    pipe.set_name(slow, "slow");
+    pipe.set_name(fast, "fast");
+    pipe.set_name(d, "d");
+    CALLGRAPH_THROWS(pipe.set_name(pipe, "missing"));
+
+    callgraph::graph_runner runner(pipe);
+    for (int i = 0; i < 5; i++) {
+        runner.execute().get();
+    }
+    auto report = runner.latencies();
+
+    std::ostringstream os;
+    callgraph::graph_exporter(pipe).with_statistics(report).write_json(os);
+    std::string json(os.str());
+
+    CALLGRAPH_CHECK(contains(json, "\"name\": \"slow\""));
+    CALLGRAPH_CHECK(contains(json, "\"p99_ns\": "));
+    CALLGRAPH_CHECK(contains(json, "\"id\": 2, \"name\": \"slow\""));
+    CALLGRAPH_CHECK(contains(json,
+        "{\"source\": 2, \"target\": 4, \"scheduled\": true, "
+        "\"bindings\": [{\"from\": -1, \"to\": 0}], \"critical\": true}"));
+    CALLGRAPH_CHECK(contains(json,
+        "{\"source\": 3, \"target\": 4, \"scheduled\": true, "
+        "\"bindings\": [{\"from\": -1, \"to\": 1}], \"critical\": false}"));
+
+    std::ostringstream dot;
+    callgraph::graph_exporter(pipe).with_statistics(report).write_dot(dot);
+    CALLGRAPH_CHECK(contains(dot.str(), "n2 -> n4 [label=\"->0\", color=red"));
+    CALLGRAPH_CHECK(contains(dot.str(), "\\nmean "));
+}
@@ -0,0 +1,147 @@
+// callgraph/callgraph_file_io_test.cpp
+// License: BSD-2-Clause
+/// \brief Check the asynchronous file reading and writing nodes.
+
+#include "test.hpp"
+#include <callgraph/file_io.hpp>
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <string>
+#include <unistd.h>
+
+namespace {
+    // A file which is removed when the test ends.
+    struct temp_file {
+        temp_file() {
+            char name[] = "/tmp/callgraph_file_io_XXXXXX";
+            int fd(::mkstemp(name));
+            ::close(fd);
+            path = name;
+        }
+
+        ~temp_file() {
+            std::remove(path.c_str());
+        }
+
+        void write(const std::string& data) const {
+            std::ofstream(path, std::ios::binary) << data;
+        }
+
+        std::string read() const {
+            std::ifstream in(path, std::ios::binary);
+            return std::string(std::istreambuf_iterator<char>(in),
+                               std::istreambuf_iterator<char>());
+        }
+
+        std::string path;
+    };
+}
+
+CALLGRAPH_TEST(callgraph_file_io_read) {
+    temp_file file;
+    std::string contents(200000, 'x');
+    contents[12345] = 'y';
+    file.write(contents);
+
+    std::string seen;
+    auto name = [&file] { return file.path; };
+    callgraph::read_file load;
+    auto use = [&seen] (const std::string& data) { seen = data; };
+
+    callgraph::graph g;
+    g.connect(name);
+    g.connect<0>(name, load);
+    g.connect<0>(load, use);
+
+    callgraph::graph_runner runner(g, 2);
+    for (int i = 0; i < 3; i++) {
+        seen.clear();
+        runner().get();
+        CALLGRAPH_CHECK(seen == contents);
+    }
+
+    // Incremental executions read on the worker.
+    seen.clear();
+    runner.execute_incremental().get();
+    CALLGRAPH_CHECK(seen == contents);
+}
+
+CALLGRAPH_TEST(callgraph_file_io_write_then_read) {
+    temp_file file;
+    size_t written(0);
+    std::string seen;
+    auto name = [&file] { return file.path; };
+    auto data = [] { return std::string("hello, world"); };
+    callgraph::write_file save;
+    auto saved = [&file, &written] (size_t n) {
+        written = n;
+        return file.path;
+    };
+    callgraph::read_file load;
+    auto use = [&seen] (const std::string& d) { seen = d; };
+
+    callgraph::graph g;
+    g.connect(name);
+    g.connect(data);
+    g.connect<0>(name, save);
+    g.connect<1>(data, save);
+    g.connect<0>(save, saved);
+    g.connect<0>(saved, load);
+    g.connect<0>(load, use);
+
+    callgraph::graph_runner runner(g, 2);
+    runner().get();
+    CALLGRAPH_EQUAL(written, 12u);
+    CALLGRAPH_CHECK(file.read() == "hello, world");
+    CALLGRAPH_CHECK(seen == "hello, world");
+}
+
+CALLGRAPH_TEST(callgraph_file_io_missing_file) {
+    bool ran(false);
+    auto name = [] { return std::string("/nonexistent/callgraph/file"); };
+    callgraph::read_file load;
+    auto use = [&ran] (const std::string&) { ran = true; };
+
+    callgraph::graph g;
+    g.connect(name);
+    g.connect<0>(name, load);
+    g.connect<0>(load, use);
+
+    callgraph::graph_runner runner(g, 2);
+    CALLGRAPH_THROWS(runner().get());
+    CALLGRAPH_CHECK(!ran);
+}
+
+CALLGRAPH_TEST(callgraph_file_io_thread_pool) {
+    // The fallback used where io_uring is unavailable.
+    temp_file file;
+    file.write("fallback");
+    callgraph::detail::io_reactor reactor(false);
+    CALLGRAPH_CHECK(!reactor.uring());
+
+    struct reply {
+        std::promise<long> result;
+    } r;
+    char buffer[16];
+    int fd(::open(file.path.c_str(), O_RDONLY));
+    callgraph::detail::io_request request;
+    request.kind = callgraph::detail::io_request::read;
+    request.fd = fd;
+    request.buffer = buffer;
+    request.length = sizeof(buffer);
+    request.offset = 0;
+    request.perform = [] (callgraph::detail::io_request* q) {
+        return static_cast<long>(::pread(q->fd, q->buffer, q->length, 0));
+    };
+    request.complete = [] (callgraph::detail::io_request* q, long result) {
+        static_cast<reply*>(q->context)->result.set_value(result);
+    };
+    request.context = &r;
+    reactor.submit(&request);
+    CALLGRAPH_EQUAL(r.result.get_future().get(), 8);
+    CALLGRAPH_CHECK(std::string(buffer, 8) == "fallback");
+    ::close(fd);
+}
@@ -0,0 +1,163 @@
+// callgraph/callgraph_fuse_test.cpp
+// License: BSD-2-Clause
+/// \brief Check fusing linear chains of nodes.
+
+#include "test.hpp"
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+CALLGRAPH_TEST(callgraph_fuse_chain) {
+    std::thread::id first, last;
+    int seen(0);
+    auto a = [&first] { first = std::this_thread::get_id(); return 1; };
+    auto b = [] (int x) { return x + 1; };
+    auto c = [] (int x) { return x * 10; };
+    auto d = [&last, &seen] (int x) {
+        last = std::this_thread::get_id();
+        seen = x;
+    };
+
+    callgraph::graph g;
+    g.connect(a);
+    g.connect<0>(a, b);
+    g.connect<0>(b, c);
+    g.connect<0>(c, d);
+    // The root and each of the four nodes form one chain.
+    CALLGRAPH_EQUAL(g.fuse(), 4u);
+
+    static const int runs(5);
+    callgraph::graph_runner runner(g, 4);
+    for (int i = 0; i < runs; i++) {
+        runner().get();
+        CALLGRAPH_EQUAL(seen, 20);
+        CALLGRAPH_CHECK(first == last);
+    }
+
+    auto metrics(runner.metrics());
+    CALLGRAPH_EQUAL(metrics.tasks_fused, static_cast<uint64_t>(4 * runs));
+    CALLGRAPH_EQUAL(metrics.tasks_enqueued, static_cast<uint64_t>(runs));
+    CALLGRAPH_EQUAL(metrics.tasks_executed, static_cast<uint64_t>(5 * runs));
+
+    // Every node is still timed.
+    auto report(runner.latencies());
+    CALLGRAPH_EQUAL(report.node(c).execution.count(), static_cast<uint64_t>(runs));
+    CALLGRAPH_EQUAL(report.execution().count(), static_cast<uint64_t>(4 * runs));
+
+    // Incremental executions ignore fusion.
+    runner.execute_incremental().get();
+    CALLGRAPH_EQUAL(seen, 20);
+}
+
+CALLGRAPH_TEST(callgraph_fuse_fan_out) {
+    int left(0), right(0);
+    auto a = [] { return 1; };
+    auto b = [] (int x) { return x + 1; };
+    auto l = [&left] (int x) { left = x; };
+    auto r = [&right] (int x) { right = x; };
+    auto join = [] (int, int) { return 0; };
+    auto end = [] (int) {};
+
+    callgraph::graph g;
+    g.connect(a);
+    g.connect<0>(a, b);
+    g.connect<0>(b, l);
+    g.connect<0>(b, r);
+    g.connect<0>(a, join);
+    g.connect<1>(b, join);
+    g.connect<0>(join, end);
+    // Only the root's link to `a`, and `join`'s link to `end`.
+    CALLGRAPH_EQUAL(g.fuse(), 2u);
+
+    callgraph::graph_runner runner(g, 2);
+    runner().get();
+    CALLGRAPH_EQUAL(left, 2);
+    CALLGRAPH_EQUAL(right, 2);
+    CALLGRAPH_EQUAL(runner.metrics().tasks_fused, 2u);
+}
+
+CALLGRAPH_TEST(callgraph_fuse_throws) {
+    bool ran(false);
+    auto a = [] { return 1; };
+    auto b = [] (int) -> int { throw std::runtime_error("b"); };
+    auto c = [&ran] (int) { ran = true; };
+
+    callgraph::graph g;
+    g.connect(a);
+    g.connect<0>(a, b);
+    g.connect<0>(b, c);
+    g.fuse();
+
+    callgraph::graph_runner runner(g, 2);
+    CALLGRAPH_THROWS(runner().get());
+    CALLGRAPH_CHECK(!ran);
+}
+
+CALLGRAPH_TEST(callgraph_fuse_broken_chain) {
+    // Links which no longer form a chain are not fused.
+    int seen(0);
+    auto a = [] { return 1; };
+    auto b = [] (int x) { return x + 1; };
+    auto c = [&seen] (int x, int y) { seen = x + y; };
+
+    callgraph::graph g;
+    g.connect(a);
+    g.connect<0>(a, b);
+    CALLGRAPH_EQUAL(g.fuse(), 2u);
+    g.connect<0>(b, c);
+    g.connect<1>(a, c);
+
+    callgraph::graph_runner runner(g, 2);
+    runner().get();
+    CALLGRAPH_EQUAL(seen, 3);
+    CALLGRAPH_EQUAL(runner.metrics().tasks_fused, 1u);
+}
+
+CALLGRAPH_TEST(callgraph_fuse_then_set_case) {
+    // A runner which has already run a chain stops fusing a link
+    // which becomes a branch case.
+    int calls(0);
+    auto a = [] { return size_t(0); };
+    auto b = [&calls] (size_t) { calls++; };
+
+    callgraph::graph g;
+    g.connect(a);
+    g.connect<0>(a, b);
+    CALLGRAPH_EQUAL(g.fuse(), 2u);
+
+    callgraph::graph_runner runner(g, 2);
+    runner().get();
+    CALLGRAPH_EQUAL(calls, 1);
+
+    g.set_case(a, b, 1);
+    runner().get();
+    CALLGRAPH_EQUAL(calls, 1);
+}
+
+CALLGRAPH_TEST(callgraph_fuse_then_set_optional) {
+    // A runner which has already run a chain checks the budget of a
+    // link which becomes optional.
+    int seen(0);
+    auto a = [] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return 1;
+    };
+    auto b = [] (int x) { return x + 1; };
+    auto c = [&seen] (int x) { seen = x; };
+
+    callgraph::graph g;
+    g.connect(a);
+    g.connect<0>(a, b);
+    g.connect<0>(b, c);
+    CALLGRAPH_EQUAL(g.fuse(), 3u);
+
+    callgraph::graph_runner runner(g, 2);
+    runner().get();
+    CALLGRAPH_EQUAL(seen, 2);
+
+    g.set_optional(b, std::chrono::nanoseconds(1), -5);
+    runner().get();
+    CALLGRAPH_EQUAL(seen, -5);
+}
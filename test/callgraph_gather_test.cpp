@@ -0,0 +1,153 @@
+// callgraph/callgraph_gather_test.cpp
+// License: BSD-2-Clause
+/// \brief Check gather and reduce nodes.
+
+#include "test.hpp"
+#include <callgraph/gather.hpp>
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <callgraph/reduce.hpp>
+#include <callgraph/stream_runner.hpp>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    struct shard {
+        std::string operator()() const {
+            return *name;
+        }
+        const std::string* name;
+    };
+
+    std::vector<std::string> make_names(size_t count) {
+        std::vector<std::string> names;
+        for (size_t i = 0; i < count; i++) {
+            names.push_back(std::to_string(i) + ",");
+        }
+        return names;
+    }
+
+    std::vector<shard> make_shards(const std::vector<std::string>& names) {
+        std::vector<shard> shards;
+        for (const std::string& name : names) {
+            shards.push_back(shard{&name});
+        }
+        return shards;
+    }
+
+    std::string expected(size_t count) {
+        std::string s;
+        for (size_t i = 0; i < count; i++) {
+            s += std::to_string(i) + ",";
+        }
+        return s;
+    }
+}
+
+CALLGRAPH_TEST(callgraph_gather_collects_in_order) {
+    std::vector<std::string> names(make_names(20));
+    std::vector<shard> shards(make_shards(names));
+    callgraph::gather<std::string> all;
+    std::vector<std::string> result;
+    auto sink = [&result] (const std::vector<std::string>& v) { result = v; };
+
+    callgraph::graph pipe;
+    for (shard& s : shards) {
+        pipe.connect(s);
+        pipe.connect_gather(s, all);
+    }
+    pipe.connect<0>(all, sink);
+
+    callgraph::graph_runner runner(pipe, 4);
+    runner().get();
+    CALLGRAPH_EQUAL(result.size(), 20u);
+    CALLGRAPH_EQUAL(result[0], std::string("0,"));
+    CALLGRAPH_EQUAL(result[19], std::string("19,"));
+}
+
+CALLGRAPH_TEST(callgraph_reduce_keeps_order) {
+    auto concat = [] (const std::string& a, const std::string& b) { return a + b; };
+    for (size_t count : {1u, 2u, 5u, 8u, 500u}) {
+        std::vector<std::string> names(make_names(count));
+        std::vector<shard> shards(make_shards(names));
+        auto joined = callgraph::make_reduce<std::string>(concat);
+        std::string result;
+        auto sink = [&result] (const std::string& s) { result = s; };
+
+        callgraph::graph pipe;
+        for (shard& s : shards) {
+            pipe.connect(s);
+            pipe.connect_gather(s, joined);
+        }
+        pipe.connect<0>(joined, sink);
+
+        callgraph::graph_runner runner(pipe, 4);
+        for (int i = 0; i < 2; i++) {
+            result.clear();
+            runner().get();
+            CALLGRAPH_EQUAL(result, expected(count));
+        }
+
+        // Incremental executions combine when the node runs.
+        result.clear();
+        runner.execute_incremental().get();
+        CALLGRAPH_EQUAL(result, expected(count));
+        names[0] = "x,";
+        runner.mark_dirty(shards[0]);
+        runner.execute_incremental().get();
+        CALLGRAPH_EQUAL(result, "x," + expected(count).substr(2));
+    }
+}
+
+CALLGRAPH_TEST(callgraph_reduce_overlaps_producers) {
+    std::atomic<int> combined(0);
+    std::atomic<int> combined_before_slow(-1);
+    auto fast = [] { return 1; };
+    auto slow = [&combined, &combined_before_slow] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        combined_before_slow = combined.load();
+        return 1;
+    };
+    auto sum = callgraph::make_reduce<int>([&combined] (int a, int b) {
+            combined++;
+            return a + b;
+        });
+    int result(0);
+    auto sink = [&result] (int x) { result = x; };
+
+    // Seven fast inputs, then the slow one.
+    std::vector<decltype(fast)> fasts(7, fast);
+    callgraph::graph pipe;
+    for (auto& f : fasts) {
+        pipe.connect(f);
+        pipe.connect_gather(f, sum);
+    }
+    pipe.connect(slow);
+    pipe.connect_gather(slow, sum);
+    pipe.connect<0>(sum, sink);
+
+    callgraph::graph_runner runner(pipe, 4);
+    runner().get();
+    CALLGRAPH_EQUAL(result, 8);
+    CALLGRAPH_EQUAL(combined.load(), 7);
+    // Every pair without the slow input was combined while it ran.
+    CALLGRAPH_EQUAL(combined_before_slow.load(), 4);
+}
+
+CALLGRAPH_TEST(callgraph_reduce_empty) {
+    auto sum = callgraph::make_reduce<int>([] (int a, int b) { return a + b; });
+    CALLGRAPH_EQUAL(sum(), 0);
+    CALLGRAPH_EQUAL(sum.size(), 0u);
+}
+
+CALLGRAPH_TEST(callgraph_gather_not_streamed) {
+    auto a = [] { return 1; };
+    callgraph::gather<int> all;
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect_gather(a, all);
+    CALLGRAPH_THROWS(callgraph::stream_runner runner(pipe));
+}
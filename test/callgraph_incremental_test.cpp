@@ -0,0 +1,109 @@
+// callgraph/callgraph_incremental_test.cpp
+// License: BSD-2-Clause
+/// \brief Check incremental execution of dirty nodes.
+
+#include "test.hpp"
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <atomic>
+
+CALLGRAPH_TEST(callgraph_incremental_first_run_is_full) {
+    std::atomic<int> calls(0);
+    auto a = [&calls] { calls++; return 1; };
+    auto b = [&calls] (int x) { calls++; return x; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect<0>(a, b);
+
+    callgraph::graph_runner runner(pipe);
+    runner.execute_incremental().get();
+    CALLGRAPH_EQUAL(calls.load(), 2);
+
+    // Nothing is dirty, so nothing runs.
+    runner.execute_incremental().get();
+    CALLGRAPH_EQUAL(calls.load(), 2);
+}
+
+CALLGRAPH_TEST(callgraph_incremental_runs_downstream_only) {
+    int input(1);
+    int sum(0);
+    std::atomic<int> b_calls(0);
+    auto a = [&input] { return input; };
+    auto b = [&b_calls] { b_calls++; return 10; };
+    auto c = [&sum] (int x, int y) { sum = x + y; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect(b);
+    pipe.connect<0>(a, c);
+    pipe.connect<1>(b, c);
+
+    callgraph::graph_runner runner(pipe);
+    runner.execute_incremental().get();
+    CALLGRAPH_EQUAL(sum, 11);
+
+    // c sees b's cached result.
+    input = 2;
+    runner.mark_dirty(a);
+    runner.execute_incremental().get();
+    CALLGRAPH_EQUAL(sum, 12);
+    CALLGRAPH_EQUAL(b_calls.load(), 1);
+}
+
+CALLGRAPH_TEST(callgraph_incremental_early_cutoff) {
+    int input(2);
+    std::atomic<int> c_calls(0);
+    auto a = [&input] { return input; };
+    auto b = [] (int x) { return x % 2; };
+    auto c = [&c_calls] (int) { c_calls++; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect<0>(a, b);
+    pipe.connect<0>(b, c);
+
+    callgraph::graph_runner runner(pipe);
+    runner.execute_incremental().get();
+    CALLGRAPH_EQUAL(c_calls.load(), 1);
+
+    // b's result is unchanged, so c is not recomputed.
+    input = 4;
+    runner.mark_dirty(a);
+    runner.execute_incremental().get();
+    CALLGRAPH_EQUAL(c_calls.load(), 1);
+    CALLGRAPH_EQUAL(runner.metrics().tasks_reused, 1u);
+
+    input = 5;
+    runner.mark_dirty(a);
+    runner.execute_incremental().get();
+    CALLGRAPH_EQUAL(c_calls.load(), 2);
+}
+
+CALLGRAPH_TEST(callgraph_incremental_after_plain_run) {
+    std::atomic<int> calls(0);
+    auto a = [&calls] { calls++; return 1; };
+    auto b = [&calls] (int x) { calls++; return x; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect<0>(a, b);
+
+    callgraph::graph_runner runner(pipe);
+    runner.execute_incremental().get();
+    runner.execute().get();
+    CALLGRAPH_EQUAL(calls.load(), 4);
+
+    // A plain run releases results, so everything runs again.
+    runner.execute_incremental().get();
+    CALLGRAPH_EQUAL(calls.load(), 6);
+}
+
+CALLGRAPH_TEST(callgraph_incremental_unknown_node) {
+    auto a = [] { return 1; };
+    auto b = [] { return 2; };
+    callgraph::graph pipe;
+    pipe.connect(a);
+    callgraph::graph_runner runner(pipe);
+    CALLGRAPH_THROWS(runner.mark_dirty(b));
+}
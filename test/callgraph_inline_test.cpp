@@ -0,0 +1,105 @@
+// callgraph/callgraph_inline_test.cpp
+// License: BSD-2-Clause
+/// \brief Check running cheap nodes inline once they have been measured.
+
+#include "test.hpp"
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+CALLGRAPH_TEST(callgraph_inline_cheap_nodes) {
+    using std::chrono::milliseconds;
+    int seen(0);
+    auto source = [] { return 1; };
+    auto cheap1 = [] (int x) { return x + 1; };
+    auto cheap2 = [] (int x) { return x * 2; };
+    auto slow = [] (int x) {
+        std::this_thread::sleep_for(milliseconds(5));
+        return x + 10;
+    };
+    auto cheap3 = [&seen] (int x) { seen = x; };
+
+    callgraph::graph g;
+    g.connect(source);
+    g.connect<0>(source, cheap1);
+    g.connect<0>(cheap1, cheap2);
+    g.connect<0>(cheap2, slow);
+    g.connect<0>(slow, cheap3);
+
+    callgraph::graph_runner runner(g, 2);
+    runner.set_inlining(3, milliseconds(1));
+    for (int i = 0; i < 3; i++) {
+        runner().get();
+        CALLGRAPH_EQUAL(seen, 14);
+    }
+    CALLGRAPH_EQUAL(runner.metrics().nodes_inlined, 0u);
+    CALLGRAPH_EQUAL(runner.metrics().tasks_inlined, 0u);
+    CALLGRAPH_CHECK(!runner.inlined(cheap1));
+
+    auto before(runner.metrics());
+    seen = 0;
+    runner().get();
+    CALLGRAPH_EQUAL(seen, 14);
+    auto after(runner.metrics());
+    CALLGRAPH_EQUAL(after.nodes_inlined, 4u);
+    CALLGRAPH_CHECK(runner.inlined(source));
+    CALLGRAPH_CHECK(runner.inlined(cheap1));
+    CALLGRAPH_CHECK(runner.inlined(cheap3));
+    CALLGRAPH_CHECK(!runner.inlined(slow));
+    CALLGRAPH_EQUAL(after.tasks_inlined - before.tasks_inlined, 4u);
+    // Only the root and the slow node are queued.
+    CALLGRAPH_EQUAL(after.tasks_enqueued - before.tasks_enqueued, 2u);
+    CALLGRAPH_EQUAL(after.tasks_executed - before.tasks_executed, 6u);
+    // Inlined nodes are still timed.
+    CALLGRAPH_EQUAL(runner.latencies().node(cheap2).execution.count(), 4u);
+
+    // Incremental executions queue every node.
+    runner.mark_dirty(source);
+    runner.execute_incremental().get();
+    CALLGRAPH_EQUAL(seen, 14);
+    CALLGRAPH_EQUAL(runner.metrics().tasks_inlined, after.tasks_inlined);
+
+    // A zero threshold turns inlining off.
+    runner.set_inlining(3, milliseconds(0));
+    CALLGRAPH_EQUAL(runner.metrics().nodes_inlined, 0u);
+    CALLGRAPH_CHECK(!runner.inlined(cheap1));
+    for (int i = 0; i < 5; i++) {
+        runner().get();
+    }
+    CALLGRAPH_EQUAL(runner.metrics().tasks_inlined, after.tasks_inlined);
+}
+
+CALLGRAPH_TEST(callgraph_inline_throws) {
+    bool fail(false);
+    bool ran(false);
+    auto source = [] { return 1; };
+    auto check = [&fail] (int x) {
+        if (fail) {
+            throw std::runtime_error("check");
+        }
+        return x;
+    };
+    auto after = [&ran] (int) { ran = true; };
+
+    callgraph::graph g;
+    g.connect(source);
+    g.connect<0>(source, check);
+    g.connect<0>(check, after);
+
+    callgraph::graph_runner runner(g, 2);
+    runner.set_inlining(1, std::chrono::milliseconds(1));
+    runner().get();
+    runner().get();
+    CALLGRAPH_CHECK(runner.inlined(check));
+
+    fail = true;
+    ran = false;
+    CALLGRAPH_THROWS(runner().get());
+    CALLGRAPH_CHECK(!ran);
+
+    fail = false;
+    runner().get();
+    CALLGRAPH_CHECK(ran);
+}
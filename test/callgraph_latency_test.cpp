@@ -0,0 +1,96 @@
+// callgraph/callgraph_latency_test.cpp
+// License: BSD-2-Clause
+/// \brief Check latency histograms and runner latency reports.
+
+#include "test.hpp"
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <callgraph/latency_histogram.hpp>
+#include <chrono>
+#include <thread>
+
+CALLGRAPH_TEST(latency_histogram_empty) {
+    callgraph::latency_histogram h;
+    auto s = h.snapshot();
+    CALLGRAPH_EQUAL(s.count(), 0u);
+    CALLGRAPH_CHECK(s.p50() == std::chrono::nanoseconds(0));
+    CALLGRAPH_CHECK(s.max() == std::chrono::nanoseconds(0));
+}
+
+CALLGRAPH_TEST(latency_histogram_percentiles) {
+    using std::chrono::microseconds;
+    callgraph::latency_histogram h;
+    for (int i = 1; i <= 1000; i++) {
+        h.record(microseconds(i));
+    }
+    auto s = h.snapshot();
+    CALLGRAPH_EQUAL(s.count(), 1000u);
+    CALLGRAPH_CHECK(s.min() == microseconds(1));
+    CALLGRAPH_CHECK(s.max() == microseconds(1000));
+
+    // Buckets are accurate to within about 6%.
+    auto near = [](std::chrono::nanoseconds got, microseconds want) {
+        double g(static_cast<double>(got.count()));
+        double w(static_cast<double>(std::chrono::nanoseconds(want).count()));
+        return g > w * 0.94 && g < w * 1.06;
+    };
+    CALLGRAPH_CHECK(near(s.p50(), microseconds(500)));
+    CALLGRAPH_CHECK(near(s.p99(), microseconds(990)));
+    CALLGRAPH_CHECK(near(s.p999(), microseconds(999)));
+    CALLGRAPH_CHECK(near(s.mean(), microseconds(500)));
+
+    h.reset();
+    CALLGRAPH_EQUAL(h.snapshot().count(), 0u);
+}
+
+CALLGRAPH_TEST(latency_snapshot_merge) {
+    using std::chrono::microseconds;
+    callgraph::latency_histogram a, b;
+    a.record(microseconds(10));
+    b.record(microseconds(1000));
+    b.record(microseconds(2000));
+
+    auto s = a.snapshot();
+    s += b.snapshot();
+    CALLGRAPH_EQUAL(s.count(), 3u);
+    CALLGRAPH_CHECK(s.min() == microseconds(10));
+    CALLGRAPH_CHECK(s.max() == microseconds(2000));
+}
+
+CALLGRAPH_TEST(callgraph_records_node_latency) {
+    using std::chrono::milliseconds;
+    callgraph::graph pipe;
+
+    auto fast = [] { return 1; };
+    auto slow = [](int) { std::this_thread::sleep_for(milliseconds(2)); };
+
+    pipe.connect(fast);
+    pipe.connect<0>(fast, slow);
+
+    static const int runs(20);
+    callgraph::graph_runner runner(pipe);
+    for (int i = 0; i < runs; i++) {
+        auto future = runner();
+        auto status = future.wait_for(std::chrono::seconds(1));
+        CALLGRAPH_EQUAL(status, std::future_status::ready);
+    }
+
+    auto report = runner.latencies();
+    CALLGRAPH_EQUAL(report.run().count(), static_cast<uint64_t>(runs));
+    CALLGRAPH_EQUAL(report.nodes().size(), 2u);
+
+    const auto& s = report.node(slow);
+    CALLGRAPH_EQUAL(s.execution.count(), static_cast<uint64_t>(runs));
+    CALLGRAPH_EQUAL(s.queue_wait.count(), static_cast<uint64_t>(runs));
+    CALLGRAPH_CHECK(s.execution.p50() >= milliseconds(2));
+    CALLGRAPH_CHECK(s.execution.p50() <= s.execution.p99());
+    CALLGRAPH_CHECK(s.execution.p99() <= s.execution.p999());
+    CALLGRAPH_CHECK(s.execution.p999() <= s.execution.max());
+    CALLGRAPH_CHECK(report.node(fast).execution.p99() < s.execution.p50());
+    CALLGRAPH_CHECK(report.run().p50() >= s.execution.p50());
+    CALLGRAPH_EQUAL(report.execution().count(), static_cast<uint64_t>(2 * runs));
+
+    runner.reset_latencies();
+    CALLGRAPH_EQUAL(runner.latencies().run().count(), 0u);
+    CALLGRAPH_THROWS(report.node(pipe));
+}
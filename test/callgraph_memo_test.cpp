@@ -0,0 +1,128 @@
+// callgraph/callgraph_memo_test.cpp
+// License: BSD-2-Clause
+/// \brief Check memoized nodes and their bounded cache.
+
+#include "test.hpp"
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <callgraph/detail/memo_cache.hpp>
+#include <atomic>
+#include <string>
+#include <tuple>
+
+CALLGRAPH_TEST(callgraph_memo_hits_on_same_inputs) {
+    int input(1);
+    int result(0);
+    std::atomic<int> calls(0);
+    auto a = [&input] { return input; };
+    auto b = [&calls] (int x) { calls++; return x * 10; };
+    auto c = [&result] (int x) { result = x; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect<0>(a, b);
+    pipe.connect<0>(b, c);
+    pipe.set_memoized(b, 16);
+
+    callgraph::graph_runner runner(pipe);
+    for (int i = 0; i < 3; i++) {
+        runner().get();
+    }
+    CALLGRAPH_EQUAL(calls.load(), 1);
+    CALLGRAPH_EQUAL(result, 10);
+
+    input = 2;
+    runner().get();
+    CALLGRAPH_EQUAL(calls.load(), 2);
+    CALLGRAPH_EQUAL(result, 20);
+
+    input = 1;
+    runner().get();
+    CALLGRAPH_EQUAL(calls.load(), 2);
+    CALLGRAPH_EQUAL(result, 10);
+
+    auto stats = pipe.memo_stats(b);
+    CALLGRAPH_EQUAL(stats.hits, 3u);
+    CALLGRAPH_EQUAL(stats.misses, 2u);
+    CALLGRAPH_EQUAL(stats.size, 2u);
+    CALLGRAPH_EQUAL(stats.capacity, 16u);
+}
+
+CALLGRAPH_TEST(callgraph_memo_keys_every_input) {
+    int x(1), y(1);
+    std::atomic<int> calls(0);
+    auto a = [&x] { return x; };
+    auto b = [&y] { return std::string(y, 'y'); };
+    auto c = [&calls] (int i, const std::string& s) {
+        calls++;
+        return std::to_string(i) + s;
+    };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect(b);
+    pipe.connect<0>(a, c);
+    pipe.connect<1>(b, c);
+    pipe.set_memoized(c, 16);
+
+    callgraph::graph_runner runner(pipe);
+    runner().get();
+    y = 2;
+    runner().get();
+    x = 2;
+    runner().get();
+    CALLGRAPH_EQUAL(calls.load(), 3);
+    y = 1;
+    x = 1;
+    runner().get();
+    CALLGRAPH_EQUAL(calls.load(), 3);
+}
+
+CALLGRAPH_TEST(callgraph_memo_not_memoized) {
+    auto a = [] { return 1; };
+    auto b = [] (int x) { return x; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect<0>(a, b);
+    CALLGRAPH_EQUAL(pipe.memo_stats(b).misses, 0u);
+
+    auto c = [] (int x) { return x; };
+    CALLGRAPH_THROWS(pipe.set_memoized(c, 4));
+}
+
+CALLGRAPH_TEST(callgraph_memo_cache_evicts_unreferenced) {
+    using key = std::tuple<int>;
+    callgraph::detail::memo_cache<key, int> cache(2);
+    auto ignore = [](const int&) {};
+
+    // With a capacity of two, there are two single-entry shards.
+    for (int i = 0; i < 100; i++) {
+        cache.insert(key(i), i);
+    }
+    auto stats = cache.statistics();
+    CALLGRAPH_EQUAL(stats.size, 2u);
+    CALLGRAPH_EQUAL(stats.evictions, 98u);
+
+    int found(-1);
+    CALLGRAPH_CHECK(cache.find(key(99), [&found](const int& v) { found = v; }));
+    CALLGRAPH_EQUAL(found, 99);
+    CALLGRAPH_CHECK(!cache.find(key(0), ignore));
+}
+
+CALLGRAPH_TEST(callgraph_memo_cache_clock_keeps_referenced) {
+    using key = std::tuple<int>;
+    callgraph::detail::memo_cache<key, int> cache(32);
+    auto ignore = [](const int&) {};
+
+    for (int i = 0; i < 32; i++) {
+        cache.insert(key(i), i);
+    }
+    // A referenced entry survives the next sweep of its shard.
+    CALLGRAPH_CHECK(cache.find(key(5), ignore));
+    for (int i = 32; i < 40; i++) {
+        cache.insert(key(i), i);
+    }
+    CALLGRAPH_CHECK(cache.find(key(5), ignore));
+    CALLGRAPH_EQUAL(cache.statistics().size, 32u);
+}
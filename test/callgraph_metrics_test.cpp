@@ -0,0 +1,58 @@
+// callgraph/callgraph_metrics_test.cpp
+// License: BSD-2-Clause
+/// \brief Check the counters exposed by graph_runner::metrics.
+
+#include "test.hpp"
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <chrono>
+#include <thread>
+
+CALLGRAPH_TEST(callgraph_metrics_start_empty) {
+    callgraph::graph pipe;
+    callgraph::graph_runner runner(pipe);
+    auto m = runner.metrics();
+    CALLGRAPH_EQUAL(m.runs_started, 0u);
+    CALLGRAPH_EQUAL(m.tasks_enqueued, 0u);
+    CALLGRAPH_EQUAL(m.utilization(), 0.0);
+}
+
+CALLGRAPH_TEST(callgraph_metrics_count_diamond) {
+    using std::chrono::milliseconds;
+    callgraph::graph pipe;
+
+    auto a = [] { return 1; };
+    auto b = [] { return 2; };
+    auto c = [](int x, int y) {
+        std::this_thread::sleep_for(milliseconds(1));
+        return x + y;
+    };
+
+    pipe.connect(a);
+    pipe.connect(b);
+    pipe.connect<0>(a, c);
+    pipe.connect<1>(b, c);
+
+    static const int runs(10);
+    callgraph::graph_runner runner(pipe);
+    for (int i = 0; i < runs; i++) {
+        auto future = runner();
+        auto status = future.wait_for(std::chrono::seconds(1));
+        CALLGRAPH_EQUAL(status, std::future_status::ready);
+    }
+
+    auto m = runner.metrics();
+    CALLGRAPH_EQUAL(m.workers, pipe.depth());
+    CALLGRAPH_EQUAL(m.runs_started, static_cast<uint64_t>(runs));
+    CALLGRAPH_EQUAL(m.runs_completed, static_cast<uint64_t>(runs));
+
+    // The root, a, b and c are enqueued and run once each.
+    CALLGRAPH_EQUAL(m.tasks_executed, static_cast<uint64_t>(4 * runs));
+    CALLGRAPH_EQUAL(m.tasks_enqueued, static_cast<uint64_t>(4 * runs));
+    CALLGRAPH_EQUAL(m.tasks_skipped, 0u);
+    CALLGRAPH_CHECK(m.queue_high_water >= 1u);
+    CALLGRAPH_CHECK(m.queue_high_water <= 2u);
+    CALLGRAPH_CHECK(m.busy_time >= milliseconds(runs));
+    CALLGRAPH_CHECK(m.utilization() > 0.0);
+    CALLGRAPH_CHECK(m.utilization() <= 1.0);
+}
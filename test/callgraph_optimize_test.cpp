@@ -0,0 +1,184 @@
+// callgraph/callgraph_optimize_test.cpp
+// License: BSD-2-Clause
+/// \brief Check common-subexpression and dead-node elimination.
+
+#include "test.hpp"
+#include <callgraph/gather.hpp>
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <atomic>
+#include <vector>
+
+namespace {
+    std::atomic<int> squares(0);
+
+    struct square {
+        int operator()(int x) const {
+            squares++;
+            return x * x;
+        }
+    };
+
+    struct plus_one {
+        int operator()(int x) const {
+            return x + 1;
+        }
+    };
+
+    struct scale {
+        int operator()(int x) const {
+            return x * k;
+        }
+
+        bool operator==(const scale& other) const {
+            return k == other.k;
+        }
+
+        int k;
+    };
+}
+
+CALLGRAPH_TEST(callgraph_optimize_common) {
+    squares = 0;
+    int a(0), b(0);
+    std::vector<int> both;
+    auto source = [] { return 3; };
+    square s1, s2;
+    auto use_a = [&a] (int x) { a = x; };
+    auto use_b = [&b] (int x) { b = x; };
+    callgraph::gather<int> all;
+    auto use_all = [&both] (const std::vector<int>& v) { both = v; };
+
+    callgraph::graph g;
+    g.connect(source);
+    g.connect<0>(source, s1);
+    g.connect<0>(source, s2);
+    g.connect<0>(s1, use_a);
+    g.connect<0>(s2, use_b);
+    g.connect_gather(s1, all);
+    g.connect_gather(s2, all);
+    g.connect<0>(all, use_all);
+    g.set_pure(s1);
+    g.set_pure(s2);
+    CALLGRAPH_EQUAL(g.eliminate_common(), 1u);
+    CALLGRAPH_EQUAL(g.eliminate_common(), 0u);
+
+    callgraph::graph_runner runner(g, 2);
+    runner().get();
+    CALLGRAPH_EQUAL(a, 9);
+    CALLGRAPH_EQUAL(b, 9);
+    CALLGRAPH_CHECK(both == std::vector<int>({9, 9}));
+    CALLGRAPH_EQUAL(squares.load(), 1);
+}
+
+CALLGRAPH_TEST(callgraph_optimize_common_chains) {
+    int a(0), b(0);
+    auto source = [] { return 2; };
+    scale double1{2}, double2{2}, triple{3};
+    plus_one p1, p2;
+    auto use_a = [&a] (int x) { a = x; };
+    auto use_b = [&b] (int x, int y) { b = x + y; };
+
+    callgraph::graph g;
+    g.connect(source);
+    g.connect<0>(source, double1);
+    g.connect<0>(source, double2);
+    g.connect<0>(source, triple);
+    g.connect<0>(double1, p1);
+    g.connect<0>(double2, p2);
+    g.connect<0>(p1, use_a);
+    g.connect<0>(p2, use_b);
+    g.connect<1>(triple, use_b);
+    g.set_pure(double1);
+    g.set_pure(double2);
+    g.set_pure(triple);
+    g.set_pure(p1);
+    g.set_pure(p2);
+    g.set_output(p2);
+    // The doubles merge, and then the increments; the output is kept.
+    CALLGRAPH_EQUAL(g.eliminate_common(), 2u);
+    CALLGRAPH_THROWS(g.set_name(p1, "gone"));
+    g.set_name(p2, "kept");
+
+    callgraph::graph_runner runner(g, 2);
+    runner().get();
+    CALLGRAPH_EQUAL(a, 5);
+    CALLGRAPH_EQUAL(b, 11);
+}
+
+CALLGRAPH_TEST(callgraph_optimize_common_impure) {
+    auto source = [] { return 3; };
+    square s1, s2;
+    auto use = [] (int, int) {};
+
+    callgraph::graph g;
+    g.connect(source);
+    g.connect<0>(source, s1);
+    g.connect<0>(source, s2);
+    g.connect<0>(s1, use);
+    g.connect<1>(s2, use);
+    g.set_pure(s1);
+    CALLGRAPH_EQUAL(g.eliminate_common(), 0u);
+}
+
+CALLGRAPH_TEST(callgraph_optimize_dead) {
+    squares = 0;
+    int logged(0);
+    auto source = [] { return 3; };
+    square sq;
+    scale cube{27};
+    plus_one after;
+    auto log = [&logged] (int x) { logged = x; };
+
+    callgraph::graph g;
+    g.connect(source);
+    g.connect<0>(source, sq);
+    g.connect<0>(sq, cube);
+    g.connect<0>(cube, after);
+    g.connect<0>(source, log);
+    g.set_pure(sq);
+    g.set_pure(cube);
+    g.set_pure(after);
+    g.set_output(sq);
+    CALLGRAPH_EQUAL(g.leaves(), 2u);
+    CALLGRAPH_EQUAL(g.eliminate_dead(), 2u);
+    CALLGRAPH_EQUAL(g.eliminate_dead(), 0u);
+    CALLGRAPH_EQUAL(g.leaves(), 2u);
+    CALLGRAPH_THROWS(g.connect<0>(cube, log));
+
+    callgraph::graph_runner runner(g, 2);
+    runner().get();
+    CALLGRAPH_EQUAL(logged, 3);
+    CALLGRAPH_EQUAL(squares.load(), 1);
+}
+
+CALLGRAPH_TEST(callgraph_optimize_passes) {
+    int seen(0);
+    auto source = [] { return 4; };
+    square s1, s2;
+    plus_one unused;
+    auto use = [&seen] (int x, int y) { seen = x + y; };
+
+    callgraph::graph g;
+    g.connect(source);
+    g.connect<0>(source, s1);
+    g.connect<0>(source, s2);
+    g.connect<0>(source, unused);
+    g.connect<0>(s1, use);
+    g.connect<1>(s2, use);
+    g.set_pure(s1);
+    g.set_pure(s2);
+    g.set_pure(unused);
+
+    auto counts(g.optimize(&callgraph::graph::eliminate_common,
+                           &callgraph::graph::eliminate_dead,
+                           [](callgraph::graph& h) { return h.eliminate_dead(); }));
+    CALLGRAPH_EQUAL(counts.size(), 3u);
+    CALLGRAPH_EQUAL(counts[0], 1u);
+    CALLGRAPH_EQUAL(counts[1], 1u);
+    CALLGRAPH_EQUAL(counts[2], 0u);
+
+    callgraph::graph_runner runner(g, 2);
+    runner().get();
+    CALLGRAPH_EQUAL(seen, 32);
+}
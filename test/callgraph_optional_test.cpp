@@ -0,0 +1,75 @@
+// callgraph/callgraph_optional_test.cpp
+// License: BSD-2-Clause
+/// \brief Check optional nodes with a time budget.
+
+#include "test.hpp"
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+CALLGRAPH_TEST(callgraph_optional_falls_back_when_late) {
+    using std::chrono::milliseconds;
+    std::atomic<int> calls(0);
+    int result(0);
+    auto a = [] { std::this_thread::sleep_for(milliseconds(20)); return 1; };
+    auto b = [&calls] (int x) { calls++; return x + 1; };
+    auto c = [&result] (int x) { result = x; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect<0>(a, b);
+    pipe.connect<0>(b, c);
+    pipe.set_optional(b, milliseconds(5), -1);
+
+    callgraph::graph_runner runner(pipe);
+    runner().get();
+    CALLGRAPH_EQUAL(calls.load(), 0);
+    CALLGRAPH_EQUAL(result, -1);
+    CALLGRAPH_EQUAL(runner.metrics().tasks_bypassed, 1u);
+}
+
+CALLGRAPH_TEST(callgraph_optional_runs_within_budget) {
+    int result(0);
+    auto a = [] { return 1; };
+    auto b = [] (int x) { return x + 1; };
+    auto c = [&result] (int x) { result = x; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect<0>(a, b);
+    pipe.connect<0>(b, c);
+    pipe.set_optional(b, std::chrono::seconds(10), -1);
+
+    callgraph::graph_runner runner(pipe);
+    for (int i = 0; i < 5; i++) {
+        result = 0;
+        runner().get();
+        CALLGRAPH_EQUAL(result, 2);
+    }
+    CALLGRAPH_EQUAL(runner.metrics().tasks_bypassed, 0u);
+}
+
+CALLGRAPH_TEST(callgraph_optional_void_node) {
+    std::atomic<int> calls(0);
+    std::atomic<int> after(0);
+    auto a = [&calls] { calls++; };
+    auto b = [&after] { after++; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect(a, b);
+    pipe.set_optional(a, std::chrono::nanoseconds(0));
+
+    callgraph::graph_runner runner(pipe);
+    runner().get();
+    CALLGRAPH_EQUAL(calls.load(), 0);
+    CALLGRAPH_EQUAL(after.load(), 1);
+}
+
+CALLGRAPH_TEST(callgraph_optional_unknown_node) {
+    auto a = [] { return 1; };
+    callgraph::graph pipe;
+    CALLGRAPH_THROWS(pipe.set_optional(a, std::chrono::seconds(1), 0));
+}
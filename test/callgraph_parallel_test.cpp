@@ -0,0 +1,115 @@
+// callgraph/callgraph_parallel_test.cpp
+// License: BSD-2-Clause
+/// \brief Check parallel map nodes.
+
+#include "test.hpp"
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <callgraph/parallel_map.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+CALLGRAPH_TEST(callgraph_parallel_map_results) {
+    size_t size(100000);
+    long long sum(0);
+    auto load = [size] {
+        std::vector<int> v(size);
+        std::iota(v.begin(), v.end(), 0);
+        return v;
+    };
+    auto square = callgraph::make_parallel_map(
+        [] (int x) { return static_cast<long long>(x) * x; }, 64);
+    auto total = [&sum] (const std::vector<long long>& v) {
+        sum = std::accumulate(v.begin(), v.end(), 0LL);
+    };
+
+    callgraph::graph pipe;
+    pipe.connect(load);
+    pipe.connect<0>(load, square);
+    pipe.connect<0>(square, total);
+
+    long long expected(0);
+    for (size_t i = 0; i < size; i++) {
+        expected += static_cast<long long>(i) * static_cast<long long>(i);
+    }
+
+    callgraph::graph_runner runner(pipe, 4);
+    for (int i = 0; i < 3; i++) {
+        sum = 0;
+        runner().get();
+        CALLGRAPH_EQUAL(sum, expected);
+    }
+    // The node counts once, however many chunks it was split into.
+    CALLGRAPH_EQUAL(runner.metrics().tasks_executed, 12u);
+}
+
+CALLGRAPH_TEST(callgraph_parallel_map_uses_workers) {
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    auto load = [] { return std::vector<int>(64, 1); };
+    auto work = callgraph::make_parallel_map([&mutex, &threads] (int x) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            std::unique_lock<std::mutex> lk(mutex);
+            threads.insert(std::this_thread::get_id());
+            return x;
+        });
+
+    callgraph::graph pipe;
+    pipe.connect(load);
+    pipe.connect<0>(load, work);
+
+    callgraph::graph_runner runner(pipe, 4);
+    runner().get();
+    CALLGRAPH_CHECK(threads.size() > 1);
+}
+
+CALLGRAPH_TEST(callgraph_parallel_map_empty) {
+    std::vector<int> result(1, 1);
+    auto load = [] { return std::vector<int>(); };
+    auto work = callgraph::make_parallel_map([] (int x) { return x; });
+    auto sink = [&result] (const std::vector<int>& v) { result = v; };
+
+    callgraph::graph pipe;
+    pipe.connect(load);
+    pipe.connect<0>(load, work);
+    pipe.connect<0>(work, sink);
+
+    callgraph::graph_runner runner(pipe);
+    runner().get();
+    CALLGRAPH_CHECK(result.empty());
+}
+
+CALLGRAPH_TEST(callgraph_parallel_map_exception) {
+    std::atomic<int> sinks(0);
+    auto load = [] { return std::vector<int>(1000, 1); };
+    auto work = callgraph::make_parallel_map([] (int x) {
+            if (x > 0) {
+                throw std::runtime_error("bad element");
+            }
+            return x;
+        }, 10);
+    auto sink = [&sinks] (const std::vector<int>&) { sinks++; };
+
+    callgraph::graph pipe;
+    pipe.connect(load);
+    pipe.connect<0>(load, work);
+    pipe.connect<0>(work, sink);
+
+    callgraph::graph_runner runner(pipe, 4);
+    CALLGRAPH_THROWS(runner().get());
+    CALLGRAPH_EQUAL(sinks.load(), 0);
+}
+
+CALLGRAPH_TEST(callgraph_parallel_map_serial_call) {
+    auto twice = callgraph::make_parallel_map([] (int x) { return 2 * x; });
+    std::vector<int> out(twice(std::vector<int>{1, 2, 3}));
+    CALLGRAPH_EQUAL(out.size(), 3u);
+    CALLGRAPH_EQUAL(out[2], 6);
+}
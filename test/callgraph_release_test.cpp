@@ -0,0 +1,85 @@
+// callgraph/callgraph_release_test.cpp
+// License: BSD-2-Clause
+/// \brief Check that results are destroyed once their consumers have
+/// read them.
+
+#include "test.hpp"
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <atomic>
+
+namespace {
+    std::atomic<int> live(0);
+
+    struct tracked {
+        tracked() { live++; }
+        tracked(const tracked&) { live++; }
+        tracked(tracked&&) { live++; }
+        ~tracked() { live--; }
+    };
+}
+
+CALLGRAPH_TEST(callgraph_release_after_last_consumer) {
+    int seen_by_c(-1);
+    auto a = [] { return tracked(); };
+    auto b = [] (const tracked&) { return tracked(); };
+    auto c = [&seen_by_c] (const tracked&) { seen_by_c = live; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect<0>(a, b);
+    pipe.connect<0>(b, c);
+
+    live = 0;
+    callgraph::graph_runner runner(pipe);
+    runner().get();
+
+    // Only b's result is alive while c runs.
+    CALLGRAPH_EQUAL(seen_by_c, 1);
+    CALLGRAPH_EQUAL(live.load(), 0);
+}
+
+CALLGRAPH_TEST(callgraph_release_waits_for_every_consumer) {
+    std::atomic<int> seen(0);
+    auto a = [] { return tracked(); };
+    auto b = [&seen] (const tracked&) { seen += live; };
+    auto c = [&seen] (const tracked&) { seen += live; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect<0>(a, b);
+    pipe.connect<0>(a, c);
+
+    live = 0;
+    callgraph::graph_runner runner(pipe, 1);
+    runner().get();
+
+    // a's result is alive for both of its consumers.
+    CALLGRAPH_EQUAL(seen.load(), 2);
+    CALLGRAPH_EQUAL(live.load(), 0);
+}
+
+CALLGRAPH_TEST(callgraph_release_keeps_outputs) {
+    auto a = [] { return tracked(); };
+    auto b = [] (const tracked&) { return tracked(); };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect<0>(a, b);
+    pipe.set_output(b);
+
+    live = 0;
+    {
+        callgraph::graph_runner runner(pipe);
+        for (int i = 0; i < 3; i++) {
+            runner().get();
+            CALLGRAPH_EQUAL(live.load(), 1);
+        }
+    }
+}
+
+CALLGRAPH_TEST(callgraph_release_unknown_output) {
+    auto a = [] { return 1; };
+    callgraph::graph pipe;
+    CALLGRAPH_THROWS(pipe.set_output(a));
+}
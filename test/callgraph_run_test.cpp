@@ -5,6 +5,8 @@
 #include "test.hpp"
 #include <callgraph/graph.hpp>
 #include <callgraph/graph_runner.hpp>
+#include <callgraph/subgraph.hpp>
+#include <atomic>
 #include <chrono>
 
 CALLGRAPH_TEST(empty_callgraph_runs) {
@@ -46,3 +48,135 @@ CALLGRAPH_TEST(callgraph_runs_multiple_times) {
     }
     CALLGRAPH_EQUAL(i, expect);
 }
+
+CALLGRAPH_TEST(callgraph_runs_after_connect) {
+    int seen(0), last(0);
+    auto a = [] () { return 1; };
+    auto b = [&seen] (int x) { seen = x; return x + 1; };
+    auto c = [&last] (int x) { last = x; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+
+    callgraph::graph_runner runner(pipe);
+    runner().get();
+
+    // Nodes connected after the runner was constructed run from the
+    // next execution on.
+    pipe.connect<0>(a, b);
+    runner().get();
+    CALLGRAPH_EQUAL(seen, 1);
+
+    pipe.connect<0>(b, c);
+    runner().get();
+    CALLGRAPH_EQUAL(last, 2);
+    CALLGRAPH_EQUAL(runner.latencies().node(c).execution.count(), 1u);
+}
+
+CALLGRAPH_TEST(callgraph_runs_after_insert) {
+    int result(0);
+    auto a = [] { return 2; };
+    auto times = [] (int x) { return x * 10; };
+    auto plus = [] (int x) { return x + 1; };
+    auto sink = [&result] (int x) { result = x; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+
+    callgraph::graph_runner runner(pipe, 2);
+    runner().get();
+
+    // A runner which has already run picks up an inserted fragment.
+    callgraph::subgraph<int(int)> frag;
+    frag.connect<0>(frag.input<0>(), times);
+    frag.connect<0>(times, plus);
+    frag.connect<0>(plus, frag.output());
+    pipe.insert(frag);
+    pipe.connect<0>(a, frag.input<0>());
+    pipe.connect<0>(frag.output(), sink);
+    runner().get();
+    CALLGRAPH_EQUAL(result, 21);
+}
+
+CALLGRAPH_TEST(callgraph_runs_after_fuse) {
+    // A runner which has already run picks up chains fused since.
+    int seen(0);
+    auto a = [] { return 1; };
+    auto b = [] (int x) { return x + 1; };
+    auto c = [&seen] (int x) { seen = x; };
+
+    callgraph::graph g;
+    g.connect(a);
+    g.connect<0>(a, b);
+    g.connect<0>(b, c);
+
+    callgraph::graph_runner runner(g, 2);
+    runner().get();
+    CALLGRAPH_EQUAL(runner.metrics().tasks_fused, 0u);
+
+    CALLGRAPH_EQUAL(g.fuse(), 3u);
+    runner().get();
+    CALLGRAPH_EQUAL(seen, 2);
+    CALLGRAPH_EQUAL(runner.metrics().tasks_fused, 3u);
+}
+
+CALLGRAPH_TEST(callgraph_runs_after_connect_inlined) {
+    int seen(0);
+    auto a = [] { return 1; };
+    auto b = [] (int x) { return x + 1; };
+    auto c = [&seen] (int x) { seen = x; };
+
+    callgraph::graph g;
+    g.connect(a);
+    g.connect<0>(a, b);
+
+    callgraph::graph_runner runner(g, 2);
+    runner.set_inlining(1, std::chrono::seconds(1));
+    runner().get();
+    runner().get();
+    CALLGRAPH_CHECK(runner.inlined(b));
+
+    // A node connected after classification has no state yet; it is
+    // queued until the runner measures afresh.
+    g.connect<0>(b, c);
+    runner().get();
+    CALLGRAPH_EQUAL(seen, 2);
+    CALLGRAPH_CHECK(!runner.inlined(c));
+    CALLGRAPH_EQUAL(runner.latencies().node(c).execution.count(), 1u);
+}
+
+CALLGRAPH_TEST(callgraph_runs_with_worker_count) {
+    auto a = [] () {};
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+
+    // The worker count overrides the depth of the graph.
+    callgraph::graph_runner runner(pipe, 3);
+    runner().get();
+    CALLGRAPH_EQUAL(runner.metrics().workers, 3u);
+}
+
+CALLGRAPH_TEST(callgraph_void_node_waits_for_every_parent) {
+    std::atomic<int> finished(0);
+    int seen(0);
+    auto a = [&finished] () { finished++; };
+    auto b = [&finished] () { finished++; };
+    auto c = [&finished] () { finished++; };
+    auto d = [&finished, &seen] () { seen = finished; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect(b);
+    pipe.connect(c);
+    pipe.connect(a, d);
+    pipe.connect(b, d);
+    pipe.connect(c, d);
+
+    callgraph::graph_runner runner(pipe, 3);
+    for (int i = 0; i < 10; i++) {
+        finished = 0;
+        runner().get();
+        CALLGRAPH_EQUAL(seen, 3);
+    }
+}
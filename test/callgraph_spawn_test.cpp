@@ -0,0 +1,132 @@
+// callgraph/callgraph_spawn_test.cpp
+// License: BSD-2-Clause
+/// \brief Check nodes which spawn tasks while they run.
+
+#include "test.hpp"
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <callgraph/spawner.hpp>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+CALLGRAPH_TEST(callgraph_spawn_joins_before_children) {
+    std::atomic<int> processed(0);
+    int seen(-1);
+    auto discover = [] { return 50; };
+    auto scan = callgraph::make_spawner(
+        [&processed] (callgraph::spawn_context& ctx, int files) {
+            for (int i = 0; i < files; i++) {
+                ctx.spawn([&processed] { processed++; });
+            }
+            return files;
+        });
+    auto report = [&processed, &seen] (int) { seen = processed.load(); };
+
+    callgraph::graph pipe;
+    pipe.connect(discover);
+    pipe.connect<0>(discover, scan);
+    pipe.connect<0>(scan, report);
+
+    callgraph::graph_runner runner(pipe, 4);
+    for (int i = 1; i <= 3; i++) {
+        runner().get();
+        CALLGRAPH_EQUAL(seen, 50 * i);
+    }
+    CALLGRAPH_EQUAL(runner.metrics().tasks_spawned, 150u);
+}
+
+CALLGRAPH_TEST(callgraph_spawn_single_worker) {
+    // The spawning worker never waits, so one worker is enough.
+    std::atomic<int> processed(0);
+    bool joined(false);
+    auto scan = callgraph::make_spawner(
+        [&processed] (callgraph::spawn_context& ctx) {
+            for (int i = 0; i < 10; i++) {
+                ctx.spawn([&processed, &ctx] {
+                    ctx.spawn([&processed] { processed++; });
+                });
+            }
+        });
+    auto after = [&processed, &joined] { joined = processed.load() == 10; };
+
+    callgraph::graph pipe;
+    pipe.connect(scan);
+    pipe.connect(scan, after);
+
+    callgraph::graph_runner runner(pipe, 1);
+    runner().get();
+    CALLGRAPH_CHECK(joined);
+    CALLGRAPH_EQUAL(runner.metrics().tasks_spawned, 20u);
+}
+
+CALLGRAPH_TEST(callgraph_spawn_prerequisites) {
+    std::mutex mutex;
+    std::vector<int> order;
+    auto record = [&mutex, &order] (int x) {
+        std::unique_lock<std::mutex> lk(mutex);
+        order.push_back(x);
+    };
+    auto build = callgraph::make_spawner(
+        [&record] (callgraph::spawn_context& ctx) {
+            auto a = ctx.spawn([&record] { record(1); });
+            auto b = ctx.spawn([&record] { record(1); });
+            auto c = ctx.spawn([&record] { record(2); }, {a, b});
+            ctx.spawn([&record] { record(3); }, {c});
+        });
+
+    callgraph::graph pipe;
+    pipe.connect(build);
+
+    callgraph::graph_runner runner(pipe, 4);
+    runner().get();
+    CALLGRAPH_EQUAL(order.size(), 4u);
+    CALLGRAPH_EQUAL(order[0], 1);
+    CALLGRAPH_EQUAL(order[1], 1);
+    CALLGRAPH_EQUAL(order[2], 2);
+    CALLGRAPH_EQUAL(order[3], 3);
+
+    // Incremental executions run each task as soon as it is ready.
+    order.clear();
+    runner.execute_incremental().get();
+    CALLGRAPH_EQUAL(order.size(), 4u);
+    CALLGRAPH_EQUAL(order[3], 3);
+}
+
+CALLGRAPH_TEST(callgraph_spawn_task_throws) {
+    bool ran(false);
+    auto scan = callgraph::make_spawner(
+        [] (callgraph::spawn_context& ctx) {
+            ctx.spawn([] { throw std::runtime_error("task"); });
+        });
+    auto after = [&ran] { ran = true; };
+
+    callgraph::graph pipe;
+    pipe.connect(scan);
+    pipe.connect(scan, after);
+
+    callgraph::graph_runner runner(pipe, 2);
+    CALLGRAPH_THROWS(runner().get());
+    CALLGRAPH_CHECK(!ran);
+}
+
+CALLGRAPH_TEST(callgraph_spawn_node_and_tasks_throw) {
+    auto scan = callgraph::make_spawner(
+        [] (callgraph::spawn_context& ctx) {
+            for (int i = 0; i < 4; i++) {
+                ctx.spawn([] { throw std::runtime_error("task"); });
+            }
+            throw std::runtime_error("node");
+        });
+
+    callgraph::graph pipe;
+    pipe.connect(scan);
+
+    // The node and its tasks fail on different workers, and each run
+    // reports one of their errors.
+    callgraph::graph_runner runner(pipe, 4);
+    for (int i = 0; i < 20; i++) {
+        CALLGRAPH_THROWS(runner().get());
+    }
+}
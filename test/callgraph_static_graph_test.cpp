@@ -0,0 +1,119 @@
+// callgraph/callgraph_static_graph_test.cpp
+// License: BSD-2-Clause
+/// \brief Check graphs whose topology is fixed at compile time.
+
+#include "test.hpp"
+#include <callgraph/static_graph.hpp>
+#include <stdexcept>
+#include <string>
+
+namespace {
+    struct source {
+        int operator()() {
+            return ++runs;
+        }
+        int runs = 0;
+    };
+
+    struct twice {
+        int operator()(int x) const {
+            return x * 2;
+        }
+    };
+
+    struct square {
+        int operator()(const int& x) const {
+            return x * x;
+        }
+    };
+
+    struct sum {
+        long operator()(int x, int y) const {
+            return x + y;
+        }
+    };
+
+    using diamond = callgraph::static_graph<callgraph::edges<
+        callgraph::edge<source, twice>,
+        callgraph::edge<source, square>,
+        callgraph::edge<twice, sum, 0>,
+        callgraph::edge<square, sum, 1>>>;
+
+    static_assert(diamond::size() == 4, "");
+    static_assert(diamond::depth() == 3, "");
+    static_assert(diamond::level<source>() == 0, "");
+    static_assert(diamond::level<twice>() == 1, "");
+    static_assert(diamond::level<square>() == 1, "");
+    static_assert(diamond::level<sum>() == 2, "");
+    static_assert(diamond::position<source>() == 0, "");
+    static_assert(diamond::position<sum>() == 3, "");
+}
+
+CALLGRAPH_TEST(callgraph_static_graph_diamond) {
+    source s;
+    s.runs = 2;
+    diamond g(s);
+    g();
+    CALLGRAPH_EQUAL(g.get<twice>(), 6);
+    CALLGRAPH_EQUAL(g.get<square>(), 9);
+    CALLGRAPH_EQUAL(g.get<sum>(), 15l);
+
+    // Nodes keep their state between executions.
+    g();
+    CALLGRAPH_EQUAL(g.node<source>().runs, 4);
+    CALLGRAPH_EQUAL(g.get<sum>(), 24l);
+}
+
+namespace {
+    struct fail {
+        std::string operator()(int x) const {
+            if (x > 1) {
+                throw std::runtime_error("fail");
+            }
+            return "ok";
+        }
+    };
+
+    struct count_calls {
+        void operator()(const std::string&) {
+            ++calls;
+        }
+        int calls = 0;
+    };
+}
+
+CALLGRAPH_TEST(callgraph_static_graph_throws) {
+    callgraph::static_graph<callgraph::edges<
+        callgraph::edge<source, fail>,
+        callgraph::edge<fail, count_calls>>> g;
+
+    g();
+    CALLGRAPH_EQUAL(g.get<fail>(), std::string("ok"));
+    CALLGRAPH_EQUAL(g.node<count_calls>().calls, 1);
+
+    // Nodes after the one which throws do not run, and results from the
+    // failed execution are not available.
+    CALLGRAPH_THROWS(g());
+    CALLGRAPH_EQUAL(g.node<count_calls>().calls, 1);
+    CALLGRAPH_EQUAL(g.get<source>(), 2);
+    CALLGRAPH_THROWS(g.get<fail>());
+}
+
+CALLGRAPH_TEST(callgraph_static_graph_after) {
+    std::string trace;
+    auto first = [&trace] { trace += "a"; };
+    auto second = [&trace] { trace += "b"; return 1; };
+    auto third = [&trace] (int x) { trace += "c"; return x + 1; };
+
+    using graph = callgraph::static_graph<callgraph::edges<
+        callgraph::after<decltype(first), decltype(second)>,
+        callgraph::edge<decltype(second), decltype(third)>>>;
+    static_assert(graph::level<decltype(third)>() == 2, "");
+
+    // Lambdas are not default constructible, so every node is given, in
+    // any order.
+    graph g(third, first, second);
+    g();
+    CALLGRAPH_EQUAL(trace, std::string("abc"));
+    CALLGRAPH_EQUAL(g.get<decltype(third)>(), 2);
+}
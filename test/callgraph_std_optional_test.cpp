@@ -0,0 +1,24 @@
+// callgraph/callgraph_std_optional_test.cpp
+// License: BSD-2-Clause
+/// \brief Check optional nodes which return a std::optional.
+
+#include "test.hpp"
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <chrono>
+#include <optional>
+
+CALLGRAPH_TEST(callgraph_optional_empty_optional) {
+    bool empty(false);
+    auto a = [] { return std::optional<int>(1); };
+    auto b = [&empty] (std::optional<int> x) { empty = !x; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect<0>(a, b);
+    pipe.set_optional(a, std::chrono::nanoseconds(0));
+
+    callgraph::graph_runner runner(pipe);
+    runner().get();
+    CALLGRAPH_CHECK(empty);
+}
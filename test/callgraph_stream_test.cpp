@@ -0,0 +1,234 @@
+// callgraph/callgraph_stream_test.cpp
+// License: BSD-2-Clause
+/// \brief Check streaming execution through bounded queues.
+
+#include "test.hpp"
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <callgraph/stream_runner.hpp>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+CALLGRAPH_TEST(callgraph_stream_pipeline) {
+    int next(0);
+    std::vector<int> seen;
+    auto source = [&next] { return next++; };
+    auto square = [] (int x) { return x * x; };
+    auto sink = [&seen] (int x) { seen.push_back(x); };
+
+    callgraph::graph pipe;
+    pipe.connect(source);
+    pipe.connect<0>(source, square);
+    pipe.connect<0>(square, sink);
+
+    callgraph::stream_runner runner(pipe, 4);
+    runner.execute(100).get();
+    CALLGRAPH_EQUAL(seen.size(), 100u);
+    for (int i = 0; i < 100; i++) {
+        CALLGRAPH_EQUAL(seen[i], i * i);
+    }
+
+    // The sources carry on from where they stopped.
+    runner.execute(10).get();
+    CALLGRAPH_EQUAL(seen.size(), 110u);
+    CALLGRAPH_EQUAL(seen.back(), 109 * 109);
+
+    auto report = runner.report();
+    CALLGRAPH_EQUAL(report.stage(source).items, 110u);
+    CALLGRAPH_EQUAL(report.stage(sink).items, 110u);
+    CALLGRAPH_CHECK(report.stage(square).throughput > 0.0);
+    CALLGRAPH_EQUAL(report.queue(source, square).capacity, 4u);
+    CALLGRAPH_CHECK(report.queue(source, square).high_water <= 4u);
+    CALLGRAPH_EQUAL(report.queue(square, sink).size, 0u);
+    CALLGRAPH_THROWS(report.queue(source, sink));
+}
+
+CALLGRAPH_TEST(callgraph_stream_diamond) {
+    int next(0);
+    std::vector<std::string> seen;
+    auto source = [&next] { return next++; };
+    auto left = [] (int x) { return std::to_string(x); };
+    auto right = [] (int x) { return x * 2; };
+    auto join = [&seen] (const std::string& s, int y) {
+        seen.push_back(s + ":" + std::to_string(y));
+    };
+
+    callgraph::graph pipe;
+    pipe.connect(source);
+    pipe.connect<0>(source, left);
+    pipe.connect<0>(source, right);
+    pipe.connect<0>(left, join);
+    pipe.connect<1>(right, join);
+
+    callgraph::stream_runner runner(pipe, 2);
+    runner.execute(50).get();
+    CALLGRAPH_EQUAL(seen.size(), 50u);
+    CALLGRAPH_EQUAL(seen[0], std::string("0:0"));
+    CALLGRAPH_EQUAL(seen[49], std::string("49:98"));
+}
+
+CALLGRAPH_TEST(callgraph_stream_backpressure) {
+    int next(0);
+    auto source = [&next] { return next++; };
+    auto slow = [] (int) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    };
+
+    callgraph::graph pipe;
+    pipe.connect(source);
+    pipe.connect<0>(source, slow);
+
+    callgraph::stream_runner runner(pipe, 2);
+    runner.execute(20).get();
+
+    // The source can only run ahead by the capacity of the queue.
+    auto report = runner.report();
+    CALLGRAPH_EQUAL(report.queue(source, slow).high_water, 2u);
+    CALLGRAPH_CHECK(report.queue(source, slow).mean_occupancy > 1.0);
+    CALLGRAPH_CHECK(report.stage(source).output_wait_time >
+                    report.stage(source).busy_time);
+}
+
+CALLGRAPH_TEST(callgraph_stream_exception) {
+    int next(0);
+    int sinks(0);
+    auto source = [&next] { return next++; };
+    auto check = [] (int x) {
+        if (x == 5) {
+            throw std::runtime_error("five");
+        }
+        return x;
+    };
+    auto sink = [&sinks] (int) { sinks++; };
+
+    callgraph::graph pipe;
+    pipe.connect(source);
+    pipe.connect<0>(source, check);
+    pipe.connect<0>(check, sink);
+
+    {
+        callgraph::stream_runner runner(pipe, 2);
+        // Items still queued when a stage fails are discarded.
+        CALLGRAPH_THROWS(runner.execute(100).get());
+        CALLGRAPH_CHECK(sinks <= 5);
+
+        // A failed stream leaves nothing behind for the next.
+        sinks = 0;
+        next = 10;
+        runner.execute(10).get();
+        CALLGRAPH_EQUAL(sinks, 10);
+    }
+
+    // The graph can be run as usual once the stream runner is gone.
+    next = 0;
+    callgraph::graph_runner runner(pipe);
+    runner().get();
+    CALLGRAPH_EQUAL(sinks, 11);
+}
+
+CALLGRAPH_TEST(callgraph_stream_ordering_edges) {
+    std::atomic<int> a_calls(0);
+    int b_calls(0);
+    auto a = [&a_calls] { a_calls++; };
+    auto b = [&b_calls, &a_calls] {
+        b_calls++;
+        CALLGRAPH_CHECK(a_calls.load() >= b_calls);
+    };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect(a, b);
+
+    callgraph::stream_runner runner(pipe, 3);
+    runner.execute(30).get();
+    CALLGRAPH_EQUAL(a_calls.load(), 30);
+    CALLGRAPH_EQUAL(b_calls, 30);
+    CALLGRAPH_CHECK(runner.report().queue(a, b).high_water <= 3u);
+}
+
+CALLGRAPH_TEST(callgraph_stream_end) {
+    int next(0), limit(1000);
+    long total(0);
+    int sinks(0);
+    auto source = [&next, &limit] {
+        if (next == limit) {
+            throw callgraph::stream_end();
+        }
+        return next++;
+    };
+    auto left = [] (int x) { return x + 1; };
+    auto right = [] (int x) { return x * 2; };
+    auto join = [&total, &sinks] (int x, int y) { total += x + y; sinks++; };
+
+    callgraph::graph pipe;
+    pipe.connect(source);
+    pipe.connect<0>(source, left);
+    pipe.connect<0>(source, right);
+    pipe.connect<0>(left, join);
+    pipe.connect<1>(right, join);
+
+    // The source decides how long the stream is; every stage processes
+    // every item it produced.
+    callgraph::stream_runner runner(pipe, 8);
+    runner.execute().get();
+    CALLGRAPH_EQUAL(sinks, limit);
+    CALLGRAPH_EQUAL(total, 3l * 999 * 1000 / 2 + 1000);
+    CALLGRAPH_EQUAL(runner.report().stage(left).items, 1000u);
+
+    // A limit on the items still applies.
+    limit = 2000;
+    runner.execute(10).get();
+    CALLGRAPH_EQUAL(sinks, 1010);
+}
+
+CALLGRAPH_TEST(callgraph_stream_end_downstream) {
+    int next(0);
+    int seen(0);
+    auto source = [&next] { return next++; };
+    auto square = [] (int x) { return x * x; };
+    auto sink = [&seen] (int x) {
+        if (x >= 100) {
+            throw callgraph::stream_end();
+        }
+        seen++;
+    };
+
+    callgraph::graph pipe;
+    pipe.connect(source);
+    pipe.connect<0>(source, square);
+    pipe.connect<0>(square, sink);
+
+    // A stage which ends stops the stages feeding it, even an endless
+    // source.
+    callgraph::stream_runner runner(pipe, 4);
+    runner.execute().get();
+    CALLGRAPH_EQUAL(seen, 10);
+    CALLGRAPH_CHECK(next < 100);
+}
+
+CALLGRAPH_TEST(callgraph_stream_memoized) {
+    int next(0);
+    std::atomic<int> calls(0);
+    std::vector<int> seen;
+    auto source = [&next] { return next++ % 4; };
+    auto square = [&calls] (int x) { calls++; return x * x; };
+    auto sink = [&seen] (int x) { seen.push_back(x); };
+
+    callgraph::graph pipe;
+    pipe.connect(source);
+    pipe.connect<0>(source, square);
+    pipe.connect<0>(square, sink);
+    pipe.set_memoized(square, 8);
+
+    // Each item's inputs are looked up in the cache.
+    callgraph::stream_runner runner(pipe, 4);
+    runner.execute(20).get();
+    CALLGRAPH_EQUAL(seen.size(), 20u);
+    CALLGRAPH_EQUAL(seen[7], 9);
+    CALLGRAPH_EQUAL(calls.load(), 4);
+    CALLGRAPH_EQUAL(pipe.memo_stats(square).hits, 16u);
+}
@@ -0,0 +1,143 @@
+// callgraph/callgraph_subgraph_test.cpp
+// License: BSD-2-Clause
+/// \brief Check subgraphs inserted into other graphs.
+
+#include "test.hpp"
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <callgraph/subgraph.hpp>
+#include <atomic>
+#include <string>
+
+namespace {
+    // Builds a fresh fragment from local functions on every call.
+    callgraph::subgraph<int(int)> make_affine(int scale, int offset) {
+        auto times = [scale] (int x) { return x * scale; };
+        auto plus = [offset] (int x) { return x + offset; };
+
+        callgraph::subgraph<int(int)> affine;
+        affine.connect<0>(affine.input<0>(), times);
+        affine.connect<0>(times, plus);
+        affine.connect<0>(plus, affine.output());
+        return affine;
+    }
+}
+
+CALLGRAPH_TEST(callgraph_subgraph_typed_ports) {
+    auto a = [] { return 3; };
+    auto b = [] { return std::string("x"); };
+    auto repeat = [] (int n, const std::string& s) {
+        std::string r;
+        for (int i = 0; i < n; i++) {
+            r += s;
+        }
+        return r;
+    };
+    std::string result;
+    auto sink = [&result] (const std::string& s) { result = s; };
+
+    callgraph::subgraph<std::string(int, std::string)> frag;
+    frag.connect<0>(frag.input<0>(), repeat);
+    frag.connect<1>(frag.input<1>(), repeat);
+    frag.connect<0>(repeat, frag.output());
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect(b);
+    pipe.insert(frag);
+    pipe.connect<0>(a, frag.input<0>());
+    pipe.connect<0>(b, frag.input<1>());
+    pipe.connect<0>(frag.output(), sink);
+    CALLGRAPH_CHECK(pipe.valid());
+
+    // One worker runs the fragment's nodes in turn, without blocking.
+    callgraph::graph_runner runner(pipe, 1);
+    runner().get();
+    CALLGRAPH_EQUAL(result, std::string("xxx"));
+    CALLGRAPH_EQUAL(runner.metrics().workers, 1u);
+}
+
+CALLGRAPH_TEST(callgraph_subgraph_reused) {
+    auto a = [] { return 2; };
+    int result(0);
+    auto sink = [&result] (int x) { result = x; };
+
+    // Both fragments are built from the same local functions.
+    auto first = make_affine(10, 1);
+    auto second = make_affine(3, 4);
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.insert(first);
+    pipe.insert(second);
+    pipe.connect<0>(a, first.input<0>());
+    pipe.connect<0>(first.output(), second.input<0>());
+    pipe.connect<0>(second.output(), sink);
+    CALLGRAPH_CHECK(pipe.valid());
+
+    callgraph::graph_runner runner(pipe, 4);
+    for (int i = 0; i < 3; i++) {
+        result = 0;
+        runner().get();
+        CALLGRAPH_EQUAL(result, (2 * 10 + 1) * 3 + 4);
+    }
+}
+
+CALLGRAPH_TEST(callgraph_subgraph_nested) {
+    std::atomic<int> starts(0);
+    auto a = [] { return 5; };
+    auto source = [&starts] { starts++; return 100; };
+    auto add = [] (int x, int y) { return x + y; };
+    int result(0);
+    auto sink = [&result] (int x) { result = x; };
+
+    auto inner = make_affine(2, 0);
+    callgraph::subgraph<int(int)> outer;
+    outer.insert(inner);
+    outer.connect(source);
+    outer.connect<0>(outer.input<0>(), inner.input<0>());
+    outer.connect<0>(inner.output(), add);
+    outer.connect<1>(source, add);
+    outer.connect<0>(add, outer.output());
+    // Only a root is left behind.
+    CALLGRAPH_EQUAL(inner.leaves(), 1u);
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.insert(outer);
+    pipe.connect<0>(a, outer.input<0>());
+    pipe.connect<0>(outer.output(), sink);
+
+    callgraph::graph_runner runner(pipe);
+    runner().get();
+    CALLGRAPH_EQUAL(result, 110);
+    CALLGRAPH_EQUAL(starts.load(), 1);
+}
+
+CALLGRAPH_TEST(callgraph_subgraph_void_output) {
+    std::atomic<int> order(0);
+    int body_at(-1), after_at(-1);
+    auto a = [] { return 1; };
+    auto body = [&order, &body_at] (int) { body_at = order++; };
+    auto after = [&order, &after_at] { after_at = order++; };
+
+    callgraph::subgraph<void(int)> frag;
+    frag.connect<0>(frag.input<0>(), body);
+    frag.connect(body, frag.output());
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.insert(frag);
+    pipe.connect<0>(a, frag.input<0>());
+    pipe.connect(frag.output(), after);
+
+    callgraph::graph_runner runner(pipe);
+    runner().get();
+    CALLGRAPH_EQUAL(body_at, 0);
+    CALLGRAPH_EQUAL(after_at, 1);
+}
+
+CALLGRAPH_TEST(callgraph_subgraph_insert_self) {
+    callgraph::graph pipe;
+    CALLGRAPH_THROWS(pipe.insert(pipe));
+}
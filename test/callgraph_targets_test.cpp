@@ -0,0 +1,102 @@
+// callgraph/callgraph_targets_test.cpp
+// License: BSD-2-Clause
+/// \brief Check execution of a subset of the graph.
+
+#include "test.hpp"
+#include <callgraph/graph.hpp>
+#include <callgraph/graph_runner.hpp>
+#include <atomic>
+#include <stdexcept>
+
+CALLGRAPH_TEST(callgraph_targets_run_ancestors_only) {
+    std::atomic<int> a_calls(0), b_calls(0), c_calls(0), d_calls(0);
+    int result(0);
+    auto a = [&a_calls] { a_calls++; return 1; };
+    auto b = [&b_calls] (int x) { b_calls++; return x + 1; };
+    auto c = [&c_calls, &result] (int x) { c_calls++; result = x; };
+    auto d = [&d_calls] (int) { d_calls++; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect<0>(a, b);
+    pipe.connect<0>(b, c);
+    pipe.connect<0>(a, d);
+
+    callgraph::graph_runner runner(pipe);
+    runner.execute(c).get();
+    CALLGRAPH_EQUAL(result, 2);
+    CALLGRAPH_EQUAL(a_calls.load(), 1);
+    CALLGRAPH_EQUAL(b_calls.load(), 1);
+    CALLGRAPH_EQUAL(c_calls.load(), 1);
+    CALLGRAPH_EQUAL(d_calls.load(), 0);
+
+    // The root and the three selected nodes.
+    CALLGRAPH_EQUAL(runner.metrics().tasks_enqueued, 4u);
+
+    runner.execute(d).get();
+    CALLGRAPH_EQUAL(a_calls.load(), 2);
+    CALLGRAPH_EQUAL(b_calls.load(), 1);
+    CALLGRAPH_EQUAL(d_calls.load(), 1);
+
+    runner.execute().get();
+    CALLGRAPH_EQUAL(a_calls.load(), 3);
+    CALLGRAPH_EQUAL(c_calls.load(), 2);
+    CALLGRAPH_EQUAL(d_calls.load(), 2);
+}
+
+CALLGRAPH_TEST(callgraph_targets_many) {
+    std::atomic<int> calls(0);
+    int left(0), right(0);
+    auto a = [&calls] { calls++; return 1; };
+    auto b = [&calls] { calls++; return 2; };
+    auto c = [&calls] { calls++; return 3; };
+    auto l = [&calls, &left] (int x, int y) { calls++; left = x + y; };
+    auto r = [&calls, &right] (int x, int y) { calls++; right = x + y; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect(b);
+    pipe.connect(c);
+    pipe.connect<0>(a, l);
+    pipe.connect<1>(b, l);
+    pipe.connect<0>(b, r);
+    pipe.connect<1>(c, r);
+
+    callgraph::graph_runner runner(pipe);
+    runner.execute(l).get();
+    CALLGRAPH_EQUAL(calls.load(), 3);
+    CALLGRAPH_EQUAL(left, 3);
+    CALLGRAPH_EQUAL(right, 0);
+
+    runner.execute(l, r).get();
+    CALLGRAPH_EQUAL(calls.load(), 8);
+    CALLGRAPH_EQUAL(right, 5);
+
+    // A target which depends on another is run once.
+    runner.execute(a, l, a).get();
+    CALLGRAPH_EQUAL(calls.load(), 11);
+}
+
+CALLGRAPH_TEST(callgraph_targets_failure) {
+    std::atomic<int> calls(0);
+    auto a = [] () -> int { throw std::runtime_error("a"); };
+    auto b = [&calls] (int) { calls++; };
+
+    callgraph::graph pipe;
+    pipe.connect(a);
+    pipe.connect<0>(a, b);
+
+    callgraph::graph_runner runner(pipe);
+    CALLGRAPH_THROWS(runner.execute(b).get());
+    CALLGRAPH_EQUAL(calls.load(), 0);
+}
+
+CALLGRAPH_TEST(callgraph_targets_unknown_node) {
+    auto a = [] { return 1; };
+    auto b = [] { return 2; };
+    callgraph::graph pipe;
+    pipe.connect(a);
+    callgraph::graph_runner runner(pipe);
+    CALLGRAPH_THROWS(runner.execute(a, b));
+    CALLGRAPH_EQUAL(runner.metrics().runs_started, 0u);
+}